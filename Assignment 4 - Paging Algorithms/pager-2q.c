@@ -0,0 +1,88 @@
+/*
+ * File: pager-2q.c
+ *
+ * Description:
+ *     The full 2Q replacement policy (Johnson and Shasha) for the
+ *     pages of each process, run by pager-policy.c. A page that
+ *     faults for the first time enters A1in, a FIFO of about a
+ *     quarter of the budget (Kin). When it is evicted from there,
+ *     it is remembered in A1out, a FIFO of pages that are no longer
+ *     in memory (Kout, half the budget). Only a page that faults
+ *     again while in A1out enters Am, the LRU list of the pages in
+ *     use. Pages referenced once, as by a scan, pass through A1in
+ *     and never evict the pages of Am.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "simulator.h"
+#include "pager-policy.h"
+
+#define KIN(budget)     ((budget) / 4 > 0 ? (budget) / 4 : 1)
+#define KOUT(budget)    ((budget) / 2 > 0 ? (budget) / 2 : 1)
+
+struct two_queue {
+    struct page_list a1in, a1out, am;
+};
+
+static INSTANCE struct two_queue queues[MAXPROCESSES];
+
+void policy_reset(int proc) {
+    struct two_queue* t = &queues[proc];
+
+    list_init(&t -> a1in);
+    list_init(&t -> a1out);
+    list_init(&t -> am);
+}
+
+/* A hit in Am moves the page to its most recent end; one in A1in does nothing */
+void policy_reference(int proc, int page, u_int32_t tick) {
+    struct two_queue* t = &queues[proc];
+    (void)tick;
+
+    if (t -> am.in[page]) {
+        list_push(&t -> am, page);
+    }
+}
+
+/* A miss: into Am if the page was seen recently (A1out), A1in otherwise */
+void policy_admit(int proc, int page, int budget, u_int32_t tick) {
+    struct two_queue* t = &queues[proc];
+    (void)budget;
+    (void)tick;
+
+    if (t -> a1out.in[page]) {
+        list_remove(&t -> a1out, page);
+        list_push(&t -> am, page);
+    }
+    else {
+        list_push(&t -> a1in, page);
+    }
+}
+
+/* Evict from A1in while it is over Kin (remembering the page in A1out), from Am otherwise */
+int policy_victim(int proc, int page, int budget, u_int32_t evictable, u_int32_t tick) {
+    struct two_queue* t = &queues[proc];
+    int victim = -1;
+    (void)page;
+    (void)tick;
+
+    if (t -> a1in.size > KIN(budget) || !t -> am.size) {
+        victim = list_oldest_of(&t -> a1in, evictable);
+    }
+    if (victim == -1 && (victim = list_oldest_of(&t -> am, evictable)) != -1) {
+        list_remove(&t -> am, victim);
+        return victim;
+    }
+    if (victim == -1 && (victim = list_oldest_of(&t -> a1in, evictable)) == -1) {
+        return -1;
+    }
+    list_remove(&t -> a1in, victim);
+    list_push(&t -> a1out, victim);
+    if (t -> a1out.size > KOUT(budget)) {
+        list_remove(&t -> a1out, list_oldest(&t -> a1out));
+    }
+    return victim;
+}
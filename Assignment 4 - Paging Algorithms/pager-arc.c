@@ -0,0 +1,107 @@
+/*
+ * File: pager-arc.c
+ *
+ * Description:
+ *     Adaptive replacement cache (ARC, Megiddo and Modha) for the
+ *     pages of each process, run by pager-policy.c. The pages in
+ *     memory are split in two LRU lists: T1, pages referenced once
+ *     since they came in, and T2, pages referenced again. B1 and B2
+ *     remember the pages last evicted from each. A fault on a page
+ *     of B1 means T1 was too small, one on B2 that T2 was: the
+ *     target size 'p' of T1 moves accordingly, and the victim is
+ *     taken from whichever list is over its share. A scan only
+ *     passes through T1, so it does not flush the pages of T2.
+ *
+ *     The budget of the process is the size of the cache (c):
+ *     T1 and B1 hold at most c pages, the four lists 2c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "simulator.h"
+#include "pager-policy.h"
+
+struct arc {
+    struct page_list t1, t2, b1, b2;
+    int p;                  // Target size of T1
+};
+
+static INSTANCE struct arc arcs[MAXPROCESSES];
+
+void policy_reset(int proc) {
+    struct arc* a = &arcs[proc];
+
+    list_init(&a -> t1);
+    list_init(&a -> t2);
+    list_init(&a -> b1);
+    list_init(&a -> b2);
+    a -> p = 0;
+}
+
+/* A hit: the page moves to the most recent end of T2 */
+void policy_reference(int proc, int page, u_int32_t tick) {
+    struct arc* a = &arcs[proc];
+    (void)tick;
+
+    if (a -> t1.in[page]) {
+        list_remove(&a -> t1, page);
+    }
+    list_push(&a -> t2, page);
+}
+
+/* A miss: adapt 'p' on a ghost hit, and add the page to T2 (ghost) or T1 (new) */
+void policy_admit(int proc, int page, int budget, u_int32_t tick) {
+    struct arc* a = &arcs[proc];
+    int delta;
+    (void)tick;
+
+    if (a -> b1.in[page]) {
+        delta = a -> b2.size > a -> b1.size ? a -> b2.size / a -> b1.size : 1;
+        a -> p = a -> p + delta < budget ? a -> p + delta : budget;
+        list_remove(&a -> b1, page);
+        list_push(&a -> t2, page);
+        return;
+    }
+    if (a -> b2.in[page]) {
+        delta = a -> b1.size > a -> b2.size ? a -> b1.size / a -> b2.size : 1;
+        a -> p = a -> p - delta > 0 ? a -> p - delta : 0;
+        list_remove(&a -> b2, page);
+        list_push(&a -> t2, page);
+        return;
+    }
+
+    /* Keep the directory to c pages in T1 and B1, 2c in all */
+    if (a -> t1.size + a -> b1.size >= budget && a -> b1.size) {
+        list_remove(&a -> b1, list_oldest(&a -> b1));
+    }
+    else if (a -> t1.size + a -> t2.size + a -> b1.size + a -> b2.size >= 2 * budget &&
+             a -> b2.size) {
+        list_remove(&a -> b2, list_oldest(&a -> b2));
+    }
+    list_push(&a -> t1, page);
+}
+
+/* REPLACE: evict the LRU page of T1 if it is over 'p', of T2 otherwise */
+int policy_victim(int proc, int page, int budget, u_int32_t evictable, u_int32_t tick) {
+    struct arc* a = &arcs[proc];
+    int victim = -1;
+    (void)budget;
+    (void)tick;
+
+    if (a -> t1.size && (a -> t1.size > a -> p || (a -> b2.in[page] && a -> t1.size == a -> p))) {
+        victim = list_oldest_of(&a -> t1, evictable);
+    }
+    if (victim == -1 && (victim = list_oldest_of(&a -> t2, evictable)) != -1) {
+        list_remove(&a -> t2, victim);
+        list_push(&a -> b2, victim);
+        return victim;
+    }
+    if (victim == -1 && (victim = list_oldest_of(&a -> t1, evictable)) == -1) {
+        return -1;
+    }
+    list_remove(&a -> t1, victim);
+    list_push(&a -> b1, victim);
+    return victim;
+}
@@ -0,0 +1,161 @@
+/*
+ * File: pager-lirs.c
+ *
+ * Description:
+ *     Low inter-reference recency set (LIRS, Jiang and Zhang) for
+ *     the pages of each process, run by pager-policy.c. Pages are
+ *     ranked by the distance between their last two references
+ *     instead of by their last one. Most of the budget holds LIR
+ *     pages, those with the shortest distances; the rest (HIR_SLOTS)
+ *     holds HIR pages, which are evicted first. The stack S keeps,
+ *     in recency order, the LIR pages and the HIR pages referenced
+ *     since the oldest LIR page, in memory or not. A HIR page
+ *     referenced again while still in S has a shorter distance than
+ *     that LIR page, and takes its place. Queue Q keeps the HIR
+ *     pages in memory, in the order they are evicted.
+ *
+ *     A scan only brings HIR pages, and evicts only those.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "simulator.h"
+#include "pager-policy.h"
+
+#define HIR_SLOTS   1       // Frames of the budget for HIR pages
+
+/* States of a page */
+enum { NONE, LIR, HIR, HIR_OUT };   // HIR_OUT: not in memory, still in S
+
+struct lirs {
+    struct page_list s, q;
+    char state[MAXPROCPAGES];
+    int lir;                // LIR pages
+    int lir_slots;          // LIR pages at most: the budget less HIR_SLOTS
+};
+
+static INSTANCE struct lirs sets[MAXPROCESSES];
+
+static void touch(struct lirs* l, int page);
+static void demote_bottom(struct lirs* l);
+static void prune(struct lirs* l);
+
+void policy_reset(int proc) {
+    struct lirs* l = &sets[proc];
+    int page;
+
+    list_init(&l -> s);
+    list_init(&l -> q);
+    for (page = 0; page < MAXPROCPAGES; page++) {
+        l -> state[page] = NONE;
+    }
+    l -> lir = 0;
+    l -> lir_slots = 1;
+}
+
+void policy_reference(int proc, int page, u_int32_t tick) {
+    struct lirs* l = &sets[proc];
+    (void)tick;
+
+    touch(l, page);
+}
+
+void policy_admit(int proc, int page, int budget, u_int32_t tick) {
+    struct lirs* l = &sets[proc];
+    (void)tick;
+
+    l -> lir_slots = budget > HIR_SLOTS ? budget - HIR_SLOTS : 1;
+    touch(l, page);
+}
+
+/* Evict the HIR page at the front of Q; it stays in S, not in memory */
+int policy_victim(int proc, int page, int budget, u_int32_t evictable, u_int32_t tick) {
+    struct lirs* l = &sets[proc];
+    int victim;
+    (void)page;
+    (void)budget;
+    (void)tick;
+
+    /* No HIR page in memory: the oldest LIR page becomes one */
+    if (list_oldest_of(&l -> q, evictable) == -1 && l -> lir) {
+        demote_bottom(l);
+    }
+    if ((victim = list_oldest_of(&l -> q, evictable)) == -1) {
+        return -1;
+    }
+    list_remove(&l -> q, victim);
+    if (l -> s.in[victim]) {
+        l -> state[victim] = HIR_OUT;
+    }
+    else {
+        l -> state[victim] = NONE;
+    }
+    return victim;
+}
+
+/* A reference to the page: in memory already (a hit) or admitted (a miss) */
+static void touch(struct lirs* l, int page) {
+    switch (l -> state[page]) {
+        case LIR:
+            list_push(&l -> s, page);
+            prune(l);   // It may have been the bottom of S
+            break;
+
+        case HIR:
+        case HIR_OUT:
+            if (l -> s.in[page]) {
+                /* Its distance is shorter than the oldest LIR page's: they swap */
+                if (l -> state[page] == HIR) {
+                    list_remove(&l -> q, page);
+                }
+                l -> state[page] = LIR;
+                l -> lir++;
+                list_push(&l -> s, page);
+                if (l -> lir > l -> lir_slots) {
+                    demote_bottom(l);
+                }
+                break;
+            }
+            l -> state[page] = HIR;
+            list_push(&l -> s, page);
+            list_push(&l -> q, page);
+            break;
+
+        default:
+            /* A new page: LIR while there is room, HIR after */
+            list_push(&l -> s, page);
+            if (l -> lir < l -> lir_slots) {
+                l -> state[page] = LIR;
+                l -> lir++;
+            }
+            else {
+                l -> state[page] = HIR;
+                list_push(&l -> q, page);
+            }
+    }
+}
+
+/* The LIR page at the bottom of S becomes a HIR page at the end of Q */
+static void demote_bottom(struct lirs* l) {
+    int page = list_oldest(&l -> s);
+
+    list_remove(&l -> s, page);
+    l -> state[page] = HIR;
+    l -> lir--;
+    list_push(&l -> q, page);
+    prune(l);
+}
+
+/* Remove the HIR pages at the bottom of S, so a LIR page is there */
+static void prune(struct lirs* l) {
+    int page;
+
+    while ((page = list_oldest(&l -> s)) != -1 && l -> state[page] != LIR) {
+        list_remove(&l -> s, page);
+        if (l -> state[page] == HIR_OUT) {
+            l -> state[page] = NONE;
+        }
+    }
+}
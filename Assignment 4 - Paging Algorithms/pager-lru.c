@@ -1,13 +1,32 @@
 /*
  * File: pager-lru.c
- * 
+ *
  * Description:
  *     A basic LRU based paging algorithm that follows the stub
- *     provided by the assignment. It creates a blank timestamp 
- *     matrix which contains articfical times (as ticks) when a 
- *     page is referenced. lru() uses these timestamps to select 
- *     the page with the smallest timestamp to evict, because 
- *     this page should be the "least recent"-ly referenced.
+ *     provided by the assignment. Each process keeps its pages in
+ *     an intrusive doubly-linked list, ordered by the tick of their
+ *     last reference: a reference moves the page to the most recent
+ *     end, and lru() evicts from the least recent end. Both are O(1)
+ *     (lru() unlinks the pages it finds already swapped out, so each
+ *     of them is passed over once).
+ *
+ *     Two other versions are selected at build time:
+ *
+ *         -DLRU_SCAN   the original: the artificial time (as ticks) a
+ *                      page was last referenced, its age, and lru()
+ *                      scans all of a process's ages for the smallest.
+ *                      It evicts the same pages as the list, in
+ *                      O(MAXPROCPAGES) per fault; built with -mavx2 or
+ *                      -msse4.1 the scan compares 8 or 4 ages at once.
+ *         -DLRU_CLOCK  an approximation of LRU (second chance): a
+ *                      reference sets the page's reference bit, and
+ *                      lru() sweeps a clock hand over the resident
+ *                      pages, clearing set bits, until it finds one
+ *                      that is clear. The pages and their bits are
+ *                      bitmasks, so the hand skips the rest.
+ *
+ *     Both keep a process's ages, bits and hand in one block
+ *     (struct page_state).
  */
 
 #include <stdio.h>
@@ -15,54 +34,274 @@
 #include <sys/types.h>
 #include "simulator.h"
 
-static int lru(Pentry q, u_int32_t timestamps[], u_int32_t current_tick);
+static void reference(Pentry* q, int proc, int page, u_int32_t tick);
+static int lru(Pentry* q, int proc, int page, u_int32_t current_tick);
 
 void pageit(Pentry q[MAXPROCESSES]) {
 
     /* Static vars */
-    static int initialized = 0;
-    static int tick = 1; // artificial time
-    static u_int32_t timestamps[MAXPROCESSES][MAXPROCPAGES];
+    static INSTANCE u_int32_t tick = 1; // artificial time
 
     /* Local vars */
     int proc, page, evicted_page;
 
-    /* Initialize static vars on first run */
-    if(!initialized){
-        for(proc=0; proc < MAXPROCESSES; proc++){
-            for(page=0; page < MAXPROCPAGES; page++){
-                timestamps[proc][page] = 0;
-            }
-        }
-        initialized = 1;
-    }
     /* Load pages requested by each process and into memory */
     for (proc = 0; proc < MAXPROCESSES; proc++) {
         if (q[proc].active) {               // Select an active process
             page = q[proc].pc / PAGESIZE;   // Get the requested page
-            timestamps[proc][page] = tick;  // Set a page reference timestamp
+            reference(&q[proc], proc, page, tick);  // Record the page reference
 
             /* Page-in if the page is not in the page table */
             /* Use LRU to select a page to evict if pagein() fails */
-            if (!q[proc].pages[page] && !pagein(proc, page)) {    
-                evicted_page = lru(q[proc], timestamps[proc], tick);
-                pageout(proc, evicted_page);
-                pagein(proc, page);                  
+            if (!q[proc].pages[page] && !pagein(proc, page)) {
+                evicted_page = lru(&q[proc], proc, page, tick);
+                if (evicted_page != -1) {   // No other page of the process is in memory
+                    pageout(proc, evicted_page);
+                    pagein(proc, page);
+                }
             }
         }
     }
     tick++;
 }
 
-/* Implementation of LRU: Select a page to evict with the smallest timestamp */
-static int lru(Pentry q, u_int32_t timestamps[], u_int32_t current_tick) {
-	int page, evicted_page;
-	u_int32_t smallest_tick = current_tick;
-	for(page = 0; page < MAXPROCPAGES; page++) {
-		if(q.pages[page] && timestamps[page] < smallest_tick) {
-            smallest_tick = timestamps[page];
+#if defined(LRU_SCAN) || defined(LRU_CLOCK)
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#define AGE_SLOTS   ((MAXPROCPAGES + 7) & ~7)   // Ages padded to whole vectors of 8
+#define AGE_NONE    0xFFFFFFFFu                 // Age of a page that is not in memory
+
+/*
+ *  Page state of one process, packed in one block: the age of each
+ *  page (the tick of its last reference while in memory), a bit per
+ *  page in memory and per page referenced (MAXPROCPAGES <= 32), and
+ *  the clock hand.
+ */
+struct page_state {
+    u_int32_t ages[AGE_SLOTS] __attribute__((aligned(32)));
+    u_int32_t resident;
+    u_int32_t referenced;
+    int hand;
+};
+
+static INSTANCE struct page_state states[MAXPROCESSES];
+
+/* Record a page reference in the process's block */
+static void reference(Pentry* q, int proc, int page, u_int32_t tick) {
+
+    /* Static vars */
+    static INSTANCE int initialized = 0;
+
+    /* Local vars */
+    struct page_state* s = &states[proc];
+    int i, j;
+
+    /* Initialize static vars on first run: no page in memory */
+    if (!initialized) {
+        for (i = 0; i < MAXPROCESSES; i++) {
+            for (j = 0; j < AGE_SLOTS; j++) {
+                states[i].ages[j] = AGE_NONE;
+            }
+        }
+        initialized = 1;
+    }
+    s -> referenced |= 1u << page;
+    if (q -> pages[page]) {
+        s -> ages[page] = tick;
+        s -> resident |= 1u << page;
+    }
+}
+
+/* The page left memory (or is about to): it is no longer a candidate */
+static void forget(struct page_state* s, int page) {
+    s -> ages[page] = AGE_NONE;
+    s -> resident &= ~(1u << page);
+}
+
+#endif
+
+#if defined(LRU_SCAN)
+
+/*
+ *  Index of the smallest age below 'limit', the lowest index of equal
+ *  ones, or -1. With AVX2 (or SSE4.1) the minimum of all the ages is
+ *  found 8 (or 4) at a time, then the lanes equal to it give the index.
+ */
+static int min_age(const u_int32_t ages[AGE_SLOTS], u_int32_t limit) {
+#if defined(__AVX2__)
+    __m256i smallest = _mm256_set1_epi32(-1), v;
+    __m128i h;
+    u_int32_t mask = 0, min;
+    int i;
+
+    for (i = 0; i < AGE_SLOTS; i += 8) {
+        smallest = _mm256_min_epu32(smallest, _mm256_load_si256((const __m256i*)&ages[i]));
+    }
+    h = _mm_min_epu32(_mm256_castsi256_si128(smallest), _mm256_extracti128_si256(smallest, 1));
+    h = _mm_min_epu32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+    h = _mm_min_epu32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+    min = _mm_cvtsi128_si32(h);
+    if (min >= limit) {
+        return -1;
+    }
+    v = _mm256_set1_epi32(min);
+    for (i = 0; i < AGE_SLOTS; i += 8) {
+        mask |= (u_int32_t)_mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i*)&ages[i]), v))) << i;
+    }
+    return __builtin_ctz(mask);
+#elif defined(__SSE4_1__)
+    __m128i smallest = _mm_set1_epi32(-1), v;
+    u_int32_t mask = 0, min;
+    int i;
+
+    for (i = 0; i < AGE_SLOTS; i += 4) {
+        smallest = _mm_min_epu32(smallest, _mm_load_si128((const __m128i*)&ages[i]));
+    }
+    smallest = _mm_min_epu32(smallest, _mm_shuffle_epi32(smallest, _MM_SHUFFLE(1, 0, 3, 2)));
+    smallest = _mm_min_epu32(smallest, _mm_shuffle_epi32(smallest, _MM_SHUFFLE(2, 3, 0, 1)));
+    min = _mm_cvtsi128_si32(smallest);
+    if (min >= limit) {
+        return -1;
+    }
+    v = _mm_set1_epi32(min);
+    for (i = 0; i < AGE_SLOTS; i += 4) {
+        mask |= (u_int32_t)_mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_load_si128((const __m128i*)&ages[i]), v))) << i;
+    }
+    return __builtin_ctz(mask);
+#else
+    int page, evicted_page = -1;
+    u_int32_t smallest_tick = limit;
+
+    for (page = 0; page < MAXPROCPAGES; page++) {
+        if (ages[page] < smallest_tick) {
+            smallest_tick = ages[page];
             evicted_page = page;
-	    }
+        }
     }
-    return evicted_page;			
+    return evicted_page;
+#endif
 }
+
+/* Implementation of LRU: Select a page to evict with the smallest age */
+static int lru(Pentry* q, int proc, int page, u_int32_t current_tick) {
+    struct page_state* s = &states[proc];
+    int evicted_page;
+    (void)page;
+
+    /* A page swapped out with its process (it exited) has an age left: skip it */
+    while ((evicted_page = min_age(s -> ages, current_tick)) != -1) {
+        forget(s, evicted_page);
+        if (q -> pages[evicted_page]) {
+            return evicted_page;
+        }
+    }
+    return -1;
+}
+
+#elif defined(LRU_CLOCK)
+
+/* Implementation of CLOCK: Give each referenced page a second chance */
+static int lru(Pentry* q, int proc, int page, u_int32_t current_tick) {
+    struct page_state* s = &states[proc];
+    u_int32_t others, ahead, bit;
+    int candidate;
+    (void)current_tick;
+
+    /* The hand only visits pages in memory: each at most twice, then one is found */
+    while ((others = s -> resident & ~(1u << page))) {
+        ahead = others & (~0u << s -> hand);
+        candidate = __builtin_ctz(ahead ? ahead : others);
+        s -> hand = (candidate + 1) % MAXPROCPAGES;
+        bit = 1u << candidate;
+        if (!q -> pages[candidate]) {
+            forget(s, candidate);   // Swapped out with its process (it exited)
+        }
+        else if (s -> referenced & bit) {
+            s -> referenced &= ~bit;
+        }
+        else {
+            forget(s, candidate);
+            return candidate;
+        }
+    }
+    return -1;
+}
+
+#else
+
+/*
+ *  Recency list of one process. Nodes are indexed by page; node
+ *  MAXPROCPAGES is the sentinel, whose next is the least recently
+ *  referenced page and whose prev is the most recent.
+ */
+#define SENTINEL MAXPROCPAGES
+
+struct lru_list {
+    int prev[MAXPROCPAGES + 1];
+    int next[MAXPROCPAGES + 1];
+    char linked[MAXPROCPAGES];
+};
+
+static INSTANCE struct lru_list lists[MAXPROCESSES];
+
+static void unlink_page(struct lru_list* l, int page) {
+    l -> next[l -> prev[page]] = l -> next[page];
+    l -> prev[l -> next[page]] = l -> prev[page];
+    l -> linked[page] = 0;
+}
+
+/* Move the page to the most recent end of the list */
+static void reference(Pentry* q, int proc, int page, u_int32_t tick) {
+
+    /* Static vars */
+    static INSTANCE int initialized = 0;
+
+    /* Local vars */
+    struct lru_list* l = &lists[proc];
+    int i;
+    (void)q;
+    (void)tick;
+
+    /* Initialize static vars on first run: every list empty */
+    if (!initialized) {
+        for (i = 0; i < MAXPROCESSES; i++) {
+            lists[i].prev[SENTINEL] = lists[i].next[SENTINEL] = SENTINEL;
+        }
+        initialized = 1;
+    }
+    if (l -> prev[SENTINEL] == page) {
+        return;   // Referenced last time too
+    }
+    if (l -> linked[page]) {
+        unlink_page(l, page);
+    }
+    l -> prev[page] = l -> prev[SENTINEL];
+    l -> next[page] = SENTINEL;
+    l -> next[l -> prev[SENTINEL]] = page;
+    l -> prev[SENTINEL] = page;
+    l -> linked[page] = 1;
+}
+
+/* Implementation of LRU: Select the least recent page in memory */
+static int lru(Pentry* q, int proc, int page, u_int32_t current_tick) {
+    struct lru_list* l = &lists[proc];
+    int candidate = l -> next[SENTINEL];
+    (void)current_tick;
+
+    /* Pages swapped out (or left by an exited process) leave the list */
+    while (candidate != SENTINEL && candidate != page) {
+        if (q -> pages[candidate]) {
+            return candidate;
+        }
+        unlink_page(l, candidate);
+        candidate = l -> next[SENTINEL];
+    }
+    return -1;
+}
+
+#endif
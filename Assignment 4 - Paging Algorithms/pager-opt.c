@@ -0,0 +1,422 @@
+/*
+ * File: pager-opt.c
+ *
+ * Description:
+ *     Belady's optimal replacement (OPT, or MIN), as a lower bound
+ *     for the other pagers. It only runs on a replay ('-r'): it
+ *     reads the same trace before the first tick, so it knows every
+ *     reference each process will make.
+ *
+ *     The trace is kept per process as runs, the references to one
+ *     page in a row, and each run is indexed with the next run of
+ *     its program that uses the same page (its next use). A page
+ *     in memory is kept in a max-heap by the tick of its next use,
+ *     estimated when its process leaves it: the top of the heap is
+ *     the page used furthest in the future. Only a change of page
+ *     updates the heap, so a reference costs O(1), or O(log n) in
+ *     the pages in memory when it moves to another page.
+ *
+ *     Swaps take PAGEWAIT ticks, so the pager also fetches ahead:
+ *     every page a process will reference in the next HORIZON
+ *     references is paged in if a frame is free, and the top of the
+ *     heap is evicted for it if that page is used later. Following
+ *     a process through its trace needs no help from the simulator:
+ *     it runs one reference each tick its page is in memory when
+ *     pageit() returns.
+ *
+ *     The runs are freed when the thread of the simulation exits,
+ *     so the simulations of a sweep (sweep.c) do not keep them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "simulator.h"
+#include "trace.h"
+
+#define HORIZON     (3 * PAGEWAIT)  // References ahead a page is fetched for: out, in, and slack
+#define NO_RUN      UINT_MAX        // No next use in the program
+#define NEVER       ULONG_MAX       // The next use of a page with none
+#define NPAGES      (MAXPROCESSES * MAXPROCPAGES)
+
+/* The references of a process to one page in a row */
+struct run {
+    unsigned long start;    // Position of its first reference in the process's trace
+    unsigned int next;      // Run of the next use of its page in the program, or NO_RUN
+    unsigned char page;
+    unsigned char exits;    // The program exits after its last reference
+};
+
+/*
+ *  One process slot: its runs (and one more, where its trace ends),
+ *  the run it is in and the references it made
+ */
+struct slot {
+    struct run* runs;
+    size_t nruns, size;
+    size_t run;
+    unsigned long position;
+    u_int32_t cached;       // Pages in memory or on their way in
+    int runs_now;           // Its page is in memory: it runs this tick
+};
+
+/* A page that could not come in, and the tick it is needed */
+struct want {
+    unsigned long at;
+    int proc, page;
+};
+
+static INSTANCE struct slot slots[MAXPROCESSES];
+
+/* The max-heap of cached pages by next use; a page's id is proc * MAXPROCPAGES + page */
+static INSTANCE int heap[NPAGES];
+static INSTANCE int heap_size;
+static INSTANCE int heap_at[NPAGES];             // Index of each page in the heap, or -1
+static INSTANCE unsigned long next_use[NPAGES];
+
+/* Frees the runs of each thread's slots when it exits */
+static pthread_key_t runs_key;
+static pthread_once_t runs_key_once = PTHREAD_ONCE_INIT;
+
+static void load(const char* path);
+static void index_runs(struct slot* s);
+static void create_runs_key(void);
+static void free_runs(void* thread_slots);
+static void advance(int proc, unsigned long tick);
+static void forget(int proc);
+static void heap_set(int id, unsigned long key);
+static void heap_remove(int id);
+static void sift_up(int i);
+static void sift_down(int i);
+static void swap_entries(int i, int j);
+
+void pageit(Pentry q[MAXPROCESSES]) {
+
+    /* Static vars */
+    static INSTANCE int initialized = 0;
+    static INSTANCE unsigned long tick = 0;
+    static INSTANCE int outs[PAGEWAIT];      // Pageouts started at each of the last PAGEWAIT ticks
+    static INSTANCE int outs_in_flight = 0;
+
+    /* Local vars */
+    struct want wants[NPAGES], w;
+    struct slot* s;
+    struct run* r;
+    unsigned long distance;
+    u_int32_t wanted;
+    size_t run;
+    int aside[NPAGES];
+    int proc, page, victim, nwants = 0, held, i, j;
+
+    /* Initialize static vars on first run */
+    if (!initialized) {
+        if (!replay_trace()) {
+            fprintf(stderr, "pager-opt needs the trace it replays: run it with -r\n");
+            exit(1);
+        }
+        load(replay_trace());
+        for (i = 0; i < NPAGES; i++) {
+            heap_at[i] = -1;
+        }
+        initialized = 1;
+    }
+    outs_in_flight -= outs[tick % PAGEWAIT];    // Those complete this tick
+    outs[tick % PAGEWAIT] = 0;
+
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        s = &slots[proc];
+        if (s -> runs_now) {
+            advance(proc, tick);
+        }
+        if (!q[proc].active) {
+            continue;
+        }
+        if (s -> run >= s -> nruns || s -> runs[s -> run].page != q[proc].pc / PAGESIZE) {
+            fprintf(stderr, "pager-opt: process %d is not replaying %s\n", proc, replay_trace());
+            exit(1);
+        }
+
+        /* The pages of its next HORIZON references that are not in memory */
+        wanted = 0;
+        for (run = s -> run; run < s -> nruns; run++) {
+            r = &s -> runs[run];
+            distance = run == s -> run ? 0 : r -> start - s -> position;
+            if (distance >= HORIZON) {
+                break;
+            }
+            page = r -> page;
+            if (!((s -> cached | wanted) & (1u << page))) {
+                wanted |= 1u << page;
+                wants[nwants].at = tick + distance;
+                wants[nwants].proc = proc;
+                wants[nwants++].page = page;
+            }
+            if (r -> exits) {
+                break;      // The next program starts with nothing in memory
+            }
+        }
+    }
+
+    /* Fetch them, soonest needed first, while there are free frames */
+    for (i = 1; i < nwants; i++) {
+        w = wants[i];
+        for (j = i; j > 0 && wants[j - 1].at > w.at; j--) {
+            wants[j] = wants[j - 1];
+        }
+        wants[j] = w;
+    }
+    for (i = j = 0; i < nwants; i++) {
+        w = wants[i];
+        if (pagein(w.proc, w.page)) {
+            slots[w.proc].cached |= 1u << w.page;
+            heap_set(w.proc * MAXPROCPAGES + w.page, w.at);
+        }
+        else {
+            wants[j++] = w;
+        }
+    }
+    nwants = j;
+
+    /*
+     *  Evict for the others, beyond those the pageouts in flight make
+     *  room for: the pages used furthest away, if after they are
+     *  needed. A page on its way in cannot go out yet: it is set
+     *  aside, and goes back into the heap after.
+     */
+    for (i = outs_in_flight, held = 0; i < nwants && heap_size;) {
+        victim = heap[0];
+        if (next_use[victim] <= wants[i].at) {
+            break;
+        }
+        if (!q[victim / MAXPROCPAGES].pages[victim % MAXPROCPAGES]) {
+            aside[held++] = victim;
+            heap_remove(victim);
+            continue;
+        }
+        if (!pageout(victim / MAXPROCPAGES, victim % MAXPROCPAGES)) {
+            break;
+        }
+        slots[victim / MAXPROCPAGES].cached &= ~(1u << (victim % MAXPROCPAGES));
+        heap_remove(victim);
+        outs[tick % PAGEWAIT]++;
+        outs_in_flight++;
+        i++;
+    }
+    while (held) {
+        victim = aside[--held];
+        heap_set(victim, next_use[victim]);
+    }
+
+    /* The processes whose page is in memory run one reference */
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        slots[proc].runs_now = q[proc].active && q[proc].pages[q[proc].pc / PAGESIZE];
+    }
+    tick++;
+}
+
+/* Read the whole trace into runs, and index their next uses */
+static void load(const char* path) {
+
+    struct trace* t;
+    struct trace_record r;
+    struct slot* s;
+    struct run* last;
+    int proc, page, status;
+
+    if (!(t = trace_open(path))) {
+        fprintf(stderr, "pager-opt: cannot read the trace \"%s\"\n", path);
+        exit(1);
+    }
+    while ((status = trace_read(t, &r)) == 1) {
+        s = &slots[r.proc];
+        page = r.pc / PAGESIZE;
+        if (r.pc < 0 || page >= MAXPROCPAGES) {
+            fprintf(stderr, "pager-opt: the trace \"%s\" has a pc out of range: %ld\n", path, r.pc);
+            exit(1);
+        }
+        last = s -> nruns ? &s -> runs[s -> nruns - 1] : NULL;
+        if (!last || last -> page != page || last -> exits) {
+            /* Room for this run and the one where the trace ends */
+            if (s -> nruns + 2 > s -> size) {
+                s -> size = s -> size ? 2 * s -> size : 1024;
+                if (!(s -> runs = realloc(s -> runs, s -> size * sizeof(struct run)))) {
+                    fprintf(stderr, "pager-opt: out of memory reading \"%s\"\n", path);
+                    exit(1);
+                }
+            }
+            last = &s -> runs[s -> nruns++];
+            last -> start = s -> position;
+            last -> page = page;
+            last -> exits = 0;
+        }
+        last -> exits = r.exited;
+        s -> position++;
+    }
+    if (status == -1) {
+        fprintf(stderr, "pager-opt: the trace \"%s\" is truncated\n", path);
+        exit(1);
+    }
+    trace_close(t);
+    pthread_once(&runs_key_once, create_runs_key);
+    pthread_setspecific(runs_key, slots);
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        index_runs(&slots[proc]);
+    }
+}
+
+/* Link each run to the next run of its program on the same page, from the end */
+static void index_runs(struct slot* s) {
+
+    unsigned int last[MAXPROCPAGES];
+    size_t run;
+    int page;
+
+    if (!s -> nruns) {
+        return;
+    }
+    s -> runs[s -> nruns].start = s -> position;   // Where the trace ends
+    s -> position = 0;
+    for (page = 0; page < MAXPROCPAGES; page++) {
+        last[page] = NO_RUN;
+    }
+    for (run = s -> nruns; run-- > 0;) {
+        if (s -> runs[run].exits) {
+            for (page = 0; page < MAXPROCPAGES; page++) {
+                last[page] = NO_RUN;
+            }
+        }
+        s -> runs[run].next = last[s -> runs[run].page];
+        last[s -> runs[run].page] = run;
+    }
+}
+
+static void create_runs_key(void) {
+    pthread_key_create(&runs_key, free_runs);
+}
+
+/* The thread of a simulation exits: free the runs of its slots */
+static void free_runs(void* thread_slots) {
+
+    struct slot* s = thread_slots;
+    int proc;
+
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        free(s[proc].runs);
+        s[proc].runs = NULL;
+    }
+}
+
+/* A process ran one reference: move on to its next run at the end of this one */
+static void advance(int proc, unsigned long tick) {
+
+    struct slot* s = &slots[proc];
+    struct run* r = &s -> runs[s -> run];
+    int id = proc * MAXPROCPAGES + r -> page;
+
+    if (++s -> position < r[1].start) {
+        return;
+    }
+    s -> run++;
+    if (r -> exits || s -> run == s -> nruns) {
+        forget(proc);   // The program exited and freed its pages
+        return;
+    }
+    if (s -> cached & (1u << r -> page)) {
+        heap_set(id, r -> next == NO_RUN ? NEVER : tick + (s -> runs[r -> next].start - s -> position));
+    }
+    if (s -> cached & (1u << r[1].page)) {
+        heap_set(proc * MAXPROCPAGES + r[1].page, tick);   // In use
+    }
+}
+
+/* Drop the pages of a process that exited */
+static void forget(int proc) {
+
+    struct slot* s = &slots[proc];
+    int page;
+
+    while (s -> cached) {
+        page = __builtin_ctz(s -> cached);
+        heap_remove(proc * MAXPROCPAGES + page);
+        s -> cached &= s -> cached - 1;
+    }
+}
+
+/* Insert a page in the heap, or move it to its new next use */
+static void heap_set(int id, unsigned long key) {
+
+    int i = heap_at[id];
+
+    if (i == -1) {
+        i = heap_size++;
+        heap[i] = id;
+        heap_at[id] = i;
+        next_use[id] = key;
+        sift_up(i);
+    }
+    else if (key > next_use[id]) {
+        next_use[id] = key;
+        sift_up(i);
+    }
+    else {
+        next_use[id] = key;
+        sift_down(i);
+    }
+}
+
+static void heap_remove(int id) {
+
+    int i = heap_at[id], moved;
+
+    if (i == -1) {
+        return;
+    }
+    heap_at[id] = -1;
+    if (i == --heap_size) {
+        return;
+    }
+    moved = heap[heap_size];
+    heap[i] = moved;
+    heap_at[moved] = i;
+    sift_up(i);
+    sift_down(heap_at[moved]);
+}
+
+static void sift_up(int i) {
+    while (i > 0 && next_use[heap[(i - 1) / 2]] < next_use[heap[i]]) {
+        swap_entries(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void sift_down(int i) {
+
+    int largest, child;
+
+    for (;;) {
+        largest = i;
+        for (child = 2 * i + 1; child <= 2 * i + 2 && child < heap_size; child++) {
+            if (next_use[heap[child]] > next_use[heap[largest]]) {
+                largest = child;
+            }
+        }
+        if (largest == i) {
+            return;
+        }
+        swap_entries(i, largest);
+        i = largest;
+    }
+}
+
+static void swap_entries(int i, int j) {
+
+    int id = heap[i];
+
+    heap[i] = heap[j];
+    heap[j] = id;
+    heap_at[heap[i]] = i;
+    heap_at[heap[j]] = j;
+}
@@ -0,0 +1,159 @@
+/*
+ * File: pager-policy.c
+ *
+ * Description:
+ *     The pageit() of the replacement policies (pager-arc.c,
+ *     pager-2q.c, pager-lirs.c and pager-wsclock.c), which are
+ *     linked with it. Pages are only paged in on a fault. Every
+ *     active process may hold an equal share of the simulator's
+ *     frames ('-f'), its budget: a process at its budget evicts one
+ *     of its own pages, chosen by the policy, before its next
+ *     pagein. A process under its budget that finds no free frame
+ *     waits for the pageouts in flight, and evicts a page itself if
+ *     it has none of its own in flight (when other processes still
+ *     hold more than their share, as after the number of active
+ *     processes grows).
+ *
+ *     The simulator does not tell the pager when a program exits:
+ *     its pages just leave memory, so a page the pager knows to
+ *     hold a frame that is not in memory, and not on its way in,
+ *     means a new program started in the slot.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "simulator.h"
+#include "pager-policy.h"
+
+/*
+ *  Frames held by one process
+ *
+ *   cached:   pages in memory or on their way in
+ *   coming:   pages on their way in, since coming_at[page]
+ *   last_out: tick of its last pageout
+ *   last:     page of its last reference, or -1
+ */
+struct frames {
+    u_int32_t cached;
+    u_int32_t coming;
+    u_int32_t last_out;
+    int last;
+    u_int32_t coming_at[MAXPROCPAGES];
+};
+
+static INSTANCE struct frames frames[MAXPROCESSES];
+
+static void fault(int proc, int page, int budget, u_int32_t resident, u_int32_t tick);
+static void admit(int proc, int page, int budget, u_int32_t tick);
+
+void pageit(Pentry q[MAXPROCESSES]) {
+
+    /* Static vars */
+    static INSTANCE int initialized = 0;
+    static INSTANCE u_int32_t tick = PAGEWAIT;   // artificial time
+
+    /* Local vars */
+    struct frames* f;
+    u_int32_t resident, bit, m;
+    int proc, page, i, active = 0, budget;
+
+    /* Initialize static vars on first run */
+    if (!initialized) {
+        for (proc = 0; proc < MAXPROCESSES; proc++) {
+            frames[proc].last = -1;
+            policy_reset(proc);
+        }
+        initialized = 1;
+    }
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        active += q[proc].active != 0;
+    }
+    budget = active ? physical_frames() / active : physical_frames();
+    if (budget < 1) {
+        budget = 1;
+    }
+
+    /* Select an active process */
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        if (q[proc].active) {
+            f = &frames[proc];
+            page = q[proc].pc / PAGESIZE;   // Get the requested page
+            bit = 1u << page;
+
+            /* The page is in memory, or on its way in */
+            if (f -> cached & bit) {
+                if (q[proc].pages[page]) {
+                    if (page != f -> last) {
+                        policy_reference(proc, page, tick);
+                        f -> last = page;
+                    }
+                    continue;
+                }
+                if ((f -> coming & bit) && tick - f -> coming_at[page] <= PAGEWAIT) {
+                    continue;
+                }
+            }
+
+            resident = 0;
+            for (i = 0; i < MAXPROCPAGES; i++) {
+                if (q[proc].pages[i]) {
+                    resident |= 1u << i;
+                }
+            }
+            /* Pageins complete in PAGEWAIT ticks */
+            for (m = f -> coming & ~resident; m; m &= m - 1) {
+                i = __builtin_ctz(m);
+                if (tick - f -> coming_at[i] > PAGEWAIT) {
+                    f -> coming &= ~(1u << i);
+                }
+            }
+            f -> coming &= ~resident;
+
+            /* A page left memory without a pageout: a new program started */
+            if (f -> cached & ~resident & ~f -> coming) {
+                f -> cached = f -> coming = 0;
+                f -> last = -1;
+                policy_reset(proc);
+            }
+            fault(proc, page, budget, resident, tick);
+        }
+    }
+    tick++;
+}
+
+/* The process needs a page that holds no frame: make room if needed, and page it in */
+static void fault(int proc, int page, int budget, u_int32_t resident, u_int32_t tick) {
+    struct frames* f = &frames[proc];
+    int victim, over = __builtin_popcount(f -> cached) >= budget;
+
+    if (!over && pagein(proc, page)) {
+        admit(proc, page, budget, tick);
+        return;
+    }
+    /* At its budget, or no frame is free and none of its pageouts is in flight.
+       The policy forgets its victim, so ask only once the pageout can start */
+    if ((over || tick - f -> last_out >= PAGEWAIT) && !swap_busy()) {
+        victim = policy_victim(proc, page, budget, resident & ~(1u << page), tick);
+        if (victim == -1 || !pageout(proc, victim)) {
+            return;
+        }
+        f -> cached &= ~(1u << victim);
+        f -> last_out = tick;
+        if (__builtin_popcount(f -> cached) < budget && pagein(proc, page)) {
+            admit(proc, page, budget, tick);
+        }
+    }
+}
+
+/* The pagein of a faulting page started */
+static void admit(int proc, int page, int budget, u_int32_t tick) {
+    struct frames* f = &frames[proc];
+
+    f -> cached |= 1u << page;
+    f -> coming |= 1u << page;
+    f -> coming_at[page] = tick;
+    f -> last = page;
+    policy_admit(proc, page, budget, tick);
+}
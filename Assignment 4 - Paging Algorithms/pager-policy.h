@@ -0,0 +1,100 @@
+/*
+ * File: pager-policy.h
+ *
+ * Description:
+ *     Interface between pager-policy.c and the replacement policies
+ *     it runs (pager-arc.c, pager-2q.c, pager-lirs.c and
+ *     pager-wsclock.c). pager-policy.c implements pageit(): it keeps
+ *     track of the pages of each process that hold a frame, gives
+ *     each process an equal share of the frames (its budget), and
+ *     notices when a program exits. The policy only decides which
+ *     page of a process to evict.
+ *
+ *     The policies keep their pages in per-process lists (struct
+ *     page_list), with O(1) operations.
+ */
+
+#ifndef PAGER_POLICY_H
+#define PAGER_POLICY_H
+
+#include <sys/types.h>
+#include "simulator.h"
+
+/*
+ *  Implemented by the policy. 'budget' is the number of frames the
+ *  process may hold, 'tick' the pager's artificial time.
+ *
+ *   policy_reset:     a new program starts in the slot: forget its pages
+ *   policy_reference: the process moved to 'page', which is in memory
+ *   policy_admit:     'page' faulted and its pagein started
+ *   policy_victim:    pick a page to evict before 'page' is admitted, from
+ *                     the pages in 'evictable', and forget it (a policy may
+ *                     keep its history). Returns -1 if there is none.
+ */
+void policy_reset(int proc);
+void policy_reference(int proc, int page, u_int32_t tick);
+void policy_admit(int proc, int page, int budget, u_int32_t tick);
+int policy_victim(int proc, int page, int budget, u_int32_t evictable, u_int32_t tick);
+
+/*
+ *  List of some pages of one process, from the oldest to the most
+ *  recent. Nodes are indexed by page; node LIST_END is the sentinel,
+ *  whose next is the oldest page and whose prev the most recent.
+ */
+#define LIST_END MAXPROCPAGES
+
+struct page_list {
+    int prev[MAXPROCPAGES + 1];
+    int next[MAXPROCPAGES + 1];
+    char in[MAXPROCPAGES];
+    int size;
+};
+
+static inline void list_init(struct page_list* l) {
+    int page;
+
+    l -> prev[LIST_END] = l -> next[LIST_END] = LIST_END;
+    for (page = 0; page < MAXPROCPAGES; page++) {
+        l -> in[page] = 0;
+    }
+    l -> size = 0;
+}
+
+static inline void list_remove(struct page_list* l, int page) {
+    l -> next[l -> prev[page]] = l -> next[page];
+    l -> prev[l -> next[page]] = l -> prev[page];
+    l -> in[page] = 0;
+    l -> size--;
+}
+
+/* Add the page at the most recent end, or move it there */
+static inline void list_push(struct page_list* l, int page) {
+    if (l -> in[page]) {
+        list_remove(l, page);
+    }
+    l -> prev[page] = l -> prev[LIST_END];
+    l -> next[page] = LIST_END;
+    l -> next[l -> prev[LIST_END]] = page;
+    l -> prev[LIST_END] = page;
+    l -> in[page] = 1;
+    l -> size++;
+}
+
+/* The oldest page, or -1 */
+static inline int list_oldest(const struct page_list* l) {
+    return l -> next[LIST_END] == LIST_END ? -1 : l -> next[LIST_END];
+}
+
+/* The oldest page in 'pages', or -1: pages not in it are passed over */
+static inline int list_oldest_of(const struct page_list* l, u_int32_t pages) {
+    int page;
+
+    for (page = l -> next[LIST_END]; page != LIST_END; page = l -> next[page]) {
+        if (pages & (1u << page)) {
+            return page;
+        }
+    }
+    return -1;
+}
+
+#endif
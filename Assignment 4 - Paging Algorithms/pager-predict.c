@@ -20,6 +20,32 @@
  * Please refer to cochran_PA4/PA4_README/PAGER_PREDICT_INFO.pdf 
  * for more information on constructing the matrices used in 
  * pager-predict.c 
+ *
+ * The matrices are built with -DPREDICT_STATIC. By default the
+ * pager learns them instead, for each process, as it runs:
+ *
+ *     - every time a process moves to another page, the move is
+ *       counted in a row of transition counts for the page it left
+ *       (one step) and for the page before that (two steps)
+ *     - a row whose total passes DECAY_LIMIT is halved, so old
+ *       transitions fade and a new program in the slot takes over
+ *     - a page is predicted if its share of the current page's row
+ *       is at least the process's threshold, in either matrix
+ *     - the threshold adapts: a predicted page paged in and then
+ *       referenced lowers it by THRESHOLD_STEP, one paged out again
+ *       before it was referenced raises it by as much
+ *
+ *     The counts are kept for all MAXPROCPAGES pages.
+ *
+ * Both versions keep the state of each process in its own block
+ * (struct process), its pages as bitmasks (MAXPROCPAGES <= 32):
+ * the pages predicted from its current page, and its working set,
+ * the pages it referenced in the last two windows of WS_WINDOW
+ * ticks. Pages outside both are paged out. Pages of the working
+ * set stay in memory even when they are not predicted, so a page
+ * the process comes back to is not paged out and in again, unless
+ * frames are short: for SHORT_TICKS after a pagein found no free
+ * frame, only the predicted pages are kept.
  *  
  */
 
@@ -28,47 +54,389 @@
 #include <sys/types.h>
 
 #include "simulator.h"
-#include "pager-predict.h"
+
+#define WS_WINDOW       5000            // Ticks in one window of the working set
+#define SHORT_TICKS     (10 * PAGEWAIT) // Working sets are not held for this long after
+                                        // a pagein found no free frame
+#define PREFETCH_BUDGET 8               // Prefetches started in one tick at most
+#define SWAP_BUDGET     60              // No prefetch while this many swaps are in flight
+#define EVICT_DELAY     PAGEWAIT        // Ticks a page that may come back stays in memory
+#define TWO_STEP        0.5             // Urgency of a page two moves away (one move: 1)
+
+/*
+ *  State of one process, as bitmasks of its pages
+ *
+ *   resident:   in memory, this tick
+ *   predicted:  pages predicted from its current page
+ *   prefetched: paged in on a prediction, not referenced yet
+ *   coming:     pagein started at coming_at[page], not in memory yet
+ *   going:      pageout started at going_at[page], maybe not out yet
+ *   leaving:    no longer wanted since left_at[page], still in memory
+ *   recent:     referenced in this window of the working set
+ *   older:      referenced in the window before
+ *
+ *  chance[page] is the probability of a reference to the page soon,
+ *  weighted by how soon, from the current page.
+ */
+struct process {
+    u_int32_t resident;
+    u_int32_t predicted;
+    u_int32_t prefetched;
+    u_int32_t coming;
+    u_int32_t going;
+    u_int32_t leaving;
+    u_int32_t recent;
+    u_int32_t older;
+    u_int32_t window_start;
+    int last;                   // Page predicted from, or -1
+    float chance[MAXPROCPAGES];
+    u_int32_t coming_at[MAXPROCPAGES];
+    u_int32_t going_at[MAXPROCPAGES];
+    u_int32_t left_at[MAXPROCPAGES];
+};
+
+/* A page to prefetch, ranked by its score */
+struct candidate {
+    float score;
+    int proc, page;
+};
+
+static INSTANCE struct process procs[MAXPROCESSES];
+static INSTANCE u_int32_t tick = 0;          // artificial time
+static INSTANCE u_int32_t short_until = 0;   // Frames are short until this tick
+static INSTANCE u_int16_t started[PAGEWAIT]; // Swaps started in each of the last PAGEWAIT ticks
+static INSTANCE int in_flight = 0;           // Sum of 'started': swaps not complete yet
+
+static u_int32_t predict(int proc, int page, long npages);
+static void feedback(int proc, int used);
+static void evict(struct process* s, int proc, u_int32_t pages);
+static void fetch(struct process* s, int proc, int page);
+static void schedule(struct candidate candidates[], int n);
 
 void pageit(Pentry q[MAXPROCESSES]) { 
 
     /* Static vars */
-    static int initialized = 0;
-    static int ref_bits[15];
+    static INSTANCE int initialized = 0;
+    static INSTANCE struct candidate candidates[MAXPROCESSES * MAXPROCPAGES];
     
     /* Local vars */
-    int proc, page;
+    struct process* s;
+    u_int32_t resident, wanted, keep, bit, m;
+    int proc, page, i, n = 0;
 
     /* Initialize static vars on first run */
-    if(!initialized) {
-        for (int i=0; i < MAXPROCESSES; i++) {
-            ref_bits[i] = 0;  // init reference bits
+    if (!initialized) {
+        for (proc = 0; proc < MAXPROCESSES; proc++) {
+            procs[proc].last = -1;
         }
         initialized = 1;
     }
+    /* The swaps started PAGEWAIT ticks ago are complete */
+    in_flight -= started[tick % PAGEWAIT];
+    started[tick % PAGEWAIT] = 0;
+
     /* Select an active process */
-    for(proc=0; proc < MAXPROCESSES; proc++) {
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
         if (q[proc].active) {
-            page = q[proc].pc/PAGESIZE;   // Get the requested page
-            ref_bits[page] = 1;           // Add a reference bit for the requested page
+            s = &procs[proc];
+            page = q[proc].pc / PAGESIZE;   // Get the requested page
+            bit = 1u << page;
 
-            /* Predict future page references by indexing the probability transiton matrices */
-            for (int i=0; i < 15; i++) {  
-                if (markov_one_step[page][i] >= 0.200 || markov_two_step[page][i] >= 0.170) {
-                    ref_bits[i] = 1;  // Add a reference bit for the predicted page
-                }
+            /* Start a new window of the working set */
+            if (tick - s -> window_start >= WS_WINDOW) {
+                s -> older = s -> recent;
+                s -> recent = 0;
+                s -> window_start = tick;
             }
+            s -> recent |= bit;
 
-            /* Page-in the requested and predicted pages */
-            for (int i=0; i < 15; i++) {
-                if (q[proc].pages[i] && ref_bits[i] == 0) {
-                    pageout(proc, i);
+            /* A move to another page: predict from the new page */
+            if (page != s -> last) {
+                s -> predicted = predict(proc, page, q[proc].npages) | bit;
+                s -> last = page;
+            }
+            /* A prefetched page was needed */
+            if (s -> prefetched & bit) {
+                s -> prefetched &= ~bit;
+                feedback(proc, 1);
+            }
+
+            resident = 0;
+            for (i = 0; i < MAXPROCPAGES; i++) {
+                if (q[proc].pages[i]) {
+                    resident |= 1u << i;
                 }
-                if (!q[proc].pages[i] && ref_bits[i] == 1) {
-                    pagein(proc, i);
+            }
+            /* Pageins complete in PAGEWAIT ticks, or never if the process exited */
+            for (m = s -> coming & ~resident; m; m &= m - 1) {
+                i = __builtin_ctz(m);
+                if (tick - s -> coming_at[i] > PAGEWAIT) {
+                    s -> coming &= ~(1u << i);
                 }
-                ref_bits[i] = 0;  // Reset reference bits
+            }
+            s -> coming &= ~resident;
+            s -> resident = resident;
+            wanted = s -> predicted;
+            keep = tick < short_until ? wanted : wanted | s -> recent | s -> older;
+
+            /* Page-out the pages neither predicted nor in the working set */
+            evict(s, proc, resident & ~keep);
+            s -> leaving &= resident & ~keep;
+
+            /* Page-in the requested page now, and rank the predicted ones */
+            if (!((resident | s -> coming) & bit)) {
+                fetch(s, proc, page);
+            }
+            for (m = wanted & ~resident & ~s -> coming & ~bit; m; m &= m - 1) {
+                i = __builtin_ctz(m);
+                candidates[n].score = s -> chance[i];
+                candidates[n].proc = proc;
+                candidates[n].page = i;
+                n++;
             }
         }
     }
+    schedule(candidates, n);
+    tick++;
 } 
+
+/*
+ *  Page-out pages that are no longer wanted. A page that may come
+ *  back soon (a chance from the current page) is paged out only
+ *  after EVICT_DELAY ticks, if it is still not wanted.
+ */
+static void evict(struct process* s, int proc, u_int32_t pages) {
+    u_int32_t m;
+    int i;
+
+    for (m = pages; m; m &= m - 1) {
+        i = __builtin_ctz(m);
+        if (!(s -> leaving & (1u << i))) {
+            s -> leaving |= 1u << i;
+            s -> left_at[i] = tick;
+        }
+        if (s -> chance[i] > 0 && tick >= short_until && tick - s -> left_at[i] < EVICT_DELAY) {
+            continue;
+        }
+        if (!pageout(proc, i)) {
+            continue;
+        }
+        started[tick % PAGEWAIT]++;
+        in_flight++;
+        s -> going |= 1u << i;
+        s -> going_at[i] = tick;
+        s -> leaving &= ~(1u << i);
+        if (s -> prefetched & (1u << i)) {  // It was never needed
+            s -> prefetched &= ~(1u << i);
+            feedback(proc, 0);
+        }
+    }
+}
+
+/*
+ *  Start a pagein, and count it in flight. A page in memory or on
+ *  its way in starts no swap, and a page on its way out cannot be
+ *  paged in until it is out: only a failed pagein of any other page
+ *  means no frame is free.
+ */
+static void fetch(struct process* s, int proc, int page) {
+    u_int32_t bit = 1u << page;
+
+    if ((s -> resident | s -> coming) & bit) {
+        return;
+    }
+    if (s -> going & bit) {
+        if (tick - s -> going_at[page] <= PAGEWAIT) {
+            return;
+        }
+        s -> going &= ~bit;
+    }
+    if (!pagein(proc, page)) {
+        short_until = tick + SHORT_TICKS;
+        return;
+    }
+    started[tick % PAGEWAIT]++;
+    in_flight++;
+    s -> coming |= 1u << page;
+    s -> coming_at[page] = tick;
+}
+
+/*
+ *  Prefetch the candidates with the best scores, PREFETCH_BUDGET at
+ *  most, and none while SWAP_BUDGET swaps are in flight: requested
+ *  pages have the swap device first.
+ */
+static void schedule(struct candidate candidates[], int n) {
+    struct candidate c;
+    struct process* s;
+    int budget = SWAP_BUDGET - in_flight, i, j, best;
+
+    if (budget > PREFETCH_BUDGET) {
+        budget = PREFETCH_BUDGET;
+    }
+    for (i = 0; i < budget && i < n; i++) {
+        best = i;
+        for (j = i + 1; j < n; j++) {
+            if (candidates[j].score > candidates[best].score) {
+                best = j;
+            }
+        }
+        c = candidates[best];
+        candidates[best] = candidates[i];
+        candidates[i] = c;
+
+        s = &procs[c.proc];
+        fetch(s, c.proc, c.page);
+        if (s -> coming & (1u << c.page)) {
+            s -> prefetched |= 1u << c.page;
+        }
+    }
+}
+
+#if defined(PREDICT_STATIC)
+
+#include "pager-predict.h"
+
+#define ONE_STEP_THRESHOLD  0.200   // Probability a page needs in markov_one_step to be predicted
+#define TWO_STEP_THRESHOLD  0.170   // ... or in markov_two_step
+
+static INSTANCE double one_threshold, two_threshold;    // '-P one_step=...', '-P two_step=...'
+
+/* Predict future page references by indexing the probability transiton matrices */
+static u_int32_t predict(int proc, int page, long npages) {
+
+    /* Static vars */
+    static INSTANCE int initialized = 0;
+
+    /* Local vars */
+    float* chance = procs[proc].chance;
+    u_int32_t predicted = 0;
+    int i;
+    (void)npages;
+
+    /* Initialize static vars on first run */
+    if (!initialized) {
+        one_threshold = pager_param("one_step", ONE_STEP_THRESHOLD);
+        two_threshold = pager_param("two_step", TWO_STEP_THRESHOLD);
+        initialized = 1;
+    }
+    for (i = 0; i < MAXPROCPAGES; i++) {
+        chance[i] = 0;
+    }
+    if (page >= 15) {
+        return 0;   // Outside the matrices
+    }
+    for (i = 0; i < 15; i++) {
+        if (markov_one_step[page][i] >= one_threshold || markov_two_step[page][i] >= two_threshold) {
+            predicted |= 1u << i;
+        }
+        chance[i] = markov_one_step[page][i] > TWO_STEP * markov_two_step[page][i] ?
+                    markov_one_step[page][i] : TWO_STEP * markov_two_step[page][i];
+    }
+    return predicted;
+}
+
+/* The thresholds of the matrices are fixed */
+static void feedback(int proc, int used) {
+    (void)proc;
+    (void)used;
+}
+
+#else
+#define DECAY_LIMIT       64      // Transitions counted in a row before it is halved
+#define THRESHOLD_START   0.200   // Share of a row a page needs to be predicted ('-P threshold=...')
+#define THRESHOLD_MIN     0.050
+#define THRESHOLD_MAX     0.500
+#define THRESHOLD_STEP    0.005
+
+/*
+ *  Transition counts learned for one process. Row r of 'one' counts
+ *  the pages that came right after page r, row r of 'two' the pages
+ *  that came after the next one.
+ */
+struct predictor {
+    u_int16_t one[MAXPROCPAGES][MAXPROCPAGES];
+    u_int16_t two[MAXPROCPAGES][MAXPROCPAGES];
+    u_int16_t one_total[MAXPROCPAGES];
+    u_int16_t two_total[MAXPROCPAGES];
+    int last, before_last;              // Pages of the last two moves, or -1
+    double threshold;
+};
+
+static INSTANCE struct predictor predictors[MAXPROCESSES];
+
+static void learn(struct predictor* p, int page);
+static void count(u_int16_t counts[], u_int16_t* total, int page);
+
+/* Count the move to 'page' from the last page, and from the one before */
+static void learn(struct predictor* p, int page) {
+    if (p -> last != -1) {
+        count(p -> one[p -> last], &p -> one_total[p -> last], page);
+    }
+    if (p -> before_last != -1) {
+        count(p -> two[p -> before_last], &p -> two_total[p -> before_last], page);
+    }
+    p -> before_last = p -> last;
+    p -> last = page;
+}
+
+/* Add one to a row of counts, and halve the row once it passes DECAY_LIMIT */
+static void count(u_int16_t counts[], u_int16_t* total, int page) {
+    int i;
+
+    counts[page]++;
+    if (++*total >= DECAY_LIMIT) {
+        *total = 0;
+        for (i = 0; i < MAXPROCPAGES; i++) {
+            counts[i] /= 2;
+            *total += counts[i];
+        }
+    }
+}
+
+/* Learn the move to 'page', then predict every page at or above the threshold */
+static u_int32_t predict(int proc, int page, long npages) {
+
+    /* Static vars */
+    static INSTANCE int initialized = 0;
+
+    /* Local vars */
+    struct predictor* p = &predictors[proc];
+    float* chance = procs[proc].chance;
+    float one, two;
+    u_int32_t predicted = 0;
+    int i;
+
+    /* Initialize static vars on first run */
+    if (!initialized) {
+        for (i = 0; i < MAXPROCESSES; i++) {
+            predictors[i].last = predictors[i].before_last = -1;
+            predictors[i].threshold = pager_param("threshold", THRESHOLD_START);
+        }
+        initialized = 1;
+    }
+    learn(p, page);
+    for (i = 0; i < MAXPROCPAGES; i++) {
+        one = p -> one_total[page] ? (float)p -> one[page][i] / p -> one_total[page] : 0;
+        two = p -> two_total[page] ? (float)p -> two[page][i] / p -> two_total[page] : 0;
+        chance[i] = i < npages ? (one > TWO_STEP * two ? one : TWO_STEP * two) : 0;
+        if (i < npages && (one >= p -> threshold || two >= p -> threshold)) {
+            predicted |= 1u << i;
+        }
+    }
+    return predicted;
+}
+
+/* A prefetched page was used: predict a little more. It was not: a little less */
+static void feedback(int proc, int used) {
+    struct predictor* p = &predictors[proc];
+
+    if (used && p -> threshold > THRESHOLD_MIN) {
+        p -> threshold -= THRESHOLD_STEP;
+    }
+    if (!used && p -> threshold < THRESHOLD_MAX) {
+        p -> threshold += THRESHOLD_STEP;
+    }
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * File: pager-wsclock.c
+ *
+ * Description:
+ *     WSClock (Carr and Hennessy): the working set model with a
+ *     clock, for the pages of each process, run by pager-policy.c.
+ *     A process's working set is the pages it referenced in the
+ *     last WS_WINDOW ticks. A reference sets the page's bit and its
+ *     time of last use. On a fault the hand sweeps the pages in
+ *     memory: a page with its bit set gets it cleared and its time
+ *     of last use set to now; the first page without it that is
+ *     older than the window, out of the working set, is evicted.
+ *     If a whole turn finds none, the oldest page is.
+ *
+ *     Like the clock of pager-lru.c, the pages in memory and their
+ *     bits are bitmasks, so the hand skips the others.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "simulator.h"
+#include "pager-policy.h"
+
+#define WS_WINDOW   200     // Ticks a page stays in the working set without a reference
+
+struct ws_clock {
+    u_int32_t cached;       // Pages in memory or on their way in
+    u_int32_t referenced;
+    u_int32_t last_use[MAXPROCPAGES];
+    int hand;
+};
+
+static INSTANCE struct ws_clock clocks[MAXPROCESSES];
+
+void policy_reset(int proc) {
+    clocks[proc].cached = 0;
+    clocks[proc].referenced = 0;
+    clocks[proc].hand = 0;
+}
+
+void policy_reference(int proc, int page, u_int32_t tick) {
+    struct ws_clock* c = &clocks[proc];
+
+    c -> referenced |= 1u << page;
+    c -> last_use[page] = tick;
+}
+
+void policy_admit(int proc, int page, int budget, u_int32_t tick) {
+    struct ws_clock* c = &clocks[proc];
+    (void)budget;
+
+    c -> cached |= 1u << page;
+    c -> referenced |= 1u << page;
+    c -> last_use[page] = tick;
+}
+
+/* Sweep the hand over the evictable pages, one turn at most */
+int policy_victim(int proc, int page, int budget, u_int32_t evictable, u_int32_t tick) {
+    struct ws_clock* c = &clocks[proc];
+    u_int32_t candidates = c -> cached & evictable, left = candidates, ahead, bit;
+    int candidate, victim = -1;
+    (void)page;
+    (void)budget;
+
+    while (left) {
+        ahead = left & (~0u << c -> hand);
+        candidate = __builtin_ctz(ahead ? ahead : left);
+        c -> hand = (candidate + 1) % MAXPROCPAGES;
+        bit = 1u << candidate;
+        left &= ~bit;
+        if (c -> referenced & bit) {
+            c -> referenced &= ~bit;
+            c -> last_use[candidate] = tick;
+        }
+        else if (tick - c -> last_use[candidate] > WS_WINDOW) {
+            victim = candidate;     // Out of the working set
+            break;
+        }
+        if (victim == -1 || c -> last_use[candidate] < c -> last_use[victim]) {
+            victim = candidate;
+        }
+    }
+    if (victim != -1) {
+        c -> cached &= ~(1u << victim);
+        c -> referenced &= ~(1u << victim);
+    }
+    return victim;
+}
@@ -0,0 +1,64 @@
+/*
+ * File: programs.c
+ *
+ * Description:
+ *     The programs run by the paging simulator, included by
+ *     simulator.c. A program is a control flow graph of blocks:
+ *     a process executes the program counters of its block one
+ *     per tick, then jumps to one of the block's successors,
+ *     chosen at random by weight, or exits. Every program uses
+ *     pages 0 to 14.
+ *
+ *         loop     one large loop over pages 0-11, then an exit
+ *                  path through pages 12-14
+ *         nested   an inner loop (pages 2-5) inside an outer loop
+ *                  (pages 0-8), then pages 9-14 once
+ *         calls    a main loop (pages 0-3 and 4-9) calling one of
+ *                  two functions (pages 10-11 or 12-14)
+ *         linear   passes over all 15 pages in order
+ *         jumps    short runs with jumps between distant pages
+ */
+
+#define MAXBLOCKS   6       // Blocks in one program
+#define MAXNEXT     3       // Successors of one block
+#define EXIT        -1      // Successor that ends the process
+
+struct block {
+    long start, end;        // First and last program counter
+    int next[MAXNEXT];      // Successor blocks, or EXIT
+    int weight[MAXNEXT];    // Chance of each successor, in percent
+};
+
+struct program {
+    const char* name;
+    long npages;
+    int nblocks;
+    struct block blocks[MAXBLOCKS];
+};
+
+static const struct program programs[] = {
+    { "loop", 15, 2, {
+        {    0, 1535, { 0, 1, EXIT }, { 95,   5, 0 } },
+        { 1536, 1919, { EXIT },       { 100         } } } },
+    { "nested", 15, 4, {
+        {    0,  255, { 1 },          { 100         } },
+        {  256,  767, { 1, 2 },       { 90,  10     } },
+        {  768, 1151, { 0, 3 },       { 85,  15     } },
+        { 1152, 1919, { EXIT },       { 100         } } } },
+    { "calls", 15, 5, {
+        {    0,  511, { 1, 2, 4 },    { 50,  40, 10 } },
+        { 1280, 1535, { 3 },          { 100         } },
+        { 1536, 1919, { 3 },          { 100         } },
+        {  512, 1279, { 0 },          { 100         } },
+        {    0,  127, { EXIT },       { 100         } } } },
+    { "linear", 15, 1, {
+        {    0, 1919, { 0, EXIT },    { 70,  30     } } } },
+    { "jumps", 15, 5, {
+        {    0,  383, { 1, 2, 3 },    { 34,  33, 33 } },
+        {  640, 1023, { 0, 4 },       { 80,  20     } },
+        { 1024, 1407, { 0, 4 },       { 80,  20     } },
+        { 1408, 1919, { 0, 4 },       { 80,  20     } },
+        {  384,  639, { 0, EXIT },    { 90,  10     } } } }
+};
+
+#define NPROGRAMS   (int)(sizeof(programs) / sizeof(programs[0]))
@@ -0,0 +1,55 @@
+/*
+ * File: simulation.h
+ *
+ * Description:
+ *     Running simulations from a program: the main() of the test
+ *     programs (simulator.c) and the sweep (sweep.c), which runs
+ *     many at once, each in a thread of its own. The state of a
+ *     simulation and of its pager is INSTANCE (simulator.h): built
+ *     with -DSWEEP it is thread-local, so simulations in different
+ *     threads do not share any.
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "simulator.h"
+
+#define MAXPARAMS       8       // Pager parameters of one simulation ('-P')
+
+/* A pager parameter: see pager_param() in simulator.h */
+struct sim_param {
+    const char* name;
+    double value;
+};
+
+/* The options of one simulation, as the test programs take them */
+struct sim_options {
+    void (*pageit)(Pentry q[MAXPROCESSES]);     // The pager
+    unsigned long seed, ticks;                  // '-s', '-t'
+    int nprocs, frames, swap_limit;             // '-p', '-f', '-b'
+    const char* workload;                       // '-w', NULL: mixed
+    const char* record_path;                    // '-o', or NULL
+    const char* replay_path;                    // '-r', or NULL
+    struct sim_param params[MAXPARAMS];         // '-P'
+    int nparams;
+};
+
+/* What a simulation counted */
+struct sim_results {
+    int nprocs;                 // Processes: the trace's in a replay
+    unsigned long ticks, references, faults, pageins, pageouts, blocked, started, busy;
+    unsigned long long pageit_cycles;
+    double seconds;
+};
+
+/*
+ *  sim_defaults: the options of a test program run without any.
+ *  simulate_run: run one simulation in this thread. Returns 0, or
+ *                -1 (and prints why) if an option is out of range,
+ *                the workload is unknown or a trace cannot be opened.
+ */
+void sim_defaults(struct sim_options* options);
+int simulate_run(const struct sim_options* options, struct sim_results* results);
+
+#endif
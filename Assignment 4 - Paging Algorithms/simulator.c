@@ -0,0 +1,714 @@
+/*
+ * File: simulator.c
+ *
+ * Description:
+ *     A deterministic paging simulator for the pagers in this
+ *     directory. MAXPROCESSES processes run the programs of
+ *     programs.c and share the frames of physical memory. Every
+ *     tick the simulator:
+ *
+ *         1. completes the swaps started PAGEWAIT ticks ago
+ *         2. calls the pager's pageit()
+ *         3. runs each process whose current page is in memory
+ *            for one program counter; a process whose page is not
+ *            in memory is blocked for the tick (a page fault the
+ *            first tick it is blocked on that page)
+ *
+ *     A process that exits frees its pages at once and the next
+ *     program starts in its slot. Every random choice comes from
+ *     one generator seeded with '-s', so a pager always makes the
+ *     same faults for the same seed.
+ *
+ *     The swap device has no limit on the swaps in flight, unless
+ *     '-b' sets one: then pagein() and pageout() fail while that
+ *     many are in flight, as they do when no frame is free.
+ *
+ *     '-o' records the program counters the processes execute to a
+ *     trace (trace.h), and '-r' replays one: each process runs the
+ *     program counters recorded for its slot instead of a program,
+ *     until the trace ends. The references of a trace do not depend
+ *     on the pager that recorded it, so it can be fed through any.
+ *
+ *     The score is the ratio of blocked ticks to compute ticks
+ *     over all processes: lower is better. The time stamp counter
+ *     is read around every pageit() call (on x86), to report the
+ *     pager's own cost in cycles per call.
+ *
+ *     '-P name=value' sets a parameter a pager reads with
+ *     pager_param(). A simulation is run by simulate_run()
+ *     (simulation.h), from main() or, built with -DSWEEP, from
+ *     the sweep (sweep.c): its state is INSTANCE, one per thread.
+ *
+ * Usage:
+ *     ./test-lru [-s seed] [-w workload] [-t ticks] [-p processes] [-f frames]
+ *               [-b swaps] [-o trace] [-r trace] [-P name=value]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#else
+#define cycles() 0ULL
+#endif
+
+#include "simulator.h"
+#include "simulation.h"
+#include "trace.h"
+#include "programs.c"
+
+#define MAXFRAMES       (MAXPROCESSES * MAXPROCPAGES)
+#define DEFAULT_TICKS   1000000
+#define DEFAULT_SEED    1
+
+/* States of a page */
+enum { OUT, IN, COMING_IN, GOING_OUT };
+
+/*
+ *  A swap in flight. Every swap takes PAGEWAIT ticks, so they
+ *  complete in the order they started: a FIFO holds them. 'gen' is
+ *  the generation of the process that started it; a swap outliving
+ *  its process only frees its frame.
+ */
+struct swap {
+    unsigned long done;     // Tick the swap completes
+    int proc, page, in;
+    unsigned gen;
+};
+
+/* A process running in one slot */
+struct process {
+    const struct program* prog;
+    int block;              // Block of the program counter
+    long blocked_on;        // Page the process is blocked on, or -1
+    unsigned gen;           // Incremented when the slot starts a program
+    int exits;              // Replay: the program exits after this pc
+};
+
+/*
+ *  Replay: the program counters read from the trace for one slot,
+ *  not run yet. A slot that runs ahead of the others makes the
+ *  trace be read further, and the records of the others wait here,
+ *  as spans of consecutive program counters: the last one ends in
+ *  an exit if 'exits' is set.
+ */
+struct replay_span {
+    u_int32_t pc, count, exits;
+};
+
+struct replay_queue {
+    struct replay_span* spans;
+    size_t head, count, size;
+};
+
+/* The state of one simulation */
+struct simulator {
+    Pentry q[MAXPROCESSES];
+    struct process procs[MAXPROCESSES];
+    unsigned char state[MAXPROCESSES][MAXPROCPAGES];
+    struct swap swaps[MAXFRAMES];
+    int swap_head, swap_count;
+    int free_frames;
+    unsigned long tick;
+    uint64_t rng;
+
+    /* Options */
+    void (*pageit)(Pentry q[MAXPROCESSES]);
+    unsigned long seed, ticks;
+    int nprocs, frames;
+    int swap_limit;                     // Swaps in flight at most, 0: no limit
+    const struct program* workload;     // NULL: a random program each time
+    const char* record_path;            // '-o'
+    const char* replay_path;            // '-r'
+    struct sim_param params[MAXPARAMS]; // '-P'
+    int nparams;
+
+    /* Traces */
+    struct trace* record;
+    struct trace* replay;
+    struct replay_queue queues[MAXPROCESSES];
+    int running;                        // Slots not at the end of the trace
+
+    /* Results */
+    unsigned long references, faults, pageins, pageouts, blocked, started, busy;
+    unsigned long long pageit_cycles;
+};
+
+static INSTANCE struct simulator* sim;  // The simulation pagein() and pageout() act on
+
+static void simulate(void);
+static void start_process(int proc);
+static void exit_process(int proc);
+static void run_process(int proc);
+static int next_reference(int proc, long* pc, int* exits);
+static void record(int proc, long pc, int exited);
+static void complete_swaps(void);
+static void start_swap(int proc, int page, int in);
+static uint64_t next_random(void);
+static void close_traces(struct simulator* s);
+
+#ifndef SWEEP
+static void print_results(const struct sim_options* options, const struct sim_results* results);
+static void usage(const char* name);
+
+int main(int argc, char* argv[]) {
+
+    struct sim_options options;
+    struct sim_results results;
+    char* value;
+    int opt;
+
+    sim_defaults(&options);
+    options.pageit = pageit;
+    while ((opt = getopt(argc, argv, "s:w:t:p:f:b:o:r:P:h")) != -1) {
+        switch (opt) {
+            case 's':
+                options.seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                options.workload = optarg;
+                break;
+            case 't':
+                options.ticks = strtoul(optarg, NULL, 10);
+                if (options.ticks < 1) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'p':
+                options.nprocs = atoi(optarg);
+                break;
+            case 'f':
+                options.frames = atoi(optarg);
+                break;
+            case 'b':
+                options.swap_limit = atoi(optarg);
+                break;
+            case 'o':
+                options.record_path = optarg;
+                break;
+            case 'r':
+                options.replay_path = optarg;
+                break;
+            case 'P':
+                if (!(value = strchr(optarg, '=')) || options.nparams == MAXPARAMS) {
+                    usage(argv[0]);
+                }
+                *value++ = '\0';
+                options.params[options.nparams].name = optarg;
+                options.params[options.nparams++].value = atof(value);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind < argc) {
+        usage(argv[0]);
+    }
+    if (simulate_run(&options, &results)) {
+        usage(argv[0]);
+    }
+    print_results(&options, &results);
+    return 0;
+}
+#endif
+
+/* The options of a test program run without any: see simulation.h */
+void sim_defaults(struct sim_options* options) {
+    memset(options, 0, sizeof(*options));
+    options -> seed = DEFAULT_SEED;
+    options -> nprocs = MAXPROCESSES;
+    options -> frames = PHYSICALPAGES;
+}
+
+/* Run one simulation in this thread: see simulation.h */
+int simulate_run(const struct sim_options* options, struct sim_results* results) {
+
+    struct simulator* s;
+    struct timespec start, end;
+    int i;
+
+    if (options -> nprocs < 1 || options -> nprocs > MAXPROCESSES || options -> frames < 1 ||
+        options -> frames > MAXFRAMES || options -> swap_limit < 0 ||
+        options -> nparams < 0 || options -> nparams > MAXPARAMS) {
+        fprintf(stderr, "Options out of range\n");
+        return -1;
+    }
+    if (!(s = calloc(1, sizeof(*s)))) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    s -> pageit = options -> pageit;
+    s -> seed = options -> seed;
+    s -> ticks = options -> ticks ? options -> ticks : DEFAULT_TICKS;
+    s -> nprocs = options -> nprocs;
+    s -> frames = options -> frames;
+    s -> swap_limit = options -> swap_limit;
+    s -> record_path = options -> record_path;
+    s -> replay_path = options -> replay_path;
+    s -> nparams = options -> nparams;
+    memcpy(s -> params, options -> params, sizeof(s -> params));
+    if (options -> workload && strcmp(options -> workload, "mixed")) {
+        for (i = 0; i < NPROGRAMS && strcmp(options -> workload, programs[i].name); i++);
+        if (i == NPROGRAMS) {
+            fprintf(stderr, "Unknown workload \"%s\"\n", options -> workload);
+            free(s);
+            return -1;
+        }
+        s -> workload = &programs[i];
+    }
+
+    /* A replay runs to the end of the trace, with as many processes as it has */
+    if (s -> replay_path) {
+        if (!(s -> replay = trace_open(s -> replay_path))) {
+            fprintf(stderr, "Cannot read the trace \"%s\"\n", s -> replay_path);
+            free(s);
+            return -1;
+        }
+        if (s -> replay -> procs > MAXPROCESSES) {
+            fprintf(stderr, "The trace \"%s\" has more than %d processes\n", s -> replay_path,
+                    MAXPROCESSES);
+            close_traces(s);
+            return -1;
+        }
+        s -> nprocs = s -> replay -> procs;
+        if (!options -> ticks) {
+            s -> ticks = ULONG_MAX;
+        }
+    }
+    if (s -> record_path && !(s -> record = trace_create(s -> record_path, s -> nprocs))) {
+        fprintf(stderr, "Cannot write the trace \"%s\"\n", s -> record_path);
+        close_traces(s);
+        return -1;
+    }
+
+    sim = s;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    simulate();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sim = NULL;
+
+    results -> nprocs = s -> nprocs;
+    results -> ticks = s -> tick;
+    results -> references = s -> references;
+    results -> faults = s -> faults;
+    results -> pageins = s -> pageins;
+    results -> pageouts = s -> pageouts;
+    results -> blocked = s -> blocked;
+    results -> started = s -> started;
+    results -> busy = s -> busy;
+    results -> pageit_cycles = s -> pageit_cycles;
+    results -> seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    close_traces(s);
+    return 0;
+}
+
+/* Close the traces of a simulation, and free it */
+static void close_traces(struct simulator* s) {
+
+    int proc;
+
+    trace_close(s -> replay);
+    if (trace_close(s -> record)) {
+        fprintf(stderr, "Cannot write the trace \"%s\"\n", s -> record_path);
+        exit(1);
+    }
+    for (proc = 0; proc < MAXPROCESSES; proc++) {
+        free(s -> queues[proc].spans);
+    }
+    free(s);
+}
+
+/* Run the simulation for '-t' ticks, or to the end of the trace */
+static void simulate(void) {
+
+    unsigned long long start;
+    int proc;
+
+    sim -> rng = sim -> seed * 0x9E3779B97F4A7C15ULL + 1;
+    sim -> free_frames = sim -> frames;
+    sim -> running = sim -> nprocs;
+    for (proc = 0; proc < sim -> nprocs; proc++) {
+        start_process(proc);
+    }
+    for (sim -> tick = 0; sim -> tick < sim -> ticks && sim -> running; sim -> tick++) {
+        complete_swaps();
+        start = cycles();
+        sim -> pageit(sim -> q);
+        sim -> pageit_cycles += cycles() - start;
+        for (proc = 0; proc < sim -> nprocs; proc++) {
+            run_process(proc);
+        }
+    }
+}
+
+/*
+ *  Start a program in a slot, with none of its pages in memory. In
+ *  a replay the slot stops at the end of its trace; the pages of a
+ *  replayed program are not known, so it may use them all.
+ */
+static void start_process(int proc) {
+
+    struct process* p = &sim -> procs[proc];
+    Pentry* q = &sim -> q[proc];
+
+    p -> block = 0;
+    p -> blocked_on = -1;
+    p -> gen++;
+    if (sim -> replay) {
+        q -> active = next_reference(proc, &q -> pc, &p -> exits);
+        q -> npages = MAXPROCPAGES;
+        sim -> running -= !q -> active;
+    }
+    else {
+        p -> prog = sim -> workload ? sim -> workload : &programs[next_random() % NPROGRAMS];
+        q -> active = 1;
+        q -> pc = p -> prog -> blocks[0].start;
+        q -> npages = p -> prog -> npages;
+    }
+    memset(q -> pages, 0, sizeof(q -> pages));
+    memset(sim -> state[proc], OUT, sizeof(sim -> state[proc]));
+    sim -> started++;
+}
+
+/* The program of a slot exits: free the frames of its pages */
+static void exit_process(int proc) {
+
+    int page;
+
+    for (page = 0; page < MAXPROCPAGES; page++) {
+        if (sim -> state[proc][page] == IN) {
+            sim -> free_frames++;
+        }
+    }
+    start_process(proc);   // Swaps in flight free their frames when they complete
+}
+
+/* Run a process for one tick, or count it blocked */
+static void run_process(int proc) {
+
+    struct process* p = &sim -> procs[proc];
+    Pentry* q = &sim -> q[proc];
+    const struct block* b;
+    long page = q -> pc / PAGESIZE;
+    uint64_t roll;
+    int i;
+
+    if (!q -> active) {
+        return;     // Replay: at the end of its trace
+    }
+    if (sim -> state[proc][page] != IN) {
+        if (p -> blocked_on != page) {
+            sim -> faults++;
+            p -> blocked_on = page;
+        }
+        sim -> blocked++;
+        return;
+    }
+    p -> blocked_on = -1;
+    sim -> references++;   // One compute tick
+
+    /* Replay: the next program counter of the trace */
+    if (sim -> replay) {
+        record(proc, q -> pc, p -> exits);
+        if (p -> exits || !next_reference(proc, &q -> pc, &p -> exits)) {
+            exit_process(proc);
+        }
+        return;
+    }
+
+    /* Next program counter: the next in the block, or a successor block */
+    b = &p -> prog -> blocks[p -> block];
+    if (q -> pc < b -> end) {
+        record(proc, q -> pc, 0);
+        q -> pc++;
+        return;
+    }
+    roll = next_random() % 100;
+    for (i = 0; i < MAXNEXT - 1 && roll >= (uint64_t)b -> weight[i]; i++) {
+        roll -= b -> weight[i];
+    }
+    record(proc, q -> pc, b -> next[i] == EXIT);
+    if (b -> next[i] == EXIT) {
+        exit_process(proc);
+        return;
+    }
+    p -> block = b -> next[i];
+    q -> pc = p -> prog -> blocks[p -> block].start;
+}
+
+/*
+ *  Replay: the next program counter of a slot, from its queue or read
+ *  from the trace. Returns 0 at the end of its trace.
+ */
+static int next_reference(int proc, long* pc, int* exits) {
+
+    struct replay_queue* queue = &sim -> queues[proc];
+    struct replay_queue* other;
+    struct replay_span* span;
+    struct trace_record r;
+    int status;
+
+    while (queue -> count == 0) {
+        if ((status = trace_read(sim -> replay, &r)) != 1) {
+            if (status == -1) {
+                fprintf(stderr, "The trace \"%s\" is truncated\n", sim -> replay_path);
+            }
+            return 0;
+        }
+        if (r.pc < 0 || r.pc >= MAXPC) {
+            fprintf(stderr, "The trace \"%s\" has a pc out of range: %ld\n",
+                    sim -> replay_path, r.pc);
+            exit(1);
+        }
+
+        /* The next pc of the last span makes it longer */
+        other = &sim -> queues[r.proc];
+        span = other -> count ? &other -> spans[other -> head + other -> count - 1] : NULL;
+        if (span && !span -> exits && span -> pc + span -> count == r.pc) {
+            span -> count++;
+            span -> exits = r.exited;
+            continue;
+        }
+        if (other -> head + other -> count == other -> size) {
+            if (other -> head > other -> size / 2) {
+                memmove(other -> spans, other -> spans + other -> head,
+                        other -> count * sizeof(struct replay_span));
+                other -> head = 0;
+            }
+            else {
+                other -> size = other -> size ? 2 * other -> size : 1024;
+                if (!(other -> spans = realloc(other -> spans,
+                                               other -> size * sizeof(struct replay_span)))) {
+                    fprintf(stderr, "Out of memory replaying \"%s\"\n", sim -> replay_path);
+                    exit(1);
+                }
+            }
+        }
+        span = &other -> spans[other -> head + other -> count++];
+        span -> pc = r.pc;
+        span -> count = 1;
+        span -> exits = r.exited;
+    }
+    span = &queue -> spans[queue -> head];
+    *pc = span -> pc++;
+    *exits = --span -> count == 0 && span -> exits;
+    if (span -> count == 0) {
+        queue -> head++;
+        if (--queue -> count == 0) {
+            queue -> head = 0;
+        }
+    }
+    return 1;
+}
+
+/* Append a reference to the '-o' trace */
+static void record(int proc, long pc, int exited) {
+
+    struct trace_record r;
+
+    if (!sim -> record) {
+        return;
+    }
+    r.tick = sim -> tick;
+    r.proc = proc;
+    r.pc = pc;
+    r.exited = exited;
+    if (trace_write(sim -> record, &r)) {
+        fprintf(stderr, "Cannot write the trace \"%s\"\n", sim -> record_path);
+        exit(1);
+    }
+}
+
+/* Complete the swaps started PAGEWAIT ticks ago */
+static void complete_swaps(void) {
+
+    struct swap* s;
+
+    while (sim -> swap_count > 0 && sim -> swaps[sim -> swap_head].done <= sim -> tick) {
+        s = &sim -> swaps[sim -> swap_head];
+        sim -> swap_head = (sim -> swap_head + 1) % MAXFRAMES;
+        sim -> swap_count--;
+        if (s -> gen != sim -> procs[s -> proc].gen) {
+            sim -> free_frames++;   // Its process exited
+        }
+        else if (s -> in) {
+            sim -> state[s -> proc][s -> page] = IN;
+            sim -> q[s -> proc].pages[s -> page] = 1;
+        }
+        else {
+            sim -> state[s -> proc][s -> page] = OUT;
+            sim -> free_frames++;
+        }
+    }
+}
+
+/* Queue a swap that completes in PAGEWAIT ticks */
+static void start_swap(int proc, int page, int in) {
+
+    struct swap* s = &sim -> swaps[(sim -> swap_head + sim -> swap_count) % MAXFRAMES];
+
+    s -> done = sim -> tick + PAGEWAIT;
+    s -> proc = proc;
+    s -> page = page;
+    s -> in = in;
+    s -> gen = sim -> procs[proc].gen;
+    sim -> swap_count++;
+}
+
+/* Start swapping a page in: see simulator.h */
+int pagein(int proc, int page) {
+
+    unsigned char* state;
+
+    if (proc < 0 || proc >= sim -> nprocs || page < 0 || page >= MAXPROCPAGES) {
+        return 0;
+    }
+    state = &sim -> state[proc][page];
+    if (*state == IN || *state == COMING_IN) {
+        return 1;
+    }
+    if (*state == GOING_OUT || sim -> free_frames == 0) {
+        return 0;
+    }
+    if (swap_busy()) {
+        return 0;
+    }
+    sim -> free_frames--;
+    *state = COMING_IN;
+    start_swap(proc, page, 1);
+    sim -> pageins++;
+    return 1;
+}
+
+/* Start swapping a page out: see simulator.h */
+int pageout(int proc, int page) {
+
+    unsigned char* state;
+
+    if (proc < 0 || proc >= sim -> nprocs || page < 0 || page >= MAXPROCPAGES) {
+        return 0;
+    }
+    state = &sim -> state[proc][page];
+    if (*state == OUT || *state == GOING_OUT) {
+        return 1;
+    }
+    if (*state == COMING_IN || swap_busy()) {
+        return 0;
+    }
+    *state = GOING_OUT;
+    sim -> q[proc].pages[page] = 0;
+    start_swap(proc, page, 0);
+    sim -> pageouts++;
+    return 1;
+}
+
+/* The frames of physical memory: see simulator.h */
+int physical_frames(void) {
+    return sim -> frames;
+}
+
+/* The trace being replayed: see simulator.h */
+const char* replay_trace(void) {
+    return sim -> replay_path;
+}
+
+/* The value of a pager parameter: see simulator.h */
+double pager_param(const char* name, double value) {
+
+    int i;
+
+    for (i = 0; i < sim -> nparams; i++) {
+        if (!strcmp(sim -> params[i].name, name)) {
+            return sim -> params[i].value;
+        }
+    }
+    return value;
+}
+
+/* All the swaps '-b' allows are in flight: see simulator.h */
+int swap_busy(void) {
+    if (sim -> swap_limit && sim -> swap_count >= sim -> swap_limit) {
+        sim -> busy++;
+        return 1;
+    }
+    return 0;
+}
+
+/* xorshift64*: the simulation's only source of randomness */
+static uint64_t next_random(void) {
+    sim -> rng ^= sim -> rng >> 12;
+    sim -> rng ^= sim -> rng << 25;
+    sim -> rng ^= sim -> rng >> 27;
+    return (sim -> rng * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+#ifndef SWEEP
+static void print_results(const struct sim_options* options, const struct sim_results* results) {
+
+    struct rusage usage;
+    const struct sim_results* r = results;
+    int i;
+
+    getrusage(RUSAGE_SELF, &usage);
+    if (options -> replay_path) {
+        printf("Trace %s, %d processes, %d frames, %lu ticks\n", options -> replay_path,
+               r -> nprocs, options -> frames, r -> ticks);
+    }
+    else {
+        printf("Seed %lu, workload %s, %d processes, %d frames, %lu ticks\n",
+               options -> seed, options -> workload ? options -> workload : "mixed",
+               r -> nprocs, options -> frames, r -> ticks);
+    }
+    if (options -> swap_limit) {
+        printf("    swap limit:       %d in flight\n", options -> swap_limit);
+    }
+    for (i = 0; i < options -> nparams; i++) {
+        printf("    pager parameter:  %s = %g\n", options -> params[i].name,
+               options -> params[i].value);
+    }
+    printf("    programs run:     %lu\n", r -> started);
+    printf("    references:       %lu (compute ticks)\n", r -> references);
+    printf("    page faults:      %lu (%.3f per 1000 references)\n", r -> faults,
+           r -> references ? 1000.0 * r -> faults / r -> references : 0);
+    printf("    pageins:          %lu\n", r -> pageins);
+    printf("    pageouts:         %lu\n", r -> pageouts);
+    printf("    swap operations:  %lu", r -> pageins + r -> pageouts);
+    if (options -> swap_limit) {
+        printf(" (%lu refused, device busy)", r -> busy);
+    }
+    printf("\n");
+    printf("    blocked ticks:    %lu\n", r -> blocked);
+    printf("    score:            %.4f (blocked / compute ticks)\n",
+           r -> references ? (double)r -> blocked / r -> references : 0);
+    printf("    time:             %.3f s (%.2f M ticks/s, %.2f M references/s)\n", r -> seconds,
+           r -> seconds > 0 ? r -> ticks / r -> seconds / 1e6 : 0,
+           r -> seconds > 0 ? r -> references / r -> seconds / 1e6 : 0);
+    printf("    pageit():         %.1f cycles per call\n", (double)r -> pageit_cycles / (r -> ticks ? r -> ticks : 1));
+    printf("    memory:           %ld KB (maximum resident set)\n", usage.ru_maxrss);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-s seed] [-w workload] [-t ticks] [-p processes] [-f frames]\n"
+            "       [-b swaps] [-o trace] [-r trace] [-P name=value]\n"
+            "    -s  seed of the random program choices (default: %d)\n"
+            "    -w  mixed, loop, nested, calls, linear or jumps (default: mixed)\n"
+            "    -t  ticks to simulate (default: %d)\n"
+            "    -p  processes running at once, 1 to %d (default: %d)\n"
+            "    -f  frames of physical memory, 1 to %d (default: %d)\n"
+            "    -b  swaps in flight at most (default: 0, no limit)\n"
+            "    -o  record the references to a trace\n"
+            "    -r  replay a trace instead of the programs (-s, -w and -p are ignored;\n"
+            "        it runs to its end unless -t is given)\n"
+            "    -P  set a parameter of the pager, up to %d times (see pager_param())\n",
+            name, DEFAULT_SEED, DEFAULT_TICKS, MAXPROCESSES, MAXPROCESSES, MAXFRAMES,
+            PHYSICALPAGES, MAXPARAMS);
+    exit(1);
+}
+#endif
@@ -0,0 +1,86 @@
+/*
+ * File: simulator.h
+ *
+ * Description:
+ *     Interface between the paging simulator (simulator.c) and a
+ *     pager (pager-lru.c, pager-predict.c). The simulator runs
+ *     MAXPROCESSES processes that share PHYSICALPAGES frames and
+ *     calls pageit() once per tick; the pager answers with
+ *     pagein() and pageout() requests, which each take PAGEWAIT
+ *     ticks to complete.
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <sys/types.h>
+
+/*
+ *  State a pager (or the simulator) keeps from one call to the next
+ *  is declared INSTANCE. Built for the sweep (-DSWEEP) it is local to
+ *  the thread: sweep.c runs every simulation in a thread of its own,
+ *  so each gets its own copy, initialized as in a new process. The
+ *  test programs run one simulation, and keep it plain static.
+ */
+#ifdef SWEEP
+#define INSTANCE        __thread
+#else
+#define INSTANCE
+#endif
+
+#define MAXPROCESSES    20      // Processes running at once
+#define MAXPROCPAGES    20      // Pages in the address space of a process
+#define PAGESIZE        128     // Program counter values per page
+#define MAXPC           (MAXPROCPAGES * PAGESIZE)
+#define PHYSICALPAGES   100     // Frames shared by all processes
+#define PAGEWAIT        100     // Ticks a pagein or a pageout takes
+
+/*
+ *  Page table entry of one process, as seen by the pager
+ *
+ *   active: the process is running (or blocked on a page)
+ *   pc:     its program counter; the page it needs is pc / PAGESIZE
+ *   npages: pages its program uses, numbered from 0
+ *   pages:  1 for each page that is in memory (not on its way in or out)
+ */
+typedef struct {
+    long active;
+    long pc;
+    long npages;
+    long pages[MAXPROCPAGES];
+} Pentry;
+
+/* Implemented by the pager: called once per tick */
+void pageit(Pentry q[MAXPROCESSES]);
+
+/*
+ *  Implemented by the simulator
+ *
+ *   pagein:  start swapping a page in. Returns 1 if it is on its way
+ *            in or already in, 0 if it is on its way out, no frame
+ *            is free or the swap device is busy.
+ *   pageout: start swapping a page out; its frame is free once that
+ *            completes. Returns 1 if it is on its way out or already
+ *            out, 0 if it is on its way in or the swap device is busy.
+ *   swap_busy: 1 if the swap device is busy ('-b'), so pagein() and
+ *            pageout() would fail. Counted as a refused swap, like
+ *            the call it saves.
+ */
+int pagein(int proc, int page);
+int pageout(int proc, int page);
+int swap_busy(void);
+
+/*
+ *  Also implemented by the simulator
+ *
+ *   physical_frames: the frames of physical memory ('-f'),
+ *                    PHYSICALPAGES unless given.
+ *   replay_trace: the trace being replayed ('-r'), or NULL.
+ *   pager_param:  the value given to the pager parameter 'name' with
+ *                 '-P name=value', or 'value' if none was.
+ */
+int physical_frames(void);
+const char* replay_trace(void);
+double pager_param(const char* name, double value);
+
+#endif
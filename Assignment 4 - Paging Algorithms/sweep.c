@@ -0,0 +1,440 @@
+/*
+ * File: sweep.c
+ *
+ * Description:
+ *     Runs many simulations at once and prints their results as CSV:
+ *     every combination of the pagers given, the workloads (or the
+ *     traces), the frame counts, the values of the pager parameters
+ *     and the seeds. Every pager is linked in, its pageit() renamed
+ *     after it (see the Makefile), and simulate_run() runs each
+ *     simulation.
+ *
+ *     '-j' threads take the simulations in turn. Each simulation
+ *     runs in a new thread of its own: the state of the simulator
+ *     and of the pagers is INSTANCE (thread-local), so a simulation
+ *     starts from a fresh copy of it, as a test program does, and
+ *     shares none with the others. The results are printed in the
+ *     order of the combinations, whatever order they finish in, so
+ *     a sweep prints the same CSV with any number of threads.
+ *
+ *     With '-a' the seeds of each combination are averaged into one
+ *     row, with the lowest and highest score.
+ *
+ * Usage:
+ *     ./sweep [-j threads] [-a] [-s seeds] [-w workloads | -r traces] [-f frames]
+ *             [-t ticks] [-p processes] [-b swaps] [-P name=values]... pager...
+ *
+ *     Lists are separated by commas; seeds and frames also take
+ *     ranges: "./sweep -a -s 1-10 -f 60,100 -P threshold=0.1,0.2 predict"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "simulation.h"
+
+#define MAXLIST     1024    // Values in one list
+
+void pageit_lru(Pentry q[MAXPROCESSES]);
+void pageit_lru_clock(Pentry q[MAXPROCESSES]);
+void pageit_lru_scan(Pentry q[MAXPROCESSES]);
+void pageit_predict(Pentry q[MAXPROCESSES]);
+void pageit_predict_static(Pentry q[MAXPROCESSES]);
+void pageit_arc(Pentry q[MAXPROCESSES]);
+void pageit_2q(Pentry q[MAXPROCESSES]);
+void pageit_lirs(Pentry q[MAXPROCESSES]);
+void pageit_wsclock(Pentry q[MAXPROCESSES]);
+void pageit_opt(Pentry q[MAXPROCESSES]);
+
+#define MAXPAGERPARAMS 2    // Parameters one pager reads with pager_param()
+
+/* The pagers, by the names of their test programs, and the parameters they read */
+struct pager {
+    const char* name;
+    void (*pageit)(Pentry q[MAXPROCESSES]);
+    const char* params[MAXPAGERPARAMS];
+};
+
+static const struct pager pagers[] = {
+    { "lru", pageit_lru, { NULL } },
+    { "lru-clock", pageit_lru_clock, { NULL } },
+    { "lru-scan", pageit_lru_scan, { NULL } },
+    { "predict", pageit_predict, { "threshold" } },
+    { "predict-static", pageit_predict_static, { "one_step", "two_step" } },
+    { "arc", pageit_arc, { NULL } },
+    { "2q", pageit_2q, { NULL } },
+    { "lirs", pageit_lirs, { NULL } },
+    { "wsclock", pageit_wsclock, { NULL } },
+    { "opt", pageit_opt, { NULL } },
+};
+
+#define NPAGERS (int)(sizeof(pagers) / sizeof(pagers[0]))
+
+/* A pager parameter and the values it takes */
+struct param_values {
+    const char* name;
+    double values[MAXLIST];
+    int count;
+};
+
+/* One simulation of the sweep */
+struct job {
+    struct sim_options options;
+    const struct pager* pager;
+    const char* input;              // Workload or trace
+    struct sim_results results;
+    int status;
+};
+
+static struct job* jobs;
+static int njobs, next_job;
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* worker(void* unused);
+static void* run_job(void* job);
+static void print_header(const char* input, const struct param_values params[], int nparams,
+                         int average);
+static void print_row(const struct job* first, int runs, int average);
+static int parse_numbers(char* list, unsigned long values[]);
+static int parse_doubles(char* list, double values[]);
+static int parse_names(char* list, const char* names[]);
+static const struct pager* find_pager(const char* name);
+static int takes_param(const struct pager* pager, const char* name);
+static void usage(const char* name);
+
+int main(int argc, char* argv[]) {
+
+    struct sim_options base;
+    struct param_values params[MAXPARAMS];
+    struct timespec start, end;
+    pthread_t* threads;
+    const char* inputs[MAXLIST];
+    const char* workloads = "mixed";
+    unsigned long seeds[MAXLIST], frames[MAXLIST], value;
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN), average = 0, replay = 0;
+    int ninputs, nseeds = 1, nframes = 1, nparams = 0, ncombos = 1;
+    int opt, p, in, f, c, k, sd, i, failed = 0;
+    char* equals;
+
+    sim_defaults(&base);
+    seeds[0] = base.seed;
+    frames[0] = base.frames;
+    while ((opt = getopt(argc, argv, "j:as:w:r:f:t:p:b:P:h")) != -1) {
+        switch (opt) {
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            case 'a':
+                average = 1;
+                break;
+            case 's':
+                nseeds = parse_numbers(optarg, seeds);
+                break;
+            case 'w':
+                workloads = optarg;
+                break;
+            case 'r':
+                workloads = optarg;
+                replay = 1;
+                break;
+            case 'f':
+                nframes = parse_numbers(optarg, frames);
+                break;
+            case 't':
+                base.ticks = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                base.nprocs = atoi(optarg);
+                break;
+            case 'b':
+                base.swap_limit = atoi(optarg);
+                break;
+            case 'P':
+                if (!(equals = strchr(optarg, '=')) || nparams == MAXPARAMS) {
+                    usage(argv[0]);
+                }
+                *equals = '\0';
+                params[nparams].name = optarg;
+                params[nparams].count = parse_doubles(equals + 1, params[nparams].values);
+                ncombos *= params[nparams++].count;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    ninputs = parse_names(strdup(workloads), inputs);
+    if (optind == argc || nthreads < 1 || nseeds < 1 || nframes < 1 || ninputs < 1 ||
+        ncombos < 1) {
+        usage(argv[0]);
+    }
+    for (p = optind; p < argc; p++) {
+        if (!find_pager(argv[p])) {
+            fprintf(stderr, "Unknown pager \"%s\"\n", argv[p]);
+            usage(argv[0]);
+        }
+        if (!replay && find_pager(argv[p]) -> pageit == pageit_opt) {
+            fprintf(stderr, "The opt pager only replays traces (-r)\n");
+            usage(argv[0]);
+        }
+        for (k = 0; k < nparams; k++) {
+            if (!takes_param(find_pager(argv[p]), params[k].name)) {
+                fprintf(stderr, "The %s pager has no parameter \"%s\"\n", argv[p],
+                        params[k].name);
+                usage(argv[0]);
+            }
+        }
+    }
+
+    /* Every combination, the seeds of each in a row */
+    njobs = (argc - optind) * ninputs * nframes * ncombos * nseeds;
+    if (!(jobs = calloc(njobs, sizeof(struct job)))) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    i = 0;
+    for (p = optind; p < argc; p++) {
+        for (in = 0; in < ninputs; in++) {
+            for (f = 0; f < nframes; f++) {
+                for (c = 0; c < ncombos; c++) {
+                    for (sd = 0; sd < nseeds; sd++) {
+                        jobs[i].pager = find_pager(argv[p]);
+                        jobs[i].input = inputs[in];
+                        jobs[i].options = base;
+                        jobs[i].options.pageit = jobs[i].pager -> pageit;
+                        jobs[i].options.workload = replay ? NULL : inputs[in];
+                        jobs[i].options.replay_path = replay ? inputs[in] : NULL;
+                        jobs[i].options.frames = frames[f];
+                        jobs[i].options.seed = seeds[sd];
+                        for (k = 0, value = c; k < nparams; k++) {
+                            jobs[i].options.params[k].name = params[k].name;
+                            jobs[i].options.params[k].value = params[k].values[value % params[k].count];
+                            value /= params[k].count;
+                        }
+                        jobs[i++].options.nparams = nparams;
+                    }
+                }
+            }
+        }
+    }
+
+    if (nthreads > njobs) {
+        nthreads = njobs;
+    }
+    if (!(threads = calloc(nthreads, sizeof(pthread_t)))) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL)) {
+            fprintf(stderr, "Cannot start a thread\n");
+            return 1;
+        }
+    }
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    print_header(replay ? "trace" : "workload", params, nparams, average);
+    for (i = 0; i < njobs; i += average ? nseeds : 1) {
+        print_row(&jobs[i], average ? nseeds : 1, average);
+    }
+    for (i = 0; i < njobs; i++) {
+        failed += jobs[i].status != 0;
+    }
+    fprintf(stderr, "%d simulations (%d failed), %d threads, %.2f s\n", njobs, failed, nthreads,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    return failed ? 1 : 0;
+}
+
+/* Take the next simulation until none is left, each in a new thread */
+static void* worker(void* unused) {
+
+    pthread_t thread;
+    int i;
+    (void)unused;
+
+    for (;;) {
+        pthread_mutex_lock(&next_lock);
+        i = next_job++;
+        pthread_mutex_unlock(&next_lock);
+        if (i >= njobs) {
+            return NULL;
+        }
+        if (pthread_create(&thread, NULL, run_job, &jobs[i])) {
+            jobs[i].status = -1;
+            fprintf(stderr, "Cannot start a thread\n");
+            continue;
+        }
+        pthread_join(thread, NULL);
+    }
+}
+
+static void* run_job(void* job) {
+    struct job* j = job;
+
+    j -> status = simulate_run(&j -> options, &j -> results);
+    return NULL;
+}
+
+static void print_header(const char* input, const struct param_values params[], int nparams,
+                         int average) {
+    int k;
+
+    printf("pager,%s,frames", input);
+    for (k = 0; k < nparams; k++) {
+        printf(",%s", params[k].name);
+    }
+    if (average) {
+        printf(",runs,ticks,references,faults,pageins,pageouts,blocked,score,score_min,"
+               "score_max,seconds\n");
+    }
+    else {
+        printf(",seed,ticks,references,faults,pageins,pageouts,blocked,score,seconds\n");
+    }
+}
+
+/* One simulation, or the average of 'runs' of them (the seeds of a combination) */
+static void print_row(const struct job* first, int runs, int average) {
+
+    const struct sim_results* r;
+    double ticks = 0, references = 0, faults = 0, pageins = 0, pageouts = 0, blocked = 0;
+    double score, score_sum = 0, score_min = 0, score_max = 0, seconds = 0;
+    int i, k;
+
+    for (i = 0; i < runs; i++) {
+        if (first[i].status) {
+            return;     // Its error is printed already
+        }
+        r = &first[i].results;
+        score = r -> references ? (double)r -> blocked / r -> references : 0;
+        ticks += r -> ticks;
+        references += r -> references;
+        faults += r -> faults;
+        pageins += r -> pageins;
+        pageouts += r -> pageouts;
+        blocked += r -> blocked;
+        seconds += r -> seconds;
+        score_sum += score;
+        score_min = i == 0 || score < score_min ? score : score_min;
+        score_max = i == 0 || score > score_max ? score : score_max;
+    }
+    printf("%s,%s,%d", first -> pager -> name, first -> input, first -> options.frames);
+    for (k = 0; k < first -> options.nparams; k++) {
+        printf(",%g", first -> options.params[k].value);
+    }
+    if (average) {
+        printf(",%d,%.0f,%.0f,%.1f,%.1f,%.1f,%.1f,%.4f,%.4f,%.4f,%.3f\n", runs, ticks / runs,
+               references / runs, faults / runs, pageins / runs, pageouts / runs,
+               blocked / runs, score_sum / runs, score_min, score_max, seconds / runs);
+    }
+    else {
+        printf(",%lu,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.4f,%.3f\n", first -> options.seed, ticks,
+               references, faults, pageins, pageouts, blocked, score_sum, seconds);
+    }
+}
+
+/* "1,4,7" or "1-10", or both: returns the count of numbers, 0 if the list is wrong */
+static int parse_numbers(char* list, unsigned long values[]) {
+
+    unsigned long low, high;
+    char* item;
+    char* end;
+    int n = 0;
+
+    for (item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+        low = high = strtoul(item, &end, 10);
+        if (*end == '-') {
+            high = strtoul(end + 1, &end, 10);
+        }
+        if (*end || end == item || high < low) {
+            return 0;
+        }
+        for (; low <= high; low++) {
+            if (n == MAXLIST) {
+                return 0;
+            }
+            values[n++] = low;
+        }
+    }
+    return n;
+}
+
+static int parse_doubles(char* list, double values[]) {
+
+    char* item;
+    char* end;
+    int n = 0;
+
+    for (item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+        if (n == MAXLIST) {
+            return 0;
+        }
+        values[n++] = strtod(item, &end);
+        if (*end || end == item) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+static int parse_names(char* list, const char* names[]) {
+
+    char* item;
+    int n = 0;
+
+    for (item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+        if (n == MAXLIST) {
+            return 0;
+        }
+        names[n++] = item;
+    }
+    return n;
+}
+
+static const struct pager* find_pager(const char* name) {
+    int i;
+
+    for (i = 0; i < NPAGERS; i++) {
+        if (!strcmp(pagers[i].name, name)) {
+            return &pagers[i];
+        }
+    }
+    return NULL;
+}
+
+/* The pager reads the parameter 'name' with pager_param() */
+static int takes_param(const struct pager* pager, const char* name) {
+    int i;
+
+    for (i = 0; i < MAXPAGERPARAMS && pager -> params[i]; i++) {
+        if (!strcmp(pager -> params[i], name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-j threads] [-a] [-s seeds] [-w workloads | -r traces] [-f frames]\n"
+            "       [-t ticks] [-p processes] [-b swaps] [-P name=values]... pager...\n"
+            "    -j  simulations run at once (default: the number of CPUs)\n"
+            "    -a  average the seeds of each combination into one row\n"
+            "    -s  seeds, e.g. 1-10 (default: 1)\n"
+            "    -w  workloads: mixed, loop, nested, calls, linear, jumps (default: mixed)\n"
+            "    -r  traces to replay instead of workloads\n"
+            "    -f  frames, e.g. 40,60,100 (default: %d)\n"
+            "    -t, -p, -b  as for the test programs, for every simulation\n"
+            "    -P  values of a pager parameter, e.g. threshold=0.1,0.2 (up to %d):\n"
+            "        threshold of predict, one_step and two_step of predict-static\n"
+            "    pagers: lru, lru-clock, lru-scan, predict, predict-static, arc, 2q, lirs,\n"
+            "            wsclock, opt\n"
+            "Lists are separated by commas. Prints one CSV row per simulation.\n",
+            name, PHYSICALPAGES, MAXPARAMS);
+    exit(1);
+}
@@ -0,0 +1,141 @@
+/*
+ * File: trace-matrix.c
+ *
+ * Description:
+ *     Builds the probability transition matrices of pager-predict.h
+ *     from a reference trace (trace.h), instead of by hand. Every
+ *     time a process moves to another page, the move is counted in
+ *     the row of the page it left (one step) and in the row of the
+ *     page before that (two steps); a program's moves end when it
+ *     exits. Each row is then divided by its total and printed in
+ *     the layout of pager-predict.h, so the output can replace it:
+ *
+ *         ./test-lru -t 5000000 -o pa4.trace
+ *         ./trace-matrix pa4.trace > pager-predict.h
+ *
+ * Usage:
+ *     ./trace-matrix [-n pages] trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "simulator.h"
+#include "trace.h"
+
+#define DEFAULT_PAGES   15      // The size of the matrices of pager-predict.h
+
+static unsigned long one[MAXPROCPAGES][MAXPROCPAGES];
+static unsigned long two[MAXPROCPAGES][MAXPROCPAGES];
+
+static void print_matrix(const char* name, const char* steps, unsigned long counts[][MAXPROCPAGES],
+                         int pages);
+static void usage(const char* name);
+
+int main(int argc, char* argv[]) {
+
+    struct trace* t;
+    struct trace_record r;
+    int last[TRACE_PROCS], before_last[TRACE_PROCS];
+    int opt, pages = DEFAULT_PAGES, page, status, i;
+    unsigned long references = 0, moves = 0;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                pages = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || pages < 1 || pages > MAXPROCPAGES) {
+        usage(argv[0]);
+    }
+    if (!(t = trace_open(argv[optind]))) {
+        fprintf(stderr, "Cannot read the trace \"%s\"\n", argv[optind]);
+        return 1;
+    }
+    for (i = 0; i < TRACE_PROCS; i++) {
+        last[i] = before_last[i] = -1;
+    }
+
+    while ((status = trace_read(t, &r)) == 1) {
+        references++;
+        page = r.pc / PAGESIZE;
+        if (page < 0 || page >= MAXPROCPAGES) {
+            fprintf(stderr, "The trace \"%s\" has a pc out of range: %ld\n", argv[optind], r.pc);
+            return 1;
+        }
+        if (page != last[r.proc]) {
+            if (last[r.proc] != -1) {
+                one[last[r.proc]][page]++;
+                moves++;
+            }
+            if (before_last[r.proc] != -1) {
+                two[before_last[r.proc]][page]++;
+            }
+            before_last[r.proc] = last[r.proc];
+            last[r.proc] = page;
+        }
+        if (r.exited) {
+            last[r.proc] = before_last[r.proc] = -1;
+        }
+    }
+    if (status == -1) {
+        fprintf(stderr, "The trace \"%s\" is truncated\n", argv[optind]);
+        return 1;
+    }
+    trace_close(t);
+
+    printf("/*\n *  Built by trace-matrix from %s: %lu references, %lu moves between pages\n */\n\n",
+           argv[optind], references, moves);
+    print_matrix("markov_one_step", "ONE STEP", one, pages);
+    printf("\n");
+    print_matrix("markov_two_step", "TWO STEPS", two, pages);
+    return 0;
+}
+
+/* Print one matrix as pager-predict.h declares it: rows of probabilities */
+static void print_matrix(const char* name, const char* steps, unsigned long counts[][MAXPROCPAGES],
+                         int pages) {
+
+    unsigned long total;
+    int row, column;
+
+    printf("/*\n"
+           " *   Description:\n"
+           " *      This probability transition matrix represents a directed graph:\n"
+           " *         - Vertices: pages accessed by processes in simulator.c\n"
+           " *         - Edges: the probability that a future page (columns) will be "
+           "referenced from a current page (row)\n"
+           " *   Use:\n"
+           " *      Index this matrix to find what pages are likely to be referenced %s "
+           "from the current page.\n"
+           " */\n", steps);
+    printf("double %s[%d][%d] = {\n/* Page: ", name, pages, pages);
+    for (column = 0; column < pages; column++) {
+        printf(" %-6d", column);
+    }
+    printf("*/\n");
+    for (row = 0; row < pages; row++) {
+        total = 0;
+        for (column = 0; column < MAXPROCPAGES; column++) {
+            total += counts[row][column];
+        }
+        printf("/* %2d */ { ", row);
+        for (column = 0; column < pages; column++) {
+            printf("%.3f%s", total ? (double)counts[row][column] / total : 0.0,
+                   column < pages - 1 ? ", " : " }");
+        }
+        printf("%s\n", row < pages - 1 ? "," : "};");
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n pages] trace\n"
+            "    -n  pages in the matrices, 1 to %d (default: %d)\n",
+            name, MAXPROCPAGES, DEFAULT_PAGES);
+    exit(1);
+}
@@ -0,0 +1,175 @@
+/*
+ * File: trace.c
+ *
+ * Description:
+ *     Writing and reading reference traces: see trace.h for the
+ *     format. Both directions go through a 64 KB buffer, so a
+ *     record costs a few byte operations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "trace.h"
+
+static int flush(struct trace* t);
+static void put_varint(struct trace* t, unsigned long value);
+static int get_varint(struct trace* t, unsigned long* value);
+static int get_byte(struct trace* t);
+static void put_u32(unsigned char* p, u_int32_t value);
+static u_int32_t get_u32(const unsigned char* p);
+
+struct trace* trace_create(const char* path, int procs) {
+    struct trace* t;
+    unsigned char header[16];
+
+    if (procs < 1 || procs > TRACE_PROCS || !(t = calloc(1, sizeof(*t)))) {
+        return NULL;
+    }
+    if (!(t -> file = fopen(path, "wb"))) {
+        free(t);
+        return NULL;
+    }
+    memcpy(header, TRACE_MAGIC, 8);
+    put_u32(header + 8, TRACE_VERSION);
+    put_u32(header + 12, procs);
+    if (fwrite(header, sizeof(header), 1, t -> file) != 1) {
+        fclose(t -> file);
+        free(t);
+        return NULL;
+    }
+    t -> writing = 1;
+    t -> procs = procs;
+    return t;
+}
+
+struct trace* trace_open(const char* path) {
+    struct trace* t;
+    unsigned char header[16];
+
+    if (!(t = calloc(1, sizeof(*t)))) {
+        return NULL;
+    }
+    if (!(t -> file = fopen(path, "rb"))) {
+        free(t);
+        return NULL;
+    }
+    if (fread(header, sizeof(header), 1, t -> file) != 1 || memcmp(header, TRACE_MAGIC, 8) ||
+        get_u32(header + 8) != TRACE_VERSION ||
+        get_u32(header + 12) < 1 || get_u32(header + 12) > TRACE_PROCS) {
+        fclose(t -> file);
+        free(t);
+        return NULL;
+    }
+    t -> procs = get_u32(header + 12);
+    return t;
+}
+
+int trace_write(struct trace* t, const struct trace_record* r) {
+    long delta = r -> pc - t -> pc[r -> proc];
+    unsigned long zigzag = delta < 0 ? ((unsigned long)-delta << 1) - 1 : (unsigned long)delta << 1;
+
+    /* Two varints take 20 bytes at most */
+    if (t -> length > sizeof(t -> buffer) - 20 && flush(t)) {
+        return -1;
+    }
+    put_varint(t, (r -> tick - t -> tick) << 5 | r -> proc);
+    put_varint(t, zigzag << 1 | (r -> exited != 0));
+    t -> tick = r -> tick;
+    t -> pc[r -> proc] = r -> pc;
+    return 0;
+}
+
+int trace_read(struct trace* t, struct trace_record* r) {
+    unsigned long first, second;
+    int status;
+
+    if ((status = get_varint(t, &first)) != 1) {
+        return status;      // The end, or a truncated record
+    }
+    if (get_varint(t, &second) != 1 || (int)(first & 31) >= t -> procs) {
+        return -1;
+    }
+    r -> tick = t -> tick += first >> 5;
+    r -> proc = first & 31;
+    r -> exited = second & 1;
+    second >>= 1;
+    r -> pc = t -> pc[r -> proc] += second & 1 ? -(long)((second + 1) >> 1) : (long)(second >> 1);
+    return 1;
+}
+
+int trace_close(struct trace* t) {
+    int status = 0;
+
+    if (!t) {
+        return 0;
+    }
+    if (t -> writing && flush(t)) {
+        status = -1;
+    }
+    if (fclose(t -> file)) {
+        status = -1;
+    }
+    free(t);
+    return status;
+}
+
+/* Write the buffer out */
+static int flush(struct trace* t) {
+    if (fwrite(t -> buffer, 1, t -> length, t -> file) != t -> length) {
+        return -1;
+    }
+    t -> length = 0;
+    return 0;
+}
+
+static void put_varint(struct trace* t, unsigned long value) {
+    while (value >= 0x80) {
+        t -> buffer[t -> length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    t -> buffer[t -> length++] = value;
+}
+
+/* Returns 1, 0 at the end of the trace, or -1 in the middle of a varint */
+static int get_varint(struct trace* t, unsigned long* value) {
+    int byte, shift = 0;
+
+    *value = 0;
+    do {
+        if ((byte = get_byte(t)) == -1) {
+            return shift ? -1 : 0;
+        }
+        if (shift > 63) {
+            return -1;
+        }
+        *value |= (unsigned long)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return 1;
+}
+
+/* The next byte, refilling the buffer, or -1 */
+static int get_byte(struct trace* t) {
+    if (t -> position == t -> length) {
+        t -> length = fread(t -> buffer, 1, sizeof(t -> buffer), t -> file);
+        t -> position = 0;
+        if (t -> length == 0) {
+            return -1;
+        }
+    }
+    return t -> buffer[t -> position++];
+}
+
+static void put_u32(unsigned char* p, u_int32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static u_int32_t get_u32(const unsigned char* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (u_int32_t)p[3] << 24;
+}
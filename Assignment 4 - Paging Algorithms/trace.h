@@ -0,0 +1,70 @@
+/*
+ * File: trace.h
+ *
+ * Description:
+ *     Reference traces: the program counters the processes of a
+ *     simulation executed, one record per compute tick, written
+ *     by the simulator with '-o' and replayed with '-r'
+ *     (simulator.c), or read by trace-matrix.c.
+ *
+ * Format:
+ *     A header of 16 bytes: the magic "PA4TRACE", then the version
+ *     and the number of processes as 32-bit little-endian integers.
+ *     Then the records in tick order, each as two varints (7 bits a
+ *     byte, lowest first, the high bit set on all but the last):
+ *
+ *         (tick - tick of the previous record) << 5 | proc
+ *         zigzag(pc - previous pc of proc) << 1 | exited
+ *
+ *     'exited' is set on the last reference of a program: the next
+ *     record of the slot belongs to the next program. A process
+ *     that runs on within its page costs 2 bytes a reference.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define TRACE_MAGIC     "PA4TRACE"
+#define TRACE_VERSION   1
+#define TRACE_PROCS     32      // Processes a record can name (5 bits)
+
+/* One reference */
+struct trace_record {
+    unsigned long tick;
+    int proc;
+    long pc;
+    int exited;             // The program exits after this reference
+};
+
+/* A trace open for writing or for reading */
+struct trace {
+    FILE* file;
+    int writing;
+    int procs;
+    unsigned long tick;                 // Tick of the last record
+    long pc[TRACE_PROCS];               // Last pc of each process
+    unsigned char buffer[1 << 16];
+    size_t length, position;            // Bytes in the buffer, and read (reading)
+};
+
+/*
+ *  trace_create: open a new trace for 'procs' processes. Returns
+ *                NULL (and errno) if the file cannot be written.
+ *  trace_open:   open a trace to read it. Returns NULL if the file
+ *                cannot be read or is not a trace.
+ *  trace_write:  append a record; records must come in tick order.
+ *                Returns 0, or -1 on a write error.
+ *  trace_read:   read the next record. Returns 1, 0 at the end of
+ *                the trace, or -1 if it is truncated.
+ *  trace_close:  flush and close. Returns 0, or -1 on a write error.
+ */
+struct trace* trace_create(const char* path, int procs);
+struct trace* trace_open(const char* path);
+int trace_write(struct trace* t, const struct trace_record* r);
+int trace_read(struct trace* t, struct trace_record* r);
+int trace_close(struct trace* t);
+
+#endif
@@ -0,0 +1,189 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  ADMISSION CONTROL used by the server program
+ *
+ *  An overloaded server should say no quickly rather than queue work
+ *  it cannot finish in time. Two limits shed load as early as the
+ *  server can:
+ *
+ *      '-c <number>'   connections served at once. A connection over
+ *                      the limit is answered right after accept() with
+ *                      the one byte reply REPLY_REJECTED and closed; it
+ *                      never reaches a queue, a thread or a child.
+ *      '-r <number>'   requests per second from one client address,
+ *                      with bursts of up to ADMIT_BURST_MS worth. A
+ *                      request over the limit is answered with
+ *                      REPLY_REJECTED before its handler runs or is
+ *                      queued for a compute thread.
+ *
+ *  Each client's token bucket is kept as one timestamp, the time its
+ *  bucket will be full again (the "generic cell rate algorithm"): a
+ *  request takes a token by moving that time one interval ahead with
+ *  a compare-and-swap, and is rejected if that would put it more than
+ *  a burst ahead of now. The buckets sit in a table indexed by a hash
+ *  of the address; a client whose slot holds another client's bucket
+ *  takes it over with a full bucket.
+ *
+ *  The state lives in shared memory, so the fork() server's children
+ *  count against the same limits as its threads would.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static struct admission* admission;   // Shared with the fork() children
+
+/*
+ *  admission_init
+ *
+ *  Description:
+ *    Map the shared state and set the limits of '-c' and '-r' (0
+ *    means no limit).
+ *
+ *  Use:
+ *    Called once by the server program before it serves anything.
+ *    Returns -1 on failure.
+ */
+int admission_init(struct cmdline* opts) {
+
+    uint64_t burst;
+
+    if ((admission = mmap(NULL, sizeof(struct admission), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        perror("[Server Program]: mmap");
+        admission = NULL;
+        return -1;
+    }
+    admission -> max_conns = opts -> max_conns;
+    if (opts -> rate > 0) {
+        admission -> interval = 1000000000ULL / opts -> rate;
+        burst = (uint64_t)opts -> rate * ADMIT_BURST_MS / 1000;
+        admission -> tolerance = (burst > 1 ? burst - 1 : 0) * admission -> interval;
+    }
+    return 0;
+}
+
+/*
+ *  admit_connection
+ *
+ *  Description:
+ *    Count a new connection against '-c'. Returns false, counting
+ *    nothing, if the server already serves as many as it may.
+ */
+bool admit_connection(void) {
+
+    int active = atomic_fetch_add(&admission -> active, 1);
+
+    if (admission -> max_conns > 0 && active >= admission -> max_conns) {
+        atomic_fetch_sub(&admission -> active, 1);
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  release_connection
+ *
+ *  Description:
+ *    A connection admitted by admit_connection() has closed.
+ */
+void release_connection(void) {
+    atomic_fetch_sub(&admission -> active, 1);
+}
+
+/*
+ *  reject_connection
+ *
+ *  Description:
+ *    Answer a connection over the limit with REPLY_REJECTED and close
+ *    it. Whatever the client has sent already is read first: closing
+ *    a socket with unread data resets the connection, and the reset
+ *    could destroy the reply before the client reads it.
+ */
+void reject_connection(int fd) {
+
+    uint8_t reply = REPLY_REJECTED;
+    char buf[256];
+
+    send(fd, &reply, sizeof(reply), MSG_NOSIGNAL | MSG_DONTWAIT);
+    shutdown(fd, SHUT_WR);
+    while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0);
+    close(fd);
+    metric_add(MC_REJECTED_CONNS, 1);
+    metric_add(MC_CLOSES, 1);
+}
+
+/*
+ *  reject_request
+ *
+ *  Description:
+ *    Take a token from the bucket of 'client' for a packet. Returns
+ *    true if the packet must be answered with REPLY_REJECTED instead
+ *    of running its handler. The termination number 0 is always let
+ *    through, and so are PROTO_BULK packets, whose payload follows on
+ *    the stream, and PROTO_RUDP segments, which the sender paces.
+ */
+bool reject_request(uint64_t client, uint8_t version, uint32_t number) {
+
+    struct client_bucket* b;
+    uint64_t now, key, full, start;
+
+    if (admission -> interval == 0 || number == 0 || version == PROTO_BULK ||
+        version == PROTO_RUDP) {
+        return false;
+    }
+    b = &admission -> buckets[client % ADMIT_CLIENTS];
+    now = now_ns();
+
+    /* A slot holding another client's bucket is taken over, full */
+    key = atomic_load_explicit(&b -> key, memory_order_relaxed);
+    if (key != client && atomic_compare_exchange_strong(&b -> key, &key, client)) {
+        atomic_store(&b -> full, 0);
+    }
+
+    /* Take a token: move the time the bucket is full one interval on */
+    full = atomic_load(&b -> full);
+    do {
+        start = full > now ? full : now;
+        if (start - now > admission -> tolerance) {
+            metric_add(MC_REJECTED_REQUESTS, 1);
+            return true;   // Empty: the client is over its rate
+        }
+    } while (!atomic_compare_exchange_weak(&b -> full, &full, start + admission -> interval));
+    return false;
+}
+
+/*
+ *  client_key
+ *
+ *  Description:
+ *    Hash a client's IP address (not its port, so every connection
+ *    of one host shares a bucket) with FNV-1a. An IPv4 address seen
+ *    on the dual-stack socket as ::ffff:a.b.c.d hashes as a.b.c.d.
+ */
+uint64_t client_key(struct sockaddr_storage* addr) {
+
+    struct sockaddr_in6* in6 = (struct sockaddr_in6*)addr;
+    const uint8_t* bytes;
+    uint64_t hash = 14695981039346656037ULL;
+    size_t len, i;
+
+    if (addr -> ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&in6 -> sin6_addr)) {
+        bytes = in6 -> sin6_addr.s6_addr + 12;
+        len = 4;
+    }
+    else if (addr -> ss_family == AF_INET6) {
+        bytes = in6 -> sin6_addr.s6_addr;
+        len = 16;
+    }
+    else {
+        bytes = (const uint8_t*)&((struct sockaddr_in*)addr) -> sin_addr;
+        len = 4;
+    }
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
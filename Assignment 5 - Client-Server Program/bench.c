@@ -0,0 +1,579 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  BENCHMARK CLIENT used by the client program ('-m bench')
+ *
+ *  Opens '-c' connections to the server and keeps up to '-k'
+ *  packets in flight on each one for '-d' seconds, then reports
+ *  throughput and a latency histogram.
+ *
+ *  With '-r <rate>' the load is open-loop: request i is due at
+ *  start + i/rate no matter how fast the server answers. Latency is
+ *  measured from that due time, not from when the packet could
+ *  actually be sent, so a stalled server is charged for the requests
+ *  that queued up behind it (no coordinated omission). With '-r 0'
+ *  every reply immediately releases the next request (closed-loop).
+ *
+ *  With '-n <number>' a TCP connection is closed after that many
+ *  replies and a new one is opened with a non-blocking connect(), so
+ *  '-n 1' measures the connection rate of a server (one PROTO_SINGLE
+ *  packet per connection, as sent by the original client).
+ *
+ *  Over UDP each request is tagged with its sequence number, which
+ *  the server echoes in its reply: a reply is matched to its own
+ *  request even after datagrams before it were lost.
+ *
+ *  Requests the server sheds (reply REPLY_REJECTED, admission.c) are
+ *  counted apart from the replies and kept out of the histogram. A
+ *  connection the server rejects is opened again, as a client that
+ *  retries at once would.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static struct addrinfo* open_bench_conns(struct bench_conn* conns, int epfd,
+                                         struct addrinfo* serverInfo, struct cmdline* opts);
+static int reconnect_bench_conn(struct bench_conn* conn, int epfd, struct addrinfo* server,
+                                enum sock_profile profile);
+static int finish_connect(struct bench_conn* conn, int epfd);
+static uint32_t request_room(struct bench_conn* conn, struct cmdline* opts);
+static void queue_request(struct bench_conn* conn, uint64_t due, struct cmdline* opts,
+                          int udp);
+static int flush_requests(struct bench_conn* conn, int udp);
+static int read_replies(struct bench_conn* conn, struct cmdline* opts, int udp,
+                        struct histogram* h, uint64_t* replies, uint64_t* rejected,
+                        uint64_t* errors, uint64_t* lost);
+static uint32_t expire_requests(struct bench_conn* conn, uint64_t before);
+static void count_reply(struct bench_conn* conn, uint8_t reply, uint64_t latency,
+                        struct histogram* h, uint64_t* replies, uint64_t* rejected,
+                        uint64_t* errors);
+
+/*
+ *  run_benchmark
+ *
+ *  Description:
+ *    Drive load at the server until the duration ends, wait up to
+ *    DRAIN_NS for the replies still in flight, and print the report.
+ *    A UDP request is counted lost once UDP_REORDER requests sent
+ *    after it are answered, or its reply does not arrive within
+ *    UDP_TIMEOUT_NS, so one dropped datagram does not stall its socket.
+ *
+ *  Use:
+ *    Called by the client program in '-m bench' mode with the list
+ *    returned by getaddrinfo(). Returns -1 on failure.
+ */
+int run_benchmark(struct cmdline* opts, struct addrinfo* serverInfo) {
+
+    struct bench_conn* conns, *conn;
+    struct addrinfo* server;
+    struct histogram hist;
+    struct epoll_event ev, events[MAXEVENTS];
+    struct itimerspec timer;
+    uint64_t start, end, now, due, interval = 0, issued = 0, last_reply = 0;
+    uint64_t replies = 0, rejected = 0, errors = 0, lost = 0, connects, inflight;
+    uint32_t i, next = 0, room, tried;
+    int udp = serverInfo -> ai_socktype == SOCK_DGRAM;
+    int epfd, timerfd, n, ret = 0;
+    double elapsed;
+
+    if ((conns = calloc(opts -> connections, sizeof(struct bench_conn))) == NULL) {
+        perror("[Client Program]: calloc");
+        return -1;
+    }
+    if ((epfd = epoll_create1(0)) == -1) {
+        perror("[Client Program]: epoll_create1");
+        free(conns);
+        return -1;
+    }
+    if ((server = open_bench_conns(conns, epfd, serverInfo, opts)) == NULL) {
+        close(epfd); free(conns);
+        return -1;
+    }
+    connects = opts -> connections;
+
+    /* An absolute timer wakes the loop when the next open-loop request is due */
+    memset(&timer, 0, sizeof(timer));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if ((timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) == -1 ||
+        epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev) == -1) {
+        perror("[Client Program]: timerfd");
+        close(epfd); free(conns);
+        return -1;
+    }
+    hist_init(&hist);
+    if (opts -> rate > 0) {
+        interval = 1000000000ULL / opts -> rate;
+    }
+
+    printf("------------------------------------------------------------------\n");
+    printf("[Client Program]: Benchmark: %s, %u connections, depth %u, ",
+           udp ? "UDP" : "TCP", opts -> connections, opts -> depth);
+    if (opts -> rate > 0) printf("%u requests/s (open-loop), ", opts -> rate);
+    else printf("closed-loop, ");
+    if (opts -> count > 0) printf("%u requests per connection, ", opts -> count);
+    printf("%u s\n", opts -> duration);
+
+    start = now_ns();
+    end = start + (uint64_t)opts -> duration * 1000000000ULL;
+
+    while (1) {
+        now = now_ns();
+
+        /* Issue requests while the run lasts */
+        if (now < end) {
+            if (interval > 0) {
+                /* Open-loop: every request due by now, oldest first */
+                for (tried = 0; issued < (now - start) / interval + 1 &&
+                                tried < opts -> connections; ) {
+                    if (request_room(&conns[next], opts) > 0) {
+                        queue_request(&conns[next], start + issued * interval, opts, udp);
+                        issued++;
+                        tried = 0;
+                    }
+                    else {
+                        tried++;
+                    }
+                    next = (next + 1) % opts -> connections;
+                }
+            }
+            else {
+                /* Closed-loop: refill every window */
+                for (i = 0; i < opts -> connections; i++) {
+                    for (room = request_room(&conns[i], opts); room > 0; room--) {
+                        queue_request(&conns[i], now, opts, udp);
+                        issued++;
+                    }
+                }
+            }
+        }
+
+        /* Send what was queued; give up on UDP replies that never came */
+        for (inflight = 0, i = 0; i < opts -> connections; i++) {
+            if (conns[i].outlen > 0 && !conns[i].connecting &&
+                flush_requests(&conns[i], udp) == -1) {
+                ret = -1;
+                goto done;
+            }
+            if (udp) lost += expire_requests(&conns[i], now - UDP_TIMEOUT_NS);
+            inflight += conns[i].inflight;
+        }
+
+        /* The run is over once every reply is in or the drain time is up */
+        if (now >= end && (inflight == 0 || now >= end + DRAIN_NS)) {
+            for (i = 0; i < opts -> connections; i++) {
+                lost += udp ? expire_requests(&conns[i], UINT64_MAX) : conns[i].inflight;
+            }
+            break;
+        }
+
+        /* Sleep until the next request is due or a reply arrives (at most 100 ms) */
+        if (now < end && interval > 0 && (due = start + issued * interval) > now) {
+            timer.it_value.tv_sec = due / 1000000000ULL;
+            timer.it_value.tv_nsec = due % 1000000000ULL;
+            timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &timer, NULL);
+        }
+
+        if ((n = epoll_wait(epfd, events, MAXEVENTS, 100)) == -1) {
+            if (errno == EINTR) continue;
+            perror("[Client Program]: epoll_wait");
+            ret = -1;
+            goto done;
+        }
+        for (i = 0; i < (uint32_t)n; i++) {
+            if (events[i].data.ptr == NULL) {
+                if (read(timerfd, &due, sizeof(due)) == -1 && errno != EAGAIN) {
+                    perror("[Client Program]: read");
+                }
+                continue;
+            }
+            conn = events[i].data.ptr;
+
+            /* A new connection is writable once its handshake completes */
+            if (conn -> connecting) {
+                if ((events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) &&
+                    finish_connect(conn, epfd) == -1) {
+                    ret = -1;
+                    goto done;
+                }
+                continue;
+            }
+            if ((n = read_replies(conn, opts, udp, &hist, &replies, &rejected, 
+                                  &errors, &lost)) == -1) {
+                ret = -1;
+                goto done;
+            }
+            last_reply = now_ns();
+
+            /* Every reply this connection may carry is in, or the server
+               rejected it: open the next one */
+            if (n == 1) {
+                if (reconnect_bench_conn(conn, epfd, server, opts -> profile) == -1) {
+                    ret = -1;
+                    goto done;
+                }
+                connects++;
+            }
+        }
+    }
+
+    /* Report throughput and the latency distribution */
+    elapsed = ((last_reply > end ? last_reply : end) - start) / 1e9;
+    printf("[Client Program]: %lu requests sent, %lu replies, %lu rejected, %lu errors, "
+           "%lu lost\n", (unsigned long)issued, (unsigned long)replies, 
+           (unsigned long)rejected, (unsigned long)errors, (unsigned long)lost);
+    printf("[Client Program]: Throughput: %.0f replies/s over %.2f s\n",
+           replies / elapsed, elapsed);
+    if (opts -> count > 0) {
+        printf("[Client Program]: %lu connections opened (%.0f/s)\n",
+               (unsigned long)connects, connects / elapsed);
+    }
+    hist_print(&hist, "[Client Program]:");
+
+done:
+    for (i = 0; i < opts -> connections; i++) {
+        if (conns[i].fd > 0) close(conns[i].fd);
+    }
+    close(timerfd);
+    close(epfd);
+    free(conns);
+    return ret;
+}
+
+/*
+ *  open_bench_conns
+ *
+ *  Description:
+ *    Race a connection to the server addresses (connect.c), then
+ *    connect every other benchmark socket to the address that won.
+ *    Each socket is made non-blocking and watched for replies, and a
+ *    TCP socket gets the options of the '-o' profile (profile.c). A
+ *    connected UDP socket only receives datagrams from the server.
+ *    Returns the address that won (where new connections are opened),
+ *    or NULL on failure.
+ */
+static struct addrinfo* open_bench_conns(struct bench_conn* conns, int epfd,
+                                         struct addrinfo* serverInfo, struct cmdline* opts) {
+
+    struct addrinfo* server = NULL;
+    struct epoll_event ev;
+    uint32_t i;
+    int fd = -1, attempts;
+
+    for (i = 0; i < opts -> connections; i++) {
+        if (server == NULL) {
+            fd = race_connect(serverInfo, opts -> attempt_delay, &server, &attempts);
+        }
+        else if ((fd = socket(server -> ai_family, server -> ai_socktype,
+                              server -> ai_protocol)) != -1 &&
+                 connect(fd, server -> ai_addr, server -> ai_addrlen) == -1) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd == -1) {
+            perror("[Client Program]: connect");
+            return NULL;
+        }
+        conns[i].fd = fd;
+        if (set_nonblocking(fd) == -1) {
+            perror("[Client Program]: fcntl");
+            return NULL;
+        }
+        if (server -> ai_socktype == SOCK_STREAM &&
+            apply_profile(fd, opts -> profile, "[Client Program]:") == -1) {
+            return NULL;
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = &conns[i];
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            perror("[Client Program]: epoll_ctl");
+            return NULL;
+        }
+    }
+    return server;
+}
+
+/*
+ *  reconnect_bench_conn
+ *
+ *  Description:
+ *    Close a connection that carried its '-n' requests and start a
+ *    non-blocking connect() to the same server address on a new
+ *    socket of 'profile'. Requests may be queued at once; they are
+ *    sent when finish_connect() sees the handshake complete. Returns
+ *    -1 on failure.
+ */
+static int reconnect_bench_conn(struct bench_conn* conn, int epfd, struct addrinfo* server,
+                                enum sock_profile profile) {
+
+    struct epoll_event ev;
+
+    close(conn -> fd);   // Also removes it from the epoll set
+    conn -> sent = 0;
+    conn -> outlen = 0;
+    conn -> rejected = false;
+    if ((conn -> fd = socket(server -> ai_family, server -> ai_socktype | SOCK_NONBLOCK,
+                             server -> ai_protocol)) == -1) {
+        perror("[Client Program]: socket");
+        return -1;
+    }
+    conn -> connecting = false;
+    if (apply_profile(conn -> fd, profile, "[Client Program]:") == -1) {
+        return -1;
+    }
+    if (connect(conn -> fd, server -> ai_addr, server -> ai_addrlen) == -1) {
+        if (errno != EINPROGRESS) {
+            perror("[Client Program]: connect");
+            return -1;
+        }
+        conn -> connecting = true;
+    }
+    ev.events = conn -> connecting ? EPOLLOUT : EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn -> fd, &ev) == -1) {
+        perror("[Client Program]: epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *  finish_connect
+ *
+ *  Description:
+ *    Check the result of a non-blocking connect() and, if it worked,
+ *    watch the socket for replies instead. Returns -1 on failure.
+ */
+static int finish_connect(struct bench_conn* conn, int epfd) {
+
+    struct epoll_event ev;
+    socklen_t len = sizeof(int);
+    int err = 0;
+
+    if (getsockopt(conn -> fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0) {
+        errno = err ? err : errno;
+        perror("[Client Program]: connect");
+        return -1;
+    }
+    conn -> connecting = false;
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn -> fd, &ev) == -1) {
+        perror("[Client Program]: epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *  request_room
+ *
+ *  Description:
+ *    How many more requests a connection may queue now: the free part
+ *    of its '-k' window, limited by what is left of its '-n' requests.
+ */
+static uint32_t request_room(struct bench_conn* conn, struct cmdline* opts) {
+
+    uint32_t room = opts -> depth - conn -> inflight;
+
+    if (opts -> count > 0 && opts -> count - conn -> sent < room) {
+        room = opts -> count - conn -> sent;
+    }
+    return room;
+}
+
+/*
+ *  queue_request
+ *
+ *  Description:
+ *    Pack one packet into the connection's output buffer and remember
+ *    when it was due. Packets are of version '-v' (PROTO_PERSISTENT
+ *    unless selected) unless each connection carries a single request
+ *    ('-n 1'), which is PROTO_SINGLE. A UDP packet is followed by its
+ *    tag: the number of packets sent before it.
+ */
+static void queue_request(struct bench_conn* conn, uint64_t due, struct cmdline* opts,
+                          int udp) {
+
+    struct packet pkt;
+    uint32_t tag = htonl(conn -> sent);
+
+    pkt.version = opts -> count == 1 ? PROTO_SINGLE : opts -> version;
+    pkt.number = htonl(opts -> data);
+    memcpy(conn -> outbuf + conn -> outlen, &pkt, sizeof(pkt));
+    conn -> outlen += sizeof(pkt);
+    if (udp) {
+        memcpy(conn -> outbuf + conn -> outlen, &tag, UDP_TAGSIZE);
+        conn -> outlen += UDP_TAGSIZE;
+    }
+    conn -> sent_at[(conn -> head + conn -> inflight) % MAXDEPTH] = due;
+    conn -> inflight++;
+    conn -> sent++;
+}
+
+/*
+ *  flush_requests
+ *
+ *  Description:
+ *    Send the queued packets. A TCP connection sends them as one
+ *    stream and keeps whatever the socket did not take; a UDP socket
+ *    sends one datagram per packet. Returns -1 on failure.
+ */
+static int flush_requests(struct bench_conn* conn, int udp) {
+
+    size_t total = 0, len;
+    ssize_t n;
+
+    while (total < conn -> outlen) {
+        len = udp ? UDP_REQUESTSIZE : conn -> outlen - total;
+        if ((n = send(conn -> fd, conn -> outbuf + total, len, MSG_NOSIGNAL)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (udp && errno == ECONNREFUSED) {
+                total += len;   // Counted as lost when the reply times out
+                continue;
+            }
+            if (!udp && (errno == EPIPE || errno == ECONNRESET)) {
+                total = conn -> outlen;   // Rejected: read_replies() sees it closed
+                break;
+            }
+            perror("[Client Program]: send");
+            return -1;
+        }
+        total += n;
+    }
+    memmove(conn -> outbuf, conn -> outbuf + total, conn -> outlen - total);
+    conn -> outlen -= total;
+    return 0;
+}
+
+/*
+ *  read_replies
+ *
+ *  Description:
+ *    Receive every reply waiting on a connection and record the
+ *    latency of the packet each one answers: the oldest in flight on
+ *    TCP, the one its tag names on UDP. A UDP reply to a packet
+ *    already counted lost is dropped, and one without a tag is an
+ *    error. Answered packets leave the window once every packet
+ *    before them has too; a packet still unanswered when UDP_REORDER
+ *    packets after it are answered is counted lost. Returns 1 once
+ *    all '-n' replies of the connection are in or the server rejected
+ *    the connection, -1 if the server closed a TCP connection early
+ *    or an error occurred, and 0 otherwise.
+ *
+ *    A rejected connection is closed after its REPLY_REJECTED byte;
+ *    if the client's packets arrive after the close, the server's
+ *    reset may destroy the byte. So a connection closed after a
+ *    REPLY_REJECTED, or before any reply, counts as rejected, and so
+ *    does every packet still in flight on it.
+ */
+static int read_replies(struct bench_conn* conn, struct cmdline* opts, int udp,
+                        struct histogram* h, uint64_t* replies, uint64_t* rejected,
+                        uint64_t* errors, uint64_t* lost) {
+
+    uint8_t buf[MAXDEPTH];
+    uint32_t tag, offset, slot;
+    int64_t ahead;
+    uint64_t now;
+    ssize_t n, i;
+
+    while (1) {
+        if (!udp && opts -> count > 0 && conn -> sent == opts -> count && 
+            conn -> inflight == 0) {
+            return 1;   // The server may close a PROTO_SINGLE connection now
+        }
+        if ((n = recv(conn -> fd, buf, udp ? UDP_REPLYSIZE : sizeof(buf), 0)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (udp && errno == ECONNREFUSED) return 0;
+            if (errno != ECONNRESET && errno != EPIPE) {
+                perror("[Client Program]: recv");
+                return -1;
+            }
+            n = 0;
+        }
+        if (n == 0 && !conn -> rejected && conn -> inflight < conn -> sent) {
+            fprintf(stderr, "[Client Program]: Server closed a benchmark connection\n");
+            return -1;
+        }
+        if (n == 0) {
+            *rejected += conn -> inflight;
+            conn -> head = (conn -> head + conn -> inflight) % MAXDEPTH;
+            conn -> inflight = 0;
+            return 1;
+        }
+        now = now_ns();
+        if (udp) {
+            if (n != UDP_REPLYSIZE) {
+                (*errors)++;
+                continue;
+            }
+            memcpy(&tag, buf + 1, UDP_TAGSIZE);
+            offset = ntohl(tag) - (conn -> sent - conn -> inflight);
+            slot = (conn -> head + offset) % MAXDEPTH;
+            if (offset >= conn -> inflight || conn -> sent_at[slot] == 0) {
+                continue;   // Late (counted lost) or duplicated
+            }
+            count_reply(conn, buf[0], now - conn -> sent_at[slot], h, replies, rejected,
+                        errors);
+            conn -> sent_at[slot] = 0;
+            for (ahead = offset; conn -> inflight > 0 && 
+                 (conn -> sent_at[conn -> head] == 0 || ahead >= UDP_REORDER); ahead--) {
+                if (conn -> sent_at[conn -> head] != 0) (*lost)++;
+                conn -> head = (conn -> head + 1) % MAXDEPTH;
+                conn -> inflight--;
+            }
+            continue;
+        }
+        for (i = 0; i < n && conn -> inflight > 0; i++) {
+            count_reply(conn, buf[i], now - conn -> sent_at[conn -> head], h, replies,
+                        rejected, errors);
+            conn -> head = (conn -> head + 1) % MAXDEPTH;
+            conn -> inflight--;
+        }
+    }
+}
+
+/*
+ *  expire_requests
+ *
+ *  Description:
+ *    Retire the UDP packets at the head of a connection's window
+ *    that were answered or sent before 'before', and return how
+ *    many of them were never answered (lost).
+ */
+static uint32_t expire_requests(struct bench_conn* conn, uint64_t before) {
+
+    uint32_t expired = 0;
+
+    while (conn -> inflight > 0 && conn -> sent_at[conn -> head] < before) {
+        if (conn -> sent_at[conn -> head] != 0) expired++;
+        conn -> head = (conn -> head + 1) % MAXDEPTH;
+        conn -> inflight--;
+    }
+    return expired;
+}
+
+/*
+ *  count_reply
+ *
+ *  Description:
+ *    Count one reply: a success goes into the latency histogram, a
+ *    REPLY_REJECTED is counted apart, anything else is an error.
+ */
+static void count_reply(struct bench_conn* conn, uint8_t reply, uint64_t latency,
+                        struct histogram* h, uint64_t* replies, uint64_t* rejected,
+                        uint64_t* errors) {
+    if (reply == 1) {
+        hist_record(h, latency);
+        (*replies)++;
+    }
+    else if (reply == REPLY_REJECTED) {
+        conn -> rejected = true;   // The server may close it now
+        (*rejected)++;
+    }
+    else (*errors)++;
+}
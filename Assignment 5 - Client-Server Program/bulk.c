@@ -0,0 +1,546 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  BULK TRANSFERS used by the client ('-m bulk') and server programs
+ *
+ *  A PROTO_BULK packet announces a payload: its 'number' is the
+ *  payload length in bytes, and the payload follows it on the TCP
+ *  stream. The server answers with the usual one byte reply once the
+ *  whole payload has arrived and then waits for the next packet, so
+ *  one connection can carry any number of transfers.
+ *
+ *  The payload is sent from a file descriptor (a file, or a memfd
+ *  filled with generated data) by one of four methods ('-z'):
+ *
+ *    copy        pread() into a large buffer, then sendall()
+ *    sendfile    sendfile(): page cache to socket inside the kernel
+ *    splice      splice() file to pipe, then pipe to socket
+ *    zerocopy    send() with MSG_ZEROCOPY from an mmap() of the file;
+ *                the pages are pinned instead of copied, and the
+ *                kernel reports on the socket error queue when they
+ *                may be reused (or that it had to copy them anyway)
+ *
+ *  and received by the server with 'splice' (socket to pipe to file)
+ *  or 'copy' (recv() into a large buffer). A method the kernel does
+ *  not support falls back to 'copy'.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static int send_copy(int sock, int fd, size_t len);
+static int send_sendfile(int sock, int fd, size_t len);
+static int send_splice(int sock, int fd, size_t len);
+static int send_zerocopy(int sock, int fd, size_t len, uint32_t* next, bool* copied);
+static int read_completions(int sock, uint32_t* completed, bool* copied, bool block);
+static int recv_copy(int sock, int outfd, size_t len);
+static int open_pipe(int pipefd[2], const char* prefix);
+
+/* Payloads this server process has received, for their file names */
+static atomic_uint bulk_received;
+
+/*
+ *  run_bulk
+ *
+ *  Description:
+ *    Send '-n' bulk transfers over a connected TCP socket with the
+ *    '-z' method, waiting for the server's reply after each one, and
+ *    print the rate of every transfer and of the whole run.
+ *
+ *  Use:
+ *    Called by the client program in '-m bulk' mode. The payload is
+ *    the '-f' file, or '-x' bytes of generated data. Returns -1 on
+ *    failure.
+ */
+int run_bulk(int sock, struct cmdline* opts) {
+
+    struct packet header;
+    uint8_t reply;
+    uint64_t start, begin, elapsed, total = 0;
+    size_t len;
+    uint32_t i, zc_next = 0;     // MSG_ZEROCOPY sends made on 'sock' so far
+    bool copied = false;
+    int fd, numbytes, ret = 0;
+
+    if ((fd = open_payload(opts, &len)) == -1) {
+        return -1;
+    }
+    header.version = PROTO_BULK;
+    header.number = htonl((uint32_t)len);
+
+    begin = now_ns();
+    for (i = 0; i < opts -> count; i++) {
+        start = now_ns();
+
+        /* Announce the payload, then send it with the selected method; the
+           throughput profile corks the two, so the header rides along in
+           the first full segment of the payload (profile.c) */
+        cork_socket(sock, opts -> profile, true);
+        numbytes = sizeof(header);
+        if (sendall(sock, (char*)&header, &numbytes) == -1) {
+            ret = -1;
+            break;
+        }
+        if (!strcmp(opts -> method, "sendfile")) ret = send_sendfile(sock, fd, len);
+        else if (!strcmp(opts -> method, "splice")) ret = send_splice(sock, fd, len);
+        else if (!strcmp(opts -> method, "zerocopy")) {
+            ret = send_zerocopy(sock, fd, len, &zc_next, &copied);
+        }
+        else ret = send_copy(sock, fd, len);
+        cork_socket(sock, opts -> profile, false);
+        if (ret == -1) break;
+
+        /* The reply means the server holds every byte */
+        numbytes = sizeof(reply);
+        if (recvall(sock, (char*)&reply, &numbytes) == -1 || numbytes != 1 || reply != 1) {
+            printf("[Client Program]: ERROR server reply not receieved.\n");
+            ret = -1;
+            break;
+        }
+        elapsed = now_ns() - start;
+        total += len;
+        printf("[Client Program]: transfer %u: %zu bytes via %s in %.3f s: %.2f GB/s\n",
+               i + 1, len, opts -> method, elapsed / 1e9, (double)len / elapsed);
+    }
+    elapsed = now_ns() - begin;
+
+    if (ret == 0) {
+        printf("[Client Program]: %s: %lu bytes in %u transfers, %.3f s: %.2f GB/s\n",
+               opts -> method, (unsigned long)total, opts -> count, elapsed / 1e9,
+               (double)total / elapsed);
+        if (copied) {
+            printf("[Client Program]: zerocopy: the kernel copied the pages anyway "
+                   "(always the case on loopback)\n");
+        }
+    }
+    close(fd);
+    return ret;
+}
+
+/*
+ *  recv_bulk
+ *
+ *  Description:
+ *    Receive a 'len' byte payload from a TCP socket with the server's
+ *    '-z' method, writing it to a file of its own named after the '-f'
+ *    file, <file>.<pid>.<n>, or discarding it. Pool threads and fork()
+ *    children receive at the same time, so no two share a file. The
+ *    first 'headlen' bytes at 'head' were already read along with the
+ *    packet. Prints the receive rate unless '-q' is given.
+ *
+ *  Use:
+ *    Called by the fork() child and the pool threads when a
+ *    PROTO_BULK packet arrives. Returns -1 if the client closed the
+ *    connection early or an error occurred.
+ */
+int recv_bulk(int sock, uint32_t len, const char* head, size_t headlen,
+              struct cmdline* opts) {
+
+    char path[PATH_MAX];
+    int pipefd[2], outfd, ret = 0;
+    uint64_t start = now_ns(), elapsed;
+    size_t left = len - headlen, chunk;
+    ssize_t n, m;
+    bool splicing = !strcmp(opts -> method, "splice"), piped = false;
+
+    /* The payload goes to a file of its own, or is thrown away */
+    if (opts -> file != NULL) {
+        snprintf(path, sizeof(path), "%s.%ld.%u", opts -> file, (long)getpid(),
+                 atomic_fetch_add(&bulk_received, 1) + 1);
+    }
+    if ((outfd = open(opts -> file ? path : "/dev/null",
+                      O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        perror("[Server Program]: open");
+        return -1;
+    }
+    if (headlen > 0 && opts -> file != NULL &&
+        write(outfd, head, headlen) != (ssize_t)headlen) {
+        perror("[Server Program]: write");
+        close(outfd);
+        return -1;
+    }
+    if (splicing) {
+        splicing = piped = open_pipe(pipefd, "[Server Program]:") == 0;
+    }
+
+    /* splice(): socket pages move into the pipe and on to the file */
+    while (splicing && left > 0) {
+        chunk = left < BULK_PIPESIZE ? left : BULK_PIPESIZE;
+        if ((n = splice(sock, NULL, pipefd[1], NULL, chunk,
+                        SPLICE_F_MOVE | SPLICE_F_MORE)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && left + headlen == len) {
+                splicing = false;   // Not supported here: copy instead
+                break;
+            }
+            perror("[Server Program]: splice");
+            ret = -1;
+            break;
+        }
+        if (n == 0) {
+            ret = -1;   // Client closed the connection early
+            break;
+        }
+        for (left -= n; n > 0; n -= m) {
+            if ((m = splice(pipefd[0], NULL, outfd, NULL, n, SPLICE_F_MOVE)) == -1) {
+                if (errno == EINTR) {
+                    m = 0;
+                    continue;
+                }
+                perror("[Server Program]: splice");
+                ret = -1;
+                break;
+            }
+        }
+        if (ret == -1) break;
+    }
+    if (piped) {
+        close(pipefd[0]); close(pipefd[1]);
+    }
+
+    /* recv() into a buffer: the fallback, and the 'copy' method */
+    if (ret == 0 && left > 0) {
+        ret = recv_copy(sock, opts -> file ? outfd : -1, left);
+    }
+    close(outfd);
+
+    elapsed = now_ns() - start;
+    if (ret == 0 && !opts -> quiet) {
+        printf("[Server Program]: <%u bytes> bulk payload receieved via %s in %.3f s "
+               "(%.2f GB/s)\n", len, splicing ? "splice" : "copy", elapsed / 1e9,
+               (double)len / elapsed);
+    }
+    return ret;
+}
+
+/*
+ *  open_payload
+ *
+ *  Description:
+ *    Open the payload of a bulk transfer: the '-f' file, or a memfd
+ *    holding '-x' bytes of generated data. Sets 'len' to the payload
+ *    size and returns a file descriptor, or -1 on failure.
+ *
+ *  Use:
+ *    Called by run_bulk() and by run_rudp() (rudp.c).
+ */
+int open_payload(struct cmdline* opts, size_t* len) {
+
+    struct stat st;
+    char* buf;
+    size_t done, chunk;
+    int fd;
+
+    if (opts -> file != NULL) {
+        if ((fd = open(opts -> file, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+            perror("[Client Program]: open");
+            return -1;
+        }
+        if (st.st_size == 0 || st.st_size > UINT32_MAX) {
+            fprintf(stderr, "[Client Program]: %s must hold 1 byte to 4 GB\n", opts -> file);
+            close(fd);
+            return -1;
+        }
+        *len = st.st_size;
+        return fd;
+    }
+
+    /* Generate the stream once so every method sends the same pages */
+    *len = opts -> data;
+    if ((fd = memfd_create("bulk-payload", 0)) == -1 || (buf = malloc(BULK_BUFSIZE)) == NULL) {
+        perror("[Client Program]: memfd_create");
+        return -1;
+    }
+    for (done = 0; done < BULK_BUFSIZE; done++) {
+        buf[done] = (char)(done * 31 + 7);
+    }
+    for (done = 0; done < *len; done += chunk) {
+        chunk = *len - done < BULK_BUFSIZE ? *len - done : BULK_BUFSIZE;
+        if (write(fd, buf, chunk) != (ssize_t)chunk) {
+            perror("[Client Program]: write");
+            free(buf); close(fd);
+            return -1;
+        }
+    }
+    free(buf);
+    return fd;
+}
+
+/*
+ *  send_copy
+ *
+ *  Description:
+ *    Read the payload into a large buffer and sendall() it: two copies
+ *    of every byte, and the fallback for every other method.
+ */
+static int send_copy(int sock, int fd, size_t len) {
+
+    char* buf;
+    size_t off;
+    ssize_t n;
+    int numbytes, ret = 0;
+
+    if ((buf = malloc(BULK_BUFSIZE)) == NULL) {
+        perror("[Client Program]: malloc");
+        return -1;
+    }
+    for (off = 0; off < len; off += n) {
+        if ((n = pread(fd, buf, len - off < BULK_BUFSIZE ? len - off : BULK_BUFSIZE,
+                       off)) <= 0) {
+            perror("[Client Program]: pread");
+            ret = -1;
+            break;
+        }
+        numbytes = n;
+        if (sendall(sock, buf, &numbytes) == -1) {
+            ret = -1;
+            break;
+        }
+    }
+    free(buf);
+    return ret;
+}
+
+/*
+ *  send_sendfile
+ *
+ *  Description:
+ *    Send the payload with sendfile(): the kernel copies from the page
+ *    cache straight into the socket, so the data never enters user
+ *    space.
+ */
+static int send_sendfile(int sock, int fd, size_t len) {
+
+    off_t off = 0;
+    ssize_t n;
+
+    while ((size_t)off < len) {
+        if ((n = sendfile(sock, fd, &off, len - off)) == -1) {
+            if (errno == EINTR) continue;
+            if ((errno == EINVAL || errno == ENOSYS) && off == 0) {
+                fprintf(stderr, "[Client Program]: sendfile not supported, using copy\n");
+                return send_copy(sock, fd, len);
+            }
+            perror("[Client Program]: sendfile");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ *  send_splice
+ *
+ *  Description:
+ *    Send the payload with splice(): page references move from the
+ *    file into a pipe and from the pipe into the socket.
+ */
+static int send_splice(int sock, int fd, size_t len) {
+
+    int pipefd[2], ret = 0;
+    loff_t off = 0;
+    ssize_t n, m;
+
+    if (open_pipe(pipefd, "[Client Program]:") == -1) {
+        return send_copy(sock, fd, len);
+    }
+    while ((size_t)off < len) {
+        if ((n = splice(fd, &off, pipefd[1], NULL,
+                        len - off < BULK_PIPESIZE ? len - off : BULK_PIPESIZE,
+                        SPLICE_F_MOVE | SPLICE_F_MORE)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && off == 0) {
+                fprintf(stderr, "[Client Program]: splice not supported, using copy\n");
+                close(pipefd[0]); close(pipefd[1]);
+                return send_copy(sock, fd, len);
+            }
+            perror("[Client Program]: splice");
+            ret = -1;
+            break;
+        }
+        for ( ; n > 0; n -= m) {
+            if ((m = splice(pipefd[0], NULL, sock, NULL, n,
+                            SPLICE_F_MOVE | SPLICE_F_MORE)) == -1) {
+                if (errno == EINTR) {
+                    m = 0;
+                    continue;
+                }
+                perror("[Client Program]: splice");
+                close(pipefd[0]); close(pipefd[1]);
+                return -1;
+            }
+        }
+    }
+    close(pipefd[0]); close(pipefd[1]);
+    return ret;
+}
+
+/*
+ *  send_zerocopy
+ *
+ *  Description:
+ *    Send the payload with MSG_ZEROCOPY from an mmap() of it. Each
+ *    send() pins its pages until the kernel posts a completion on the
+ *    socket error queue, so the mapping is kept until every send is
+ *    complete. ENOBUFS means too many sends are pinned: reap some
+ *    completions and try again. 'copied' is set if the kernel reports
+ *    that it copied the data after all.
+ *
+ *    The kernel numbers the sends of a socket from 0 across all its
+ *    transfers: 'next' is the number of the first send of this one,
+ *    and is advanced past its last. If the completions do not all
+ *    arrive, the connection is shut down before the pages are
+ *    unmapped, so the kernel sends none of them after.
+ */
+static int send_zerocopy(int sock, int fd, size_t len, uint32_t* next, bool* copied) {
+
+    uint32_t base = *next, issued = 0, completed = *next;
+    size_t off = 0;
+    ssize_t n;
+    char* map;
+    int set = 1, ret = 0;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &set, sizeof(set)) == -1) {
+        fprintf(stderr, "[Client Program]: MSG_ZEROCOPY not supported, using copy\n");
+        return send_copy(sock, fd, len);
+    }
+    if ((map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        perror("[Client Program]: mmap");
+        return -1;
+    }
+    while (off < len) {
+        if ((n = send(sock, map + off, len - off < BULK_BUFSIZE ? len - off : BULK_BUFSIZE,
+                      MSG_ZEROCOPY | MSG_NOSIGNAL)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) {
+                if (read_completions(sock, &completed, copied, true) == -1) {
+                    ret = -1;
+                    break;
+                }
+                continue;
+            }
+            perror("[Client Program]: send");
+            ret = -1;
+            break;
+        }
+        off += n;
+        issued++;
+        read_completions(sock, &completed, copied, false);
+    }
+
+    /* The pages may not be unmapped while the kernel still holds them */
+    while (completed - base < issued) {
+        if (read_completions(sock, &completed, copied, true) == -1) {
+            shutdown(sock, SHUT_RDWR);
+            ret = -1;
+            break;
+        }
+    }
+    *next = base + issued;
+    munmap(map, len);
+    return ret;
+}
+
+/*
+ *  read_completions
+ *
+ *  Description:
+ *    Read the MSG_ZEROCOPY completions queued on the socket's error
+ *    queue. Each one covers a range of sends (numbered from 0 in the
+ *    order they were made on the socket); 'completed' becomes one past
+ *    the highest.
+ *    With 'block' set, wait up to a second for the first completion.
+ *    Returns -1 on failure.
+ */
+static int read_completions(int sock, uint32_t* completed, bool* copied, bool block) {
+
+    struct pollfd pfd = { .fd = sock, .events = 0 };
+    struct sock_extended_err* err;
+    struct cmsghdr* cm;
+    struct msghdr msg;
+    char control[128];
+
+    if (block && poll(&pfd, 1, 1000) <= 0) {
+        fprintf(stderr, "[Client Program]: zerocopy completions timed out\n");
+        return -1;
+    }
+    while (1) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sock, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            perror("[Client Program]: recvmsg");
+            return -1;
+        }
+        for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            err = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (err -> ee_errno != 0 || err -> ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if ((int32_t)(err -> ee_data + 1 - *completed) > 0) {
+                *completed = err -> ee_data + 1;   // ee_info..ee_data are done
+            }
+            if (err -> ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                *copied = true;
+            }
+        }
+    }
+}
+
+/*
+ *  recv_copy
+ *
+ *  Description:
+ *    Receive 'len' bytes into a large buffer and write them to 'outfd'
+ *    (or drop them if 'outfd' is -1). Returns -1 if the client closed
+ *    the connection early or an error occurred.
+ */
+static int recv_copy(int sock, int outfd, size_t len) {
+
+    char* buf;
+    ssize_t n;
+    int ret = 0;
+
+    if ((buf = malloc(BULK_BUFSIZE)) == NULL) {
+        perror("[Server Program]: malloc");
+        return -1;
+    }
+    while (len > 0) {
+        if ((n = recv(sock, buf, len < BULK_BUFSIZE ? len : BULK_BUFSIZE, 0)) <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1) perror("[Server Program]: recv");
+            ret = -1;
+            break;
+        }
+        if (outfd != -1 && write(outfd, buf, n) != n) {
+            perror("[Server Program]: write");
+            ret = -1;
+            break;
+        }
+        len -= n;
+    }
+    free(buf);
+    return ret;
+}
+
+/*
+ *  open_pipe
+ *
+ *  Description:
+ *    Create the pipe a splice() goes through and grow it to
+ *    BULK_PIPESIZE so each splice() moves more pages (the default pipe
+ *    holds 64 KB; a smaller pipe still works). A failure is printed
+ *    after 'prefix', the name of the calling program. Returns -1 on
+ *    failure.
+ */
+static int open_pipe(int pipefd[2], const char* prefix) {
+    if (pipe(pipefd) == -1) {
+        fprintf(stderr, "%s pipe: %s\n", prefix, strerror(errno));
+        return -1;
+    }
+    fcntl(pipefd[1], F_SETPIPE_SZ, BULK_PIPESIZE);
+    return 0;
+}
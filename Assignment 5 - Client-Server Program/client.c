@@ -12,14 +12,19 @@
  */
 #include "headerPA5.h"
 
+static int pipeline_packets(int sock, struct cmdline* opts);
+static void print_reply(uint8_t reply);
+
 int main(int argc, char* argv[]) {
 
     struct timeval tv;
     struct cmdline clientOpts;
+    struct sockaddr_storage from;
     struct addrinfo hints, *clientInfo, *cursor;
-    int ret, clientSock = 0, numbytes = sizeof(struct packet);
-    char addrStr[INET6_ADDRSTRLEN], buf[MAXDATASIZE];
-    socklen_t addrLen = sizeof(struct sockaddr_in);
+    int ret, attempts, clientSock = 0, numbytes = sizeof(struct packet);
+    char addrStr[INET6_ADDRSTRLEN], buf[MAXDATASIZE], *hosts;
+    socklen_t addrLen = sizeof(from);
+    uint64_t start;
 
     /* Initialize command-line arguments, hints, and 3 second timeout */
     clientOpts = parser(argc, argv, CLIENT);          // Get command-line options
@@ -28,45 +33,59 @@ int main(int argc, char* argv[]) {
 
     /* Pack the message sent to the server */
     struct packet data_packet;
-    data_packet.version = 0x1;
+    data_packet.version = PROTO_SINGLE;
     data_packet.number = htonl(clientOpts.data);
     memcpy(&buf, &data_packet, 5);
 
-    /* Create a list of addrinfo structures for the client program */
-    if (clientOpts.hostname == NULL) {      // Ipv4 address selected
-        if ((ret = getaddrinfo(inet_ntoa(clientOpts.ipv4_address), clientOpts.port,
-                               &hints, &clientInfo)) != 0) {
-            fprintf(stderr, "[Client Program]: getaddrinfo: %s\n", gai_strerror(ret));
-            return 1;
-        }
+    /* Create a list of addrinfo structures for the client program: one
+       IPv4 address, or every address of a list of hosts (connect.c) */
+    hosts = clientOpts.hostname != NULL ? clientOpts.hostname 
+                                        : inet_ntoa(clientOpts.ipv4_address);
+    if (resolve_hosts(hosts, clientOpts.port, &hints, &clientInfo) != 0) {
+        return 1;   // Reported by resolve_hosts()
     }
-    else {  // Hostname selected
-        if ((ret = getaddrinfo(clientOpts.hostname, clientOpts.port,
-                               &hints, &clientInfo)) != 0) {
-            fprintf(stderr, "[Client Program]: getaddrinfo: %s\n", gai_strerror(ret));
-            return 1;
+
+    /* Shared memory: a server on this host answers through shared memory,
+       any other server over TCP (shm.c) */
+    if (!strcmp(clientOpts.socktype, "shm")) {
+        uint8_t reply;
+        if ((ret = run_shm(&clientOpts, clientInfo, &reply)) != SHM_UNAVAILABLE) {
+            if (ret == 0 && clientOpts.count == 1) {
+                print_reply(reply);
+            }
+            freeaddrinfo(clientInfo);
+            exit(ret == -1 ? 1 : 0);
         }
+        printf("[Client Program]: No shared memory server on this host, using TCP.\n");
     }
 
-    /* Loop through addrinfo structs to create a socket */
-    for (cursor = clientInfo; cursor != NULL; cursor = cursor -> ai_next) {
+    /* Benchmark mode: the benchmark opens its own connections */
+    if (!strcmp(clientOpts.mode, "bench")) {
+        ret = run_benchmark(&clientOpts, clientInfo);
+        freeaddrinfo(clientInfo);
+        exit(ret == -1 ? 1 : 0);
+    }
 
-        /* Create a client socket */
-        if ((clientSock = socket(cursor -> ai_family, cursor -> ai_socktype,
-                                 cursor -> ai_protocol)) == -1) {
-            perror("[Client Program]: socket");
-            continue;
+    /* TCP protocol races connections to the server addresses (connect.c) */
+    start = now_ns();
+    if (hints.ai_socktype == SOCK_STREAM) {
+        if ((clientSock = race_connect(clientInfo, clientOpts.attempt_delay, 
+                                       &cursor, &attempts)) == -1) {
+            perror("[Client Program]: connect");
+            cursor = NULL;
         }
+    }
 
-        /* TCP protocol also connects to the client socket */
-        if (hints.ai_socktype == SOCK_STREAM) {
-            if (connect(clientSock, cursor -> ai_addr, cursor -> ai_addrlen) == -1) {
-                close(clientSock);
-                perror("[Client Program]: connect");
+    /* UDP protocol loops through addrinfo structs to create a socket */
+    else {
+        for (cursor = clientInfo; cursor != NULL; cursor = cursor -> ai_next) {
+            if ((clientSock = socket(cursor -> ai_family, cursor -> ai_socktype,
+                                     cursor -> ai_protocol)) == -1) {
+                perror("[Client Program]: socket");
                 continue;
             }
+            break;
         }
-        break;
     }
 
     /* Exit if the socket failed to create or connect */
@@ -84,16 +103,36 @@ int main(int argc, char* argv[]) {
     /* TCP PROTOCOL SELECTED */
     if (hints.ai_socktype == SOCK_STREAM) {
 
-        /* Set the client socket to have a 3 second read timeout*/
+        /* Set the client socket to have a 3 second read timeout, and the
+           options of the '-o' profile (profile.c) */
         setsockopt(clientSock, SOL_SOCKET, SO_RCVTIMEO, (struct timeval *)&tv,
                    sizeof(struct timeval));
+        if (apply_profile(clientSock, clientOpts.profile, "[Client Program]:") == -1) {
+            freeaddrinfo(clientInfo); close(clientSock);
+            exit(1);
+        }
 
         /* Convert address from network byte order and print it */
-        inet_ntop(clientInfo -> ai_family,
-                  get_sock_ip((struct sockaddr*) clientInfo -> ai_addr),
+        inet_ntop(cursor -> ai_family,
+                  get_sock_ip((struct sockaddr*) cursor -> ai_addr),
                   addrStr, sizeof(addrStr));
         printf("------------------------------------------------------------------\n");
-        printf("[Client Program]: Connecting to %s:%s...\n", addrStr, clientOpts.port);
+        printf("[Client Program]: Connected to %s:%s in %.1f ms (%d connection "
+               "attempts)\n", addrStr, clientOpts.port, (now_ns() - start) / 1e6, attempts);
+
+        /* Bulk mode: send large payloads over this one connection */
+        if (!strcmp(clientOpts.mode, "bulk")) {
+            ret = run_bulk(clientSock, &clientOpts);
+            freeaddrinfo(clientInfo); close(clientSock);
+            exit(ret == -1 ? 1 : 0);
+        }
+
+        /* Several packets: pipeline them over this one connection */
+        if (clientOpts.count > 1) {
+            ret = pipeline_packets(clientSock, &clientOpts);
+            freeaddrinfo(clientInfo); close(clientSock);
+            exit(ret == -1 ? 1 : 0);
+        }
 
         /* Send a message packet to the server */
         if ((sendall(clientSock, buf, &numbytes)) == -1) { // sendall() avoids a partial send
@@ -102,7 +141,7 @@ int main(int argc, char* argv[]) {
             exit(1);
         }
         printf("\n[Client Program]: Sent <%d bytes> to server %s:%s via TCP.\n\n",
-                numbytes, inet_ntoa(clientOpts.ipv4_address), clientOpts.port);
+                numbytes, addrStr, clientOpts.port);
 
         /* Receieve a reply message from the server or timeout after 3 seconds*/
         printf("[Client Program]: Waiting for server reply...\n");
@@ -115,31 +154,41 @@ int main(int argc, char* argv[]) {
 
         /* Server reply receieved: print a success message */
         printf("[Client Program]: <%d bytes> receieved from the server\n", numbytes);
-        printf("[Client Program]: Reply message from the server: %d Success!\n\n", buf[0]);
+        print_reply(buf[0]);
     }
 
     /* UDP PROTOCOL SELECTED */
     if (hints.ai_socktype == SOCK_DGRAM) {
 
+        /* Reliable mode: send the payload in acknowledged segments (rudp.c) */
+        if (!strcmp(clientOpts.mode, "rudp")) {
+            ret = run_rudp(clientSock, cursor, &clientOpts);
+            freeaddrinfo(clientInfo); close(clientSock);
+            exit(ret == -1 ? 1 : 0);
+        }
+
         /* Set the client socket to have a 3 second read timeout*/
         setsockopt(clientSock, SOL_SOCKET, SO_RCVTIMEO, (struct timeval *)&tv,
                    sizeof(struct timeval));
 
         /* Send a message packet to the server */
         if ((numbytes = sendto(clientSock, buf, sizeof(struct packet), 0,
-                               clientInfo -> ai_addr, clientInfo -> ai_addrlen)) == -1) {
+                               cursor -> ai_addr, cursor -> ai_addrlen)) == -1) {
             perror("[Client Program]: sendto");
             freeaddrinfo(clientInfo); close(clientSock);
             exit(1);
         }
         printf("------------------------------------------------------------------\n");
+        inet_ntop(cursor -> ai_family,
+                  get_sock_ip((struct sockaddr*) cursor -> ai_addr),
+                  addrStr, sizeof(addrStr));
         printf("\n[Client Program]: Sent <%d bytes> to server %s:%s via UDP.\n\n",
-                numbytes, inet_ntoa(clientOpts.ipv4_address), clientOpts.port);
+                numbytes, addrStr, clientOpts.port);
 
         /* Receieve a reply message from the server or timeout after 3 seconds */
         printf("[Client Program]: Waiting for server reply...\n\n");
         if ((numbytes = recvfrom(clientSock, buf, sizeof(struct packet), 0,
-                                 clientInfo -> ai_addr, &addrLen)) == -1) {
+                                 (struct sockaddr*)&from, &addrLen)) == -1) {
             printf("[Client Program]: ERROR server reply not receieved.\n");
             perror("[Client Program]: recvfrom");
             freeaddrinfo(clientInfo); close(clientSock);
@@ -148,9 +197,129 @@ int main(int argc, char* argv[]) {
 
         /* Server reply receieved: print a success message */
         printf("[Client Program]: <%d bytes> receieved from the server\n", numbytes);
-        printf("[Client Program]: Reply message from the server: %d Success!\n\n", buf[0]);
+        print_reply(buf[0]);
         close(clientSock);
     }
 
     exit(0);
 }
+
+/*
+ *  pipeline_packets
+ *
+ *  Description:
+ *    Send 'count' packets of version '-v' (PROTO_PERSISTENT unless
+ *    selected) over one TCP connection, keeping up to 'depth' packets
+ *    in flight. Whenever the window has room, the packets it allows
+ *    are queued on a framer (framing.c), which sends every '-b' of 
+ *    them with one sendmsg(), and every reply that has arrived is 
+ *    collected with one recv(). A batch still filling is sent when
+ *    FRAME_MAX_DELAY_NS runs out while the client waits for replies,
+ *    or at once if no sent packet is left to free the window. The
+ *    server answers in order, so replies are matched by position.
+ *
+ *  Use:
+ *    Called by the client program when '-n' is greater than 1.
+ *    Prints the request rate and returns -1 on failure.
+ */
+static int pipeline_packets(int sock, struct cmdline* opts) {
+
+    struct packet pkt;
+    struct framer framer;
+    uint8_t replies[MAXDEPTH];
+    struct timeval start, end;
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    struct timespec ts;
+    uint64_t due;
+    uint32_t sent = 0, acked = 0, rejected = 0, burst, i;
+    int numbytes, batch, ready;
+    double elapsed;
+
+    /* Every message is the same, so every iovec points at one packet */
+    pkt.version = opts -> version;
+    pkt.number = htonl(opts -> data);
+    batch = opts -> batch > 0 ? opts -> batch : (int)opts -> depth;   // 0: one per window
+    framer_init(&framer, sock, batch, FRAME_MAX_DELAY_NS);
+
+    gettimeofday(&start, NULL);
+    while (acked < opts -> count) {
+
+        /* Fill the window; a batch with no packet sent ahead of it goes now */
+        burst = opts -> depth - (sent - acked);
+        if (burst > opts -> count - sent) {
+            burst = opts -> count - sent;
+        }
+        for (i = 0; i < burst; i++) {
+            if (framer_add(&framer, &pkt, sizeof(pkt)) == -1) {
+                return -1;
+            }
+        }
+        sent += burst;
+        if (framer.count == (int)(sent - acked) && framer_flush(&framer) == -1) {
+            return -1;
+        }
+
+        /* Wait for replies; the rest of the batch is sent once its delay is up */
+        while (framer.count > 0) {
+            due = framer_due(&framer);
+            ts.tv_sec = due / 1000000000;
+            ts.tv_nsec = due % 1000000000;
+            if ((ready = ppoll(&pfd, 1, &ts, NULL)) > 0) {
+                break;
+            }
+            if (ready == -1 && errno != EINTR) {
+                perror("[Client Program]: ppoll");
+                return -1;
+            }
+            if (ready == 0 && framer_flush(&framer) == -1) {
+                return -1;
+            }
+        }
+
+        /* Receieve the replies that have arrived, or timeout after 3 seconds */
+        if ((numbytes = recv(sock, replies, sent - acked, 0)) <= 0) {
+            printf("[Client Program]: ERROR server reply not receieved.\n");
+            if (numbytes == -1) perror("[Client Program]: recv");
+            return -1;
+        }
+        for (i = 0; i < (uint32_t)numbytes; i++) {
+            if (replies[i] == REPLY_REJECTED) {
+                rejected++;   // Shed by the server's admission control
+            }
+            else if (replies[i] != 1) {
+                printf("[Client Program]: ERROR unexpected reply: %d\n", replies[i]);
+                return -1;
+            }
+        }
+        acked += numbytes;
+    }
+    gettimeofday(&end, NULL);
+
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    printf("[Client Program]: %u replies receieved on one connection (depth %u, batch %d) "
+           "in %.3f s: %.0f requests/s\n", acked, opts -> depth, framer.batch, elapsed, 
+           elapsed > 0 ? acked / elapsed : 0);
+    if (rejected > 0) {
+        printf("[Client Program]: %u requests rejected by the server\n", rejected);
+    }
+    printf("[Client Program]: %lu sendmsg() calls, %.1f packets each\n\n", 
+           framer.flushes, framer.flushes ? (double)framer.records / framer.flushes : 0.0);
+    return 0;
+}
+
+/*
+ *  print_reply
+ *
+ *  Description:
+ *    Print the server's one byte reply: 1 is a success, REPLY_REJECTED
+ *    means the server was over a limit and did not serve the request.
+ */
+static void print_reply(uint8_t reply) {
+    if (reply == REPLY_REJECTED) {
+        printf("[Client Program]: Reply message from the server: %d Rejected, the server "
+               "is over its limits.\n\n", reply);
+    }
+    else {
+        printf("[Client Program]: Reply message from the server: %d Success!\n\n", reply);
+    }
+}
@@ -0,0 +1,282 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  COMPUTE THREADS used by the server program
+ *
+ *  With '-j <number>' the event loop (event_loop.c) stops running
+ *  expensive handlers (handlers.c) on its own thread. It pushes each
+ *  such request onto a queue shared by '-j' compute threads and goes
+ *  back to its sockets. A compute thread runs the handler and pushes
+ *  the finished job onto the completion queue of the loop that sent
+ *  it, then wakes that loop through its eventfd.
+ *
+ *  Both queues are bounded, lock-free rings (struct job_queue): any
+ *  number of threads push and pop with one compare-and-swap each and
+ *  never block one another. A compute thread with nothing to do
+ *  sleeps on a semaphore that counts queued jobs.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static void* compute_routine(void* arg);
+static void return_job(struct job* job);
+
+/*
+ *  job_queue_init
+ *
+ *  Description:
+ *    Allocate a ring of 'size' cells, a power of two. Each cell's
+ *    sequence number says whose turn it is: a cell at position 'pos'
+ *    may be filled while its sequence is 'pos', and emptied once it
+ *    is 'pos + 1'. Returns -1 on failure.
+ */
+int job_queue_init(struct job_queue* q, size_t size) {
+
+    size_t i;
+
+    if ((q -> cells = calloc(size, sizeof(struct job_cell))) == NULL) {
+        return -1;
+    }
+    for (i = 0; i < size; i++) {
+        atomic_init(&q -> cells[i].seq, i);
+    }
+    q -> mask = size - 1;
+    atomic_init(&q -> head, 0);
+    atomic_init(&q -> tail, 0);
+    return 0;
+}
+
+/*
+ *  job_queue_free
+ *
+ *  Description:
+ *    Release a ring. No thread may be using it.
+ */
+void job_queue_free(struct job_queue* q) {
+    free(q -> cells);
+    q -> cells = NULL;
+}
+
+/*
+ *  job_queue_push
+ *
+ *  Description:
+ *    Claim the cell at 'tail' with a compare-and-swap, copy the job
+ *    in, then publish it by advancing the cell's sequence. Returns
+ *    false if the ring is full.
+ *
+ *  SOURCE: Dmitry Vyukov, "Bounded MPMC queue" (1024cores.net)
+ */
+bool job_queue_push(struct job_queue* q, const struct job* job) {
+
+    struct job_cell* cell;
+    size_t pos = atomic_load_explicit(&q -> tail, memory_order_relaxed), seq;
+    intptr_t diff;
+
+    while (1) {
+        cell = &q -> cells[pos & q -> mask];
+        seq = atomic_load_explicit(&cell -> seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q -> tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false;   // The cell still holds the job from one lap ago
+        }
+        else {
+            pos = atomic_load_explicit(&q -> tail, memory_order_relaxed);
+        }
+    }
+    cell -> job = *job;
+    atomic_store_explicit(&cell -> seq, pos + 1, memory_order_release);
+    return true;
+}
+
+/*
+ *  job_queue_pop
+ *
+ *  Description:
+ *    Claim the cell at 'head' once its job is published, copy the
+ *    job out, then hand the cell to the push one lap later. Returns
+ *    false if the ring is empty.
+ */
+bool job_queue_pop(struct job_queue* q, struct job* job) {
+
+    struct job_cell* cell;
+    size_t pos = atomic_load_explicit(&q -> head, memory_order_relaxed), seq;
+    intptr_t diff;
+
+    while (1) {
+        cell = &q -> cells[pos & q -> mask];
+        seq = atomic_load_explicit(&cell -> seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q -> head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false;   // Nothing published at this position yet
+        }
+        else {
+            pos = atomic_load_explicit(&q -> head, memory_order_relaxed);
+        }
+    }
+    *job = cell -> job;
+    atomic_store_explicit(&cell -> seq, pos + q -> mask + 1, memory_order_release);
+    return true;
+}
+
+/*
+ *  start_compute
+ *
+ *  Description:
+ *    Create the job queue and start 'size' compute threads.
+ *
+ *  Use:
+ *    Called by the server program in '-m epoll' or '-w' mode when
+ *    '-j <number>' is given. Returns NULL on failure.
+ */
+struct compute* start_compute(int size) {
+
+    struct compute* compute;
+    int i, err;
+
+    if ((compute = calloc(1, sizeof(struct compute))) == NULL ||
+        (compute -> threads = calloc(size, sizeof(pthread_t))) == NULL ||
+        job_queue_init(&compute -> queue, JOB_QUEUESIZE) == -1) {
+        perror("[Server Program]: calloc");
+        return NULL;
+    }
+    sem_init(&compute -> items, 0, 0);
+    for (i = 0; i < size; i++) {
+        if ((err = pthread_create(&compute -> threads[i], NULL, compute_routine,
+                                  compute)) != 0) {
+            errno = err;
+            perror("[Server Program]: pthread_create");
+            break;
+        }
+        compute -> size++;
+    }
+    if (compute -> size == 0) {
+        stop_compute(compute);
+        return NULL;
+    }
+    return compute;
+}
+
+/*
+ *  submit_job
+ *
+ *  Description:
+ *    Queue a job for the compute threads and wake one of them.
+ *    Returns -1 if the queue is full; the caller then runs the
+ *    handler itself.
+ */
+int submit_job(struct compute* compute, const struct job* job) {
+
+    if (!job_queue_push(&compute -> queue, job)) {
+        return -1;
+    }
+    sem_post(&compute -> items);
+    return 0;
+}
+
+/*
+ *  stop_compute
+ *
+ *  Description:
+ *    Queue one stop job (a job without a loop) per thread behind the
+ *    jobs already queued, so every job is finished, then wait for the
+ *    threads and free the pool.
+ *
+ *  Use:
+ *    Called after the event loops have returned. Their completion
+ *    queues must stay allocated until this returns (see
+ *    detach_compute() in event_loop.c).
+ */
+void stop_compute(struct compute* compute) {
+
+    struct job stop;
+    int i, err;
+
+    memset(&stop, 0, sizeof(stop));
+    for (i = 0; i < compute -> size; i++) {
+        while (submit_job(compute, &stop) == -1) {
+            sched_yield();
+        }
+    }
+    for (i = 0; i < compute -> size; i++) {
+        if ((err = pthread_join(compute -> threads[i], NULL)) != 0) {
+            errno = err;
+            perror("[Server Program]: pthread_join");
+        }
+    }
+    sem_destroy(&compute -> items);
+    job_queue_free(&compute -> queue);
+    free(compute -> threads);
+    free(compute);
+}
+
+/*
+ *  compute_routine
+ *
+ *  Description:
+ *    Thread routine of one compute thread: sleep until a job is
+ *    queued, run its handler, and return it to its event loop. The
+ *    job's queue time runs from the read that brought its packet.
+ */
+static void* compute_routine(void* arg) {
+
+    struct compute* compute = arg;
+    struct job job;
+    uint64_t start;
+
+    while (1) {
+        if (sem_wait(&compute -> items) == -1) {
+            continue;   // EINTR
+        }
+        /* Every post follows a push, but a job pushed earlier may not be
+           published yet and it blocks the head of the ring: wait for it */
+        while (!job_queue_pop(&compute -> queue, &job)) {
+            sched_yield();
+        }
+        if (job.loop == NULL) {
+            return NULL;
+        }
+        start = now_ns();
+        metric_time(MT_QUEUE, start > job.queued_at ? start - job.queued_at : 0);
+        job.reply = job.fn(job.number);
+        metric_time(MT_SERVICE, now_ns() - start);
+        return_job(&job);
+    }
+}
+
+/*
+ *  return_job
+ *
+ *  Description:
+ *    Push a finished job onto its loop's completion queue and wake
+ *    the loop. 'notified' is set until the loop starts draining, so
+ *    a burst of completions costs one eventfd write. The queue holds
+ *    every job the loop may have out (offload_packet() in
+ *    event_loop.c), so the push never waits for the loop, which may
+ *    have stopped draining during a shutdown.
+ */
+static void return_job(struct job* job) {
+
+    struct evloop* loop = job -> loop;
+
+    job_queue_push(&loop -> done, job);
+    if (!atomic_exchange(&loop -> notified, true) && eventfd_write(loop -> donefd, 1) == -1) {
+        perror("[Server Program]: eventfd_write");
+    }
+}
@@ -0,0 +1,233 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  CONNECTION ESTABLISHMENT used by the client program
+ *
+ *  '-s' takes one or more comma separated hostnames or IPv4/IPv6
+ *  addresses. Every one of them is resolved and the addresses are
+ *  ordered so the two families take turns (RFC 8305, section 4).
+ *
+ *  Instead of one blocking connect() per address, where an address
+ *  that does not answer costs a whole TCP timeout before the next one
+ *  is tried, race_connect() starts a non-blocking connect() to the
+ *  first address and another one every '-a' milliseconds while none
+ *  has finished ("Happy Eyeballs", RFC 8305). The first handshake to
+ *  complete wins and the other attempts are closed. An attempt that
+ *  fails starts the next one at once.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static int start_attempt(struct addrinfo* ai);
+static struct addrinfo* interleave_families(struct addrinfo* list);
+
+/*
+ *  resolve_hosts
+ *
+ *  Description:
+ *    Resolve every host of the comma separated list 'hosts' and join
+ *    the addrinfo lists into one, with the address families
+ *    interleaved. A host that does not resolve is reported and
+ *    skipped. Returns 0, or the getaddrinfo() error of the last host
+ *    if none of them resolved.
+ *
+ *  Use:
+ *    Called by the client program instead of getaddrinfo(). Every
+ *    error is already printed here, so the caller only exits. The
+ *    list is released with freeaddrinfo().
+ */
+int resolve_hosts(char* hosts, char* port, struct addrinfo* hints, struct addrinfo** res) {
+
+    struct addrinfo *list = NULL, **tail = &list, *found;
+    char *copy, *host, *save = NULL;
+    int ret = EAI_NONAME;
+
+    if ((copy = strdup(hosts)) == NULL) {
+        perror("[Client Program]: strdup");
+        return EAI_MEMORY;
+    }
+    for (host = strtok_r(copy, ",", &save); host != NULL; host = strtok_r(NULL, ",", &save)) {
+        if ((ret = getaddrinfo(host, port, hints, &found)) != 0) {
+            fprintf(stderr, "[Client Program]: getaddrinfo: %s: %s\n", host, gai_strerror(ret));
+            continue;
+        }
+        *tail = found;
+        while (*tail != NULL) {
+            tail = &(*tail) -> ai_next;
+        }
+    }
+    free(copy);
+
+    if (list == NULL) {
+        return ret == 0 ? EAI_NONAME : ret;
+    }
+    *res = interleave_families(list);
+    return 0;
+}
+
+/*
+ *  interleave_families
+ *
+ *  Description:
+ *    Relink the list so an address of the first address's family is
+ *    followed by one of the other family, and so on. The order within
+ *    each family is kept. Returns the new head of the list.
+ */
+static struct addrinfo* interleave_families(struct addrinfo* list) {
+
+    struct addrinfo *first = NULL, *other = NULL, **firstTail = &first, **otherTail = &other;
+    struct addrinfo *head = NULL, **tail = &head, *next;
+    int family = list -> ai_family;
+    bool turn = true;
+
+    /* Split the list by family */
+    for (; list != NULL; list = next) {
+        next = list -> ai_next;
+        list -> ai_next = NULL;
+        if (list -> ai_family == family) {
+            *firstTail = list;
+            firstTail = &list -> ai_next;
+        }
+        else {
+            *otherTail = list;
+            otherTail = &list -> ai_next;
+        }
+    }
+
+    /* Take one from each family in turn until both run out */
+    while (first != NULL || other != NULL) {
+        struct addrinfo** from = (turn && first != NULL) || other == NULL ? &first : &other;
+        *tail = *from;
+        *from = (*from) -> ai_next;
+        tail = &(*tail) -> ai_next;
+        *tail = NULL;
+        turn = !turn;
+    }
+    return head;
+}
+
+/*
+ *  race_connect
+ *
+ *  Description:
+ *    Connect a TCP socket to the first address of 'list' that
+ *    completes a handshake. A new attempt starts every 'delay_ms'
+ *    milliseconds while the earlier ones are still pending, and at
+ *    once when one fails. A 'delay_ms' of 0 waits for each attempt to
+ *    fail before the next starts (one connect() at a time). At most
+ *    MAXATTEMPTS attempts are pending at once.
+ *
+ *  Use:
+ *    Called by the client program and the benchmark. Returns the
+ *    connected socket in blocking mode and sets 'winner' to its
+ *    address and 'attempts' to the number of attempts started, or
+ *    returns -1 with errno from the last failed attempt.
+ */
+int race_connect(struct addrinfo* list, uint32_t delay_ms, struct addrinfo** winner,
+                 int* attempts) {
+
+    struct pollfd fds[MAXATTEMPTS];
+    struct addrinfo *pending[MAXATTEMPTS], *next = list;
+    uint64_t now, deadline = 0;
+    int i, fd, flags, err, npending = 0, won = -1, timeout, lasterr = ECONNREFUSED;
+    socklen_t errlen;
+
+    *attempts = 0;
+    while (won == -1 && (next != NULL || npending > 0)) {
+
+        /* Start the next attempt if none is pending or the delay has passed */
+        now = now_ns();
+        if (next != NULL && npending < MAXATTEMPTS &&
+            (npending == 0 || (delay_ms > 0 && now >= deadline))) {
+            (*attempts)++;
+            if ((fd = start_attempt(next)) == -1) {
+                lasterr = errno;   // Failed at once: try the next address now
+                next = next -> ai_next;
+                continue;
+            }
+            fds[npending].fd = fd;
+            fds[npending].events = POLLOUT;
+            pending[npending++] = next;
+            next = next -> ai_next;
+            deadline = now + delay_ms * 1000000ULL;
+            continue;
+        }
+
+        /* Wait for a handshake to finish, or until the next attempt is due */
+        timeout = -1;
+        if (next != NULL && npending < MAXATTEMPTS && delay_ms > 0) {
+            timeout = (deadline - now + 999999) / 1000000;
+        }
+        if (poll(fds, npending, timeout) == -1) {
+            if (errno == EINTR) continue;
+            lasterr = errno;
+            break;
+        }
+
+        /* A writable socket has finished its handshake: check how it went */
+        for (i = 0; i < npending; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            errlen = sizeof(err);
+            if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == -1) {
+                err = errno;
+            }
+            if (err == 0) {
+                won = i;
+                break;
+            }
+            lasterr = err;
+            close(fds[i].fd);
+            fds[i] = fds[--npending];
+            pending[i] = pending[npending];
+            i--;
+            deadline = now;   // Start the next attempt at once
+        }
+    }
+
+    /* Keep the winner, give up on the others */
+    for (i = 0; i < npending; i++) {
+        if (i != won) {
+            close(fds[i].fd);
+        }
+    }
+    if (won == -1) {
+        errno = lasterr;   // Every address failed
+        return -1;
+    }
+    fd = fds[won].fd;
+    *winner = pending[won];
+    if ((flags = fcntl(fd, F_GETFL, 0)) == -1 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ *  start_attempt
+ *
+ *  Description:
+ *    Create a non-blocking socket for 'ai' and start connecting it.
+ *    Returns the socket while the handshake is in progress (or done),
+ *    or -1 if the attempt failed at once.
+ */
+static int start_attempt(struct addrinfo* ai) {
+
+    int fd, saved;
+
+    if ((fd = socket(ai -> ai_family, ai -> ai_socktype | SOCK_NONBLOCK,
+                     ai -> ai_protocol)) == -1) {
+        return -1;
+    }
+    if (connect(fd, ai -> ai_addr, ai -> ai_addrlen) == -1 && errno != EINPROGRESS) {
+        saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
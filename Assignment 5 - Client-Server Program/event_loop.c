@@ -0,0 +1,906 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  EVENT LOOP used by the server program
+ *
+ *  A single thread waits on one edge-triggered epoll instance
+ *  that watches the listening socket, the UDP socket and every 
+ *  client connection. Sockets are non-blocking, so no client can 
+ *  stall the others, and no process is forked to answer a request.
+ *  Worker threads (workers.c) each run their own copy of this loop.
+ *  Expensive requests can be handed to compute threads (compute.c),
+ *  whose replies come back through a per-loop eventfd.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static int watch_socket(struct evloop* loop, int fd, int* tag);
+static void accept_connections(struct evloop* loop);
+static void read_datagrams(struct evloop* loop);
+static bool serve_datagram(struct evloop* loop, char* dgram, ssize_t numbytes,
+                           struct sockaddr_storage* from, socklen_t fromlen);
+static void request_shutdown(struct evloop* loop);
+static struct connection* open_connection(struct evloop* loop, int fd);
+static void close_connection(struct evloop* loop, struct connection* conn);
+static int read_connection(struct evloop* loop, struct connection* conn);
+static int flush_connection(struct evloop* loop, struct connection* conn);
+static void process_packets(struct evloop* loop, struct connection* conn);
+static uint64_t time_handlers(struct connection* conn, uint64_t start, uint32_t count);
+static void serve_connection(struct evloop* loop, struct connection* conn);
+static void complete_jobs(struct evloop* loop);
+static int offload_packet(struct evloop* loop, struct connection* conn, uint32_t seq,
+                          handler_fn fn, uint32_t number);
+static void emit_replies(struct connection* conn);
+static bool window_full(struct connection* conn);
+
+/*
+ *  serve_event_loop
+ *
+ *  Description:
+ *    Run a single event loop on the server's one TCP or UDP socket
+ *    and print its statistics when the server shuts down. With '-j'
+ *    the loop shares its expensive requests with compute threads.
+ *
+ *  Use:
+ *    Called by the server program in '-m epoll' mode. Pass -1 for
+ *    the protocol that is not being served.
+ */
+void serve_event_loop(int listenSock, int udpSock, struct cmdline* opts) {
+
+    struct evloop loop;
+    struct compute* compute = NULL;
+    atomic_bool shutdown = false;
+
+    memset(&loop, 0, sizeof(loop));
+    loop.listenSock = listenSock;
+    loop.udpSock = udpSock;
+    loop.shutdown = &shutdown;
+    loop.opts = opts;
+    if ((loop.wakefd = eventfd(0, EFD_NONBLOCK)) == -1) {
+        perror("[Server Program]: eventfd");
+        return;
+    }
+    if (opts -> compute > 0 && ((compute = start_compute(opts -> compute)) == NULL ||
+                                attach_compute(&loop, compute) == -1)) {
+        return;
+    }
+    printf("------------------------------------------------------------------\n");
+    printf("[Server Program]: Waiting for connections (epoll)...\n");
+
+    event_loop(&loop);
+    if (compute != NULL) {
+        stop_compute(compute);
+        detach_compute(&loop);
+    }
+    print_loop_stats(&loop);
+    close(loop.wakefd);
+}
+
+/*
+ *  attach_compute
+ *
+ *  Description:
+ *    Let a loop hand expensive requests to 'compute': create the 
+ *    loop's completion queue and the eventfd that signals it.
+ *
+ *  Use:
+ *    Called before event_loop(). Returns -1 on failure.
+ */
+int attach_compute(struct evloop* loop, struct compute* compute) {
+
+    if (job_queue_init(&loop -> done, JOB_QUEUESIZE) == -1) {
+        perror("[Server Program]: calloc");
+        return -1;
+    }
+    if ((loop -> donefd = eventfd(0, EFD_NONBLOCK)) == -1) {
+        perror("[Server Program]: eventfd");
+        job_queue_free(&loop -> done);
+        return -1;
+    }
+    atomic_init(&loop -> notified, false);
+    loop -> compute = compute;
+    return 0;
+}
+
+/*
+ *  detach_compute
+ *
+ *  Description:
+ *    Free the connections whose last jobs came back after the loop 
+ *    stopped, then the completion queue and its eventfd.
+ *
+ *  Use:
+ *    Called after event_loop() has returned and stop_compute() has
+ *    finished every job.
+ */
+void detach_compute(struct evloop* loop) {
+
+    struct job job;
+
+    while (job_queue_pop(&loop -> done, &job)) {
+        loop -> jobs_out--;
+        if (--job.conn -> jobs == 0) {
+            free(job.conn);   // Closed by the loop while the job was out
+        }
+    }
+    job_queue_free(&loop -> done);
+    close(loop -> donefd);
+    loop -> compute = NULL;
+}
+
+/*
+ *  event_loop
+ *
+ *  Description:
+ *    Registers the loop's sockets with epoll, then waits for events
+ *    until any loop receives the termination number 0. Readable 
+ *    connections are drained until EAGAIN, complete packets are 
+ *    answered, and replies that could not be sent right away are 
+ *    flushed when the socket becomes writable.
+ *
+ *  Use:
+ *    Called with a loop whose sockets are bound (and listening, for
+ *    TCP). Returns after all connections are closed; the caller 
+ *    closes the loop's sockets.
+ */
+void event_loop(struct evloop* loop) {
+
+    struct epoll_event events[MAXEVENTS];
+    struct connection* conn;
+    void* tag;
+    int i, n, on = 1;
+
+    /* Create the epoll instance and watch the loop's sockets */
+    if ((loop -> epfd = epoll_create1(0)) == -1) {
+        perror("[Server Program]: epoll_create1");
+        return;
+    }
+
+    /* Take offloaded runs of segments whole (Linux 5.0 and later; without
+       it they arrive one datagram at a time). Batches are too small. */
+    if (loop -> udpSock != -1 && loop -> opts -> batch <= 1) {
+        setsockopt(loop -> udpSock, SOL_UDP, UDP_GRO, &on, sizeof(on));
+    }
+    if ((loop -> listenSock != -1 && watch_socket(loop, loop -> listenSock, 
+                                                  &loop -> listenSock) == -1) ||
+        (loop -> udpSock != -1 && watch_socket(loop, loop -> udpSock, 
+                                               &loop -> udpSock) == -1) ||
+        (loop -> compute != NULL && watch_socket(loop, loop -> donefd, 
+                                                 &loop -> donefd) == -1) ||
+        watch_socket(loop, loop -> wakefd, &loop -> wakefd) == -1) {
+        close(loop -> epfd);
+        return;
+    }
+
+    /* Server event loop */
+    while (!atomic_load(loop -> shutdown)) {
+
+        if ((n = epoll_wait(loop -> epfd, events, MAXEVENTS, -1)) == -1) {
+            if (errno == EINTR) continue;
+            perror("[Server Program]: epoll_wait");
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            tag = events[i].data.ptr;
+
+            /* New connections are waiting on the listening socket */
+            if (tag == &loop -> listenSock) {
+                accept_connections(loop);
+                continue;
+            }
+            /* Datagrams are waiting on the UDP socket */
+            if (tag == &loop -> udpSock) {
+                read_datagrams(loop);
+                continue;
+            }
+            /* Another loop requested a shutdown */
+            if (tag == &loop -> wakefd) {
+                continue;
+            }
+            /* Compute threads returned finished jobs */
+            if (tag == &loop -> donefd) {
+                complete_jobs(loop);
+                continue;
+            }
+            conn = tag;
+
+            /* Hang up or error: drop the connection */
+            if (events[i].events & EPOLLERR) {
+                close_connection(loop, conn);
+                continue;
+            }
+
+            /* Flush pending replies first so reading has room to continue */
+            if ((events[i].events & EPOLLOUT) && flush_connection(loop, conn) == -1) {
+                close_connection(loop, conn);
+                continue;
+            }
+            serve_connection(loop, conn);
+        }
+    }
+
+    /* Termination signal receieved: close every remaining connection */
+    while (loop -> conns != NULL) {
+        flush_connection(loop, loop -> conns);
+        close_connection(loop, loop -> conns);
+    }
+    rudp_receiver_free(loop -> rudp);
+    loop -> rudp = NULL;
+    close(loop -> epfd);
+}
+
+/*
+ *  print_loop_stats
+ *
+ *  Description:
+ *    Print the counters kept by one event loop.
+ */
+void print_loop_stats(struct evloop* loop) {
+    printf("[Server Program]: worker %d: %lu accepts, %lu TCP requests, "
+           "%lu UDP requests, %lu bytes in, %lu bytes out, %lu UDP syscalls\n",
+           loop -> id, loop -> stats.accepts, loop -> stats.tcp_requests,
+           loop -> stats.udp_requests, loop -> stats.bytes_in, 
+           loop -> stats.bytes_out, loop -> stats.syscalls);
+    if (loop -> opts -> compute > 0) {
+        printf("[Server Program]: worker %d: %lu requests run on compute threads\n",
+               loop -> id, loop -> stats.offloaded);
+    }
+}
+
+/*
+ *  serve_connection
+ *
+ *  Description:
+ *    Alternate reads and flushes until the socket is drained, or 
+ *    until replies back up (unsent, or waiting on compute threads),
+ *    then close the connection if it failed or is finished.
+ */
+static void serve_connection(struct evloop* loop, struct connection* conn) {
+
+    int ret;
+
+    do {
+        if ((ret = read_connection(loop, conn)) != -1 && 
+            flush_connection(loop, conn) == -1) {
+            ret = -1;
+        }
+    } while (ret == 1 && conn -> outlen == 0 && !window_full(conn));
+    if (ret == -1) {
+        close_connection(loop, conn);
+        return;
+    }
+    if (conn -> close_after_write && conn -> outlen == 0 && 
+        conn -> seq_head == conn -> seq_tail) {
+        close_connection(loop, conn);
+    }
+}
+
+/*
+ *  complete_jobs
+ *
+ *  Description:
+ *    Take every finished job off the loop's completion queue and
+ *    store its reply. Each connection that got replies is then 
+ *    served once: its replies are flushed, and reading resumes if it
+ *    had stopped because too many replies were outstanding.
+ *
+ *    The eventfd is read before 'notified' is cleared, and the queue
+ *    is drained after: a job returned at any point either is drained
+ *    now or writes the eventfd again.
+ */
+static void complete_jobs(struct evloop* loop) {
+
+    struct connection *touched = NULL, *conn;
+    struct job job;
+    eventfd_t count;
+
+    eventfd_read(loop -> donefd, &count);
+    atomic_store(&loop -> notified, false);
+
+    while (job_queue_pop(&loop -> done, &job)) {
+        loop -> jobs_out--;
+        conn = job.conn;
+        conn -> jobs--;
+        if (conn -> fd == -1) {
+            if (conn -> jobs == 0) {
+                free(conn);   // Closed while the job was out
+            }
+            continue;
+        }
+        conn -> ready[job.seq % CONN_BUFSIZE] = REPLY_READY | job.reply;
+        if (!conn -> touched) {
+            conn -> touched = true;
+            conn -> touched_next = touched;
+            touched = conn;
+        }
+    }
+
+    while ((conn = touched) != NULL) {
+        touched = conn -> touched_next;
+        conn -> touched = false;
+        emit_replies(conn);
+        if (flush_connection(loop, conn) == -1) {
+            close_connection(loop, conn);
+            continue;
+        }
+        serve_connection(loop, conn);
+    }
+}
+
+/*
+ *  watch_socket
+ *
+ *  Description:
+ *    Make one of the loop's own sockets non-blocking and register it
+ *    with epoll. 'tag' is stored as the event data so events on this
+ *    socket can be told apart from connection events.
+ */
+static int watch_socket(struct evloop* loop, int fd, int* tag) {
+
+    struct epoll_event ev;
+
+    if (set_nonblocking(fd) == -1) {
+        perror("[Server Program]: fcntl");
+        return -1;
+    }
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = tag;
+    if (epoll_ctl(loop -> epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("[Server Program]: epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *  request_shutdown
+ *
+ *  Description:
+ *    Set the shared shutdown flag and wake every loop that is blocked
+ *    in epoll_wait(). The eventfd is never read, so it stays readable
+ *    and each loop sees it.
+ */
+static void request_shutdown(struct evloop* loop) {
+
+    uint64_t one = 1;
+
+    printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
+    printf("[Server Program]: Server shutting down.\n");
+    atomic_store(loop -> shutdown, true);
+    if (write(loop -> wakefd, &one, sizeof(one)) == -1) {
+        perror("[Server Program]: write");
+    }
+}
+
+/*
+ *  accept_connections
+ *
+ *  Description:
+ *    The listening socket is edge-triggered, so accept() is called
+ *    until it returns EAGAIN. Each client socket is made non-blocking
+ *    and registered for both reads and writes, unless the server
+ *    already serves '-c' connections: then it is rejected at once.
+ */
+static void accept_connections(struct evloop* loop) {
+
+    struct sockaddr_storage from;
+    struct connection* conn;
+    socklen_t fromLen;
+    int fd;
+
+    while (1) {
+        fromLen = sizeof(from);
+        if ((fd = accept(loop -> listenSock, (struct sockaddr*)&from, &fromLen)) == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[Server Program]: accept");
+                metric_add(MC_ERRORS, 1);
+            }
+            return;
+        }
+        loop -> stats.accepts++;
+        metric_add(MC_ACCEPTS, 1);
+        if (!admit_connection()) {
+            reject_connection(fd);
+            continue;
+        }
+        if (set_nonblocking(fd) == -1 || (conn = open_connection(loop, fd)) == NULL) {
+            release_connection();
+            close(fd);
+            metric_add(MC_ERRORS, 1);
+            continue;
+        }
+        conn -> client = client_key(&from);
+    }
+}
+
+/*
+ *  open_connection
+ *
+ *  Description:
+ *    Allocate the state for a new client connection, add it to the
+ *    front of the loop's connection list, and register it with epoll.
+ *    Returns NULL on failure.
+ */
+static struct connection* open_connection(struct evloop* loop, int fd) {
+
+    struct connection* conn;
+    struct epoll_event ev;
+
+    if ((conn = malloc(sizeof(struct connection))) == NULL) {
+        perror("[Server Program]: malloc");
+        return NULL;
+    }
+    conn -> fd = fd;
+    conn -> inlen = 0;
+    conn -> outlen = 0;
+    conn -> seq_head = 0;
+    conn -> seq_tail = 0;
+    conn -> jobs = 0;
+    conn -> close_after_write = false;
+    conn -> touched = false;
+
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = conn;
+    if (epoll_ctl(loop -> epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("[Server Program]: epoll_ctl");
+        free(conn);
+        return NULL;
+    }
+
+    conn -> prev = NULL;
+    conn -> next = loop -> conns;
+    if (loop -> conns != NULL) {
+        loop -> conns -> prev = conn;
+    }
+    loop -> conns = conn;
+    return conn;
+}
+
+/*
+ *  close_connection
+ *
+ *  Description:
+ *    Unlink a connection from the loop's connection list, close its
+ *    socket (which also removes it from epoll), and free it. While
+ *    jobs of the connection are out on compute threads, the memory
+ *    is kept for them and freed when the last one returns.
+ */
+static void close_connection(struct evloop* loop, struct connection* conn) {
+
+    if (conn -> prev != NULL) {
+        conn -> prev -> next = conn -> next;
+    }
+    else {
+        loop -> conns = conn -> next;
+    }
+    if (conn -> next != NULL) {
+        conn -> next -> prev = conn -> prev;
+    }
+    close(conn -> fd);
+    conn -> fd = -1;
+    metric_add(MC_CLOSES, 1);
+    release_connection();
+    if (conn -> jobs == 0) {
+        free(conn);
+    }
+}
+
+/*
+ *  read_connection
+ *
+ *  Description:
+ *    Read from a connection until recv() returns EAGAIN, answering 
+ *    every complete packet along the way. A packet split across 
+ *    several TCP segments stays in 'inbuf' until the rest of it 
+ *    arrives.
+ *
+ *    Returns 0 when the socket is drained or the client is done 
+ *    sending, 1 when reading stopped because 'outbuf' is full of 
+ *    unsent or outstanding replies, and -1 when the connection failed.
+ */
+static int read_connection(struct evloop* loop, struct connection* conn) {
+
+    ssize_t numbytes;
+
+    while (!conn -> close_after_write) {
+
+        /* Answer buffered packets; stop if the replies are backed up */
+        process_packets(loop, conn);
+        if (window_full(conn)) return 1;
+        if (conn -> close_after_write) return 0;
+
+        numbytes = recv(conn -> fd, conn -> inbuf + conn -> inlen,
+                        CONN_BUFSIZE - conn -> inlen, 0);
+        if (numbytes == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            metric_add(MC_ERRORS, 1);
+            return -1;
+        }
+        if (numbytes == 0) {
+            conn -> close_after_write = true;   // Client is done sending
+            return 0;
+        }
+        conn -> inlen += numbytes;
+        conn -> read_at = now_ns();
+        if (conn -> inlen % sizeof(struct packet) != 0) {
+            rearm_quickack(conn -> fd, loop -> opts -> profile);   // Part of a packet
+        }
+        loop -> stats.bytes_in += numbytes;
+        metric_add(MC_BYTES_IN, numbytes);
+    }
+    return 0;
+}
+
+/*
+ *  process_packets
+ *
+ *  Description:
+ *    Unpack every complete packet at the front of the input buffer
+ *    and queue a one byte reply for each, in the order the packets
+ *    arrived. The packet version selects the handler (handlers.c) 
+ *    and the framing: a PROTO_SINGLE connection is closed once its 
+ *    reply has been sent, and the other versions stay open for the
+ *    next packet. A version without a handler, or PROTO_BULK, is a
+ *    framing error and closes the connection.
+ *
+ *    With compute threads, a packet whose handler is expensive is
+ *    queued for them and its reply is filled in by complete_jobs().
+ *    If their queue is full the handler runs here instead.
+ *
+ *    A cheap handler runs in less time than it takes to read the
+ *    clock, so the handlers run here are timed as a group: the clock
+ *    is read after each expensive one and once at the end.
+ */
+static void process_packets(struct evloop* loop, struct connection* conn) {
+
+    const struct handler* handler;
+    struct packet pkt;
+    size_t offset = 0;
+    uint32_t seq, requests = 0, untimed = 0;
+    uint64_t start = 0;
+
+    while (conn -> inlen - offset >= sizeof(struct packet) && !window_full(conn)) {
+
+        /* Convert the packet to host byte order and unpack the message */
+        memcpy(&pkt, conn -> inbuf + offset, sizeof(struct packet));
+        offset += sizeof(struct packet);
+        if ((handler = find_handler(pkt.version)) == NULL) {
+            fprintf(stderr, "[Server Program]: Unknown packet version %u on connection %d\n",
+                    pkt.version, conn -> fd);
+            metric_add(MC_ERRORS, 1);
+            conn -> close_after_write = true;
+            offset = conn -> inlen;
+            break;
+        }
+        uint32_t data_receieved = ntohl(pkt.number);
+        if (!loop -> opts -> quiet) {
+            printf("[Server Program]: <%zu bytes> receieved on connection %d, number: %u\n",
+                   sizeof(struct packet), conn -> fd, data_receieved);
+        }
+        loop -> stats.tcp_requests++;
+        requests++;
+
+        /* Reject it over the client's '-r' rate, or compute the reply
+           here or on a compute thread */
+        seq = conn -> seq_tail++;
+        if (reject_request(conn -> client, pkt.version, data_receieved)) {
+            conn -> ready[seq % CONN_BUFSIZE] = REPLY_READY | REPLY_REJECTED;
+        }
+        else if (!handler -> compute || loop -> compute == NULL ||
+            offload_packet(loop, conn, seq, handler -> fn, data_receieved) == -1) {
+            start = start ? start : now_ns();
+            conn -> ready[seq % CONN_BUFSIZE] = REPLY_READY | handler -> fn(data_receieved);
+            untimed++;
+            if (handler -> compute) {
+                start = time_handlers(conn, start, untimed);
+                untimed = 0;
+            }
+        }
+
+        /* Server terminates if 0 is receieved */
+        if (data_receieved == 0) {
+            request_shutdown(loop);
+        }
+        if (pkt.version == PROTO_SINGLE) {
+            conn -> close_after_write = true;
+            offset = conn -> inlen;
+            break;
+        }
+    }
+
+    if (untimed > 0) {
+        time_handlers(conn, start, untimed);
+    }
+    if (requests > 0) {
+        metric_add(MC_TCP_REQUESTS, requests);
+    }
+
+    /* Keep any partial packet at the front of the buffer */
+    memmove(conn -> inbuf, conn -> inbuf + offset, conn -> inlen - offset);
+    conn -> inlen -= offset;
+    emit_replies(conn);
+}
+
+/*
+ *  offload_packet
+ *
+ *  Description:
+ *    Queue packet number 'seq' of a connection for the compute 
+ *    threads. Returns -1 if their queue is full, or the loop already
+ *    has as many jobs out as its completion queue holds.
+ */
+static int offload_packet(struct evloop* loop, struct connection* conn, uint32_t seq,
+                          handler_fn fn, uint32_t number) {
+
+    struct job job;
+
+    job.loop = loop;
+    job.conn = conn;
+    job.seq = seq;
+    job.number = number;
+    job.fn = fn;
+    job.reply = 0;
+    job.queued_at = conn -> read_at;
+    if (loop -> jobs_out == JOB_QUEUESIZE || submit_job(loop -> compute, &job) == -1) {
+        return -1;
+    }
+    conn -> ready[seq % CONN_BUFSIZE] = 0;
+    conn -> jobs++;
+    loop -> jobs_out++;
+    loop -> stats.offloaded++;
+    return 0;
+}
+
+/*
+ *  emit_replies
+ *
+ *  Description:
+ *    Queue the replies that are ready, in packet order, up to the 
+ *    first one still out on a compute thread.
+ */
+static void emit_replies(struct connection* conn) {
+
+    uint16_t* slot;
+
+    while (conn -> seq_head != conn -> seq_tail) {
+        slot = &conn -> ready[conn -> seq_head % CONN_BUFSIZE];
+        if (!(*slot & REPLY_READY)) {
+            break;
+        }
+        conn -> outbuf[conn -> outlen++] = (uint8_t)*slot;
+        conn -> seq_head++;
+    }
+}
+
+/*
+ *  window_full
+ *
+ *  Description:
+ *    True when 'outbuf' has no room for the reply to another packet,
+ *    counting the replies that are not in it yet.
+ */
+static bool window_full(struct connection* conn) {
+    return conn -> outlen + (conn -> seq_tail - conn -> seq_head) >= CONN_BUFSIZE;
+}
+
+/*
+ *  time_handlers
+ *
+ *  Description:
+ *    Record the queue and service times of the last 'count' handlers
+ *    run by process_packets(), which started at 'start': each one
+ *    waited from the read that brought its packet and gets an equal
+ *    share of the time they took. Returns the time now.
+ */
+static uint64_t time_handlers(struct connection* conn, uint64_t start, uint32_t count) {
+
+    uint64_t end = now_ns();
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        metric_time(MT_QUEUE, start > conn -> read_at ? start - conn -> read_at : 0);
+        metric_time(MT_SERVICE, (end - start) / count);
+    }
+    return end;
+}
+
+/*
+ *  flush_connection
+ *
+ *  Description:
+ *    Send as many queued replies as the socket accepts. Anything
+ *    left over is moved to the front of 'outbuf' and sent on the
+ *    next EPOLLOUT event. Returns -1 if the connection failed.
+ */
+static int flush_connection(struct evloop* loop, struct connection* conn) {
+
+    size_t total = 0;
+    ssize_t n;
+
+    while (total < conn -> outlen) {
+        if ((n = send(conn -> fd, conn -> outbuf + total, conn -> outlen - total,
+                      MSG_NOSIGNAL)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            metric_add(MC_ERRORS, 1);
+            return -1;
+        }
+        total += n;
+    }
+    loop -> stats.bytes_out += total;
+    if (total > 0) {
+        metric_add(MC_BYTES_OUT, total);
+    }
+    memmove(conn -> outbuf, conn -> outbuf + total, conn -> outlen - total);
+    conn -> outlen -= total;
+    return 0;
+}
+
+/*
+ *  read_datagrams
+ *
+ *  Description:
+ *    The UDP socket is edge-triggered, so datagrams are received 
+ *    until recvmsg() returns EAGAIN. A reliable transfer sent with
+ *    segmentation offload arrives as one buffer of many segments 
+ *    (UDP_GRO, see event_loop()), which is cut back into datagrams of
+ *    the size the kernel reports. With '-b <number>' the datagrams
+ *    are received and answered in batches, without UDP_GRO.
+ */
+static void read_datagrams(struct evloop* loop) {
+
+    struct sockaddr_storage from;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+    char dgram[RUDP_GRO_BUFSIZE], control[CMSG_SPACE(sizeof(int))];
+    ssize_t numbytes, size, off, sent;
+    int segment;
+    bool terminate = false;
+
+    /* Batched: one recvmmsg() and one sendmmsg() per batch */
+    while (loop -> opts -> batch > 1) {
+        if (serve_datagram_batch(loop -> udpSock, loop -> opts, &loop -> stats, 
+                                 &loop -> rudp, MSG_DONTWAIT, &terminate) == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[Server Program]: recvmmsg");
+            }
+            return;
+        }
+        if (terminate) {
+            request_shutdown(loop);
+            return;
+        }
+    }
+
+    while (1) {
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = dgram;
+        iov.iov_len = sizeof(dgram);
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        loop -> stats.syscalls++;
+        if ((numbytes = recvmsg(loop -> udpSock, &msg, 0)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[Server Program]: recvmsg");
+                metric_add(MC_ERRORS, 1);
+            }
+            /* Drained: acknowledge the reliable transfer segments read */
+            sent = rudp_flush_acks(loop -> rudp, loop -> udpSock, &loop -> stats.syscalls);
+            loop -> stats.bytes_out += sent;
+            metric_add(MC_BYTES_OUT, sent);
+            return;
+        }
+
+        /* Coalesced datagrams come with the size of each one */
+        size = numbytes;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg -> cmsg_level == SOL_UDP && cmsg -> cmsg_type == UDP_GRO) {
+                memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+                size = segment > 0 ? segment : numbytes;
+            }
+        }
+        for (off = 0; off < numbytes; off += size) {
+            if (serve_datagram(loop, dgram + off, numbytes - off < size ? numbytes - off 
+                                                                         : size,
+                               &from, msg.msg_namelen)) {
+                request_shutdown(loop);
+                return;
+            }
+        }
+    }
+}
+
+/*
+ *  serve_datagram
+ *
+ *  Description:
+ *    Answer one datagram holding a whole packet with its handler's
+ *    one byte reply (and the request's tag), or take a reliable
+ *    transfer segment (rudp.c), whose acknowledgement waits until the
+ *    socket is drained. Returns true if the termination number 0 was
+ *    receieved.
+ */
+static bool serve_datagram(struct evloop* loop, char* dgram, ssize_t numbytes,
+                           struct sockaddr_storage* from, socklen_t fromlen) {
+
+    const struct handler* handler;
+    char addrStr[INET6_ADDRSTRLEN];
+    struct packet pkt;
+    uint8_t reply, out[UDP_REPLYSIZE];
+    uint64_t start;
+    ssize_t sent;
+    size_t outlen;
+
+    loop -> stats.bytes_in += numbytes;
+    metric_add(MC_BYTES_IN, numbytes);
+    if (numbytes < (ssize_t)sizeof(struct packet)) return false;  // Runt datagram
+    memcpy(&pkt, dgram, sizeof(pkt));
+
+    /* A reliable transfer segment is written out and acknowledged */
+    if (pkt.version == PROTO_RUDP) {
+        loop -> stats.udp_requests++;
+        metric_add(MC_UDP_REQUESTS, 1);
+        if (loop -> rudp == NULL && 
+            (loop -> rudp = calloc(1, sizeof(struct rudp_receiver))) == NULL) {
+            perror("[Server Program]: calloc");
+            return false;
+        }
+        if ((sent = rudp_receive(loop -> rudp, loop -> udpSock, dgram, numbytes,
+                                 from, fromlen, loop -> opts, true)) > 0) {
+            loop -> stats.syscalls++;
+            loop -> stats.bytes_out += sent;
+            metric_add(MC_BYTES_OUT, sent);
+        }
+        return false;
+    }
+
+    /* Convert the packet to host byte order and unpack the message */
+    uint32_t data_receieved = ntohl(pkt.number);
+    if (!loop -> opts -> quiet) {
+        inet_ntop(from -> ss_family, get_sock_ip((struct sockaddr*)from), addrStr,
+                  sizeof(addrStr));
+        printf("[Server Program]: <%zd bytes> Receieved from %s via UDP, number: %u\n", 
+               numbytes, addrStr, data_receieved);
+    }
+    loop -> stats.udp_requests++;
+    metric_add(MC_UDP_REQUESTS, 1);
+    if (reject_request(client_key(from), pkt.version, data_receieved)) {
+        reply = REPLY_REJECTED;   // Over the '-r' rate: not served
+    }
+    else if ((handler = find_handler(pkt.version)) == NULL) {
+        metric_add(MC_ERRORS, 1);
+        return false;   // No handler: drop the datagram
+    }
+    else {
+        start = now_ns();
+        reply = handler -> fn(data_receieved);
+        metric_time(MT_SERVICE, now_ns() - start);
+    }
+
+    /* Send a reply message to the client */
+    loop -> stats.syscalls++;
+    outlen = udp_reply(out, reply, dgram, numbytes);
+    if (sendto(loop -> udpSock, out, outlen, 0, (struct sockaddr*)from, fromlen) == -1) {
+        perror("[Server Program]: sendto");
+        metric_add(MC_ERRORS, 1);
+    }
+    else {
+        loop -> stats.bytes_out += outlen;
+        metric_add(MC_BYTES_OUT, outlen);
+    }
+
+    /* Server terminates if 0 is receieved */
+    return data_receieved == 0;
+}
@@ -0,0 +1,220 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  MESSAGE FRAMING used by the client and server programs
+ *
+ *  Sending side (struct framer): outgoing records are collected as an
+ *  iovec array instead of being sent one send() at a time, and the
+ *  whole array goes out with a single sendmsg() once 'batch' records
+ *  are queued or the oldest one has waited 'max_delay' nanoseconds.
+ *  The delay is checked when a record is added, and by the caller's
+ *  wait: framer_due() is its timeout, and a flush follows when it
+ *  expires. The records are not copied, so they must not change
+ *  until the next flush.
+ *
+ *  Receiving side (struct frame_reader): one large recv() fills a
+ *  buffer and packets are parsed out of it until it runs dry, instead
+ *  of one recvall() per 5-byte packet. The replies to those packets
+ *  are collected and sent together with flush_replies().
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+/*
+ *  framer_init
+ *
+ *  Description:
+ *    Prepare a framer for a connected socket. A 'batch' of 1 sends
+ *    every record by itself; at most MAXBATCH records are gathered.
+ */
+void framer_init(struct framer* f, int fd, int batch, uint64_t max_delay) {
+    memset(f, 0, sizeof(*f));
+    f -> fd = fd;
+    f -> batch = batch < 1 ? 1 : (batch > MAXBATCH ? MAXBATCH : batch);
+    f -> max_delay = max_delay;
+}
+
+/*
+ *  framer_add
+ *
+ *  Description:
+ *    Queue one record of 'len' bytes at 'buf', then flush if the
+ *    batch is full or the oldest queued record is past its deadline.
+ *    Returns -1 if a flush failed.
+ */
+int framer_add(struct framer* f, void* buf, size_t len) {
+
+    uint64_t now = now_ns();
+
+    if (f -> count == 0) {
+        f -> oldest = now;
+    }
+    f -> iov[f -> count].iov_base = buf;
+    f -> iov[f -> count].iov_len = len;
+    f -> count++;
+    f -> records++;
+
+    if (f -> count >= f -> batch || now - f -> oldest >= f -> max_delay) {
+        return framer_flush(f);
+    }
+    return 0;
+}
+
+/*
+ *  framer_due
+ *
+ *  Description:
+ *    Nanoseconds until the oldest queued record must be sent: 0 if
+ *    it is already due, UINT64_MAX if nothing is queued. A caller
+ *    that waits for something else waits no longer than this, then
+ *    calls framer_flush().
+ */
+uint64_t framer_due(struct framer* f) {
+
+    uint64_t waited;
+
+    if (f -> count == 0) {
+        return UINT64_MAX;
+    }
+    waited = now_ns() - f -> oldest;
+    return waited >= f -> max_delay ? 0 : f -> max_delay - waited;
+}
+
+/*
+ *  framer_flush
+ *
+ *  Description:
+ *    Send every queued record with sendmsg(). A partial send leaves
+ *    the iovec array pointing at the first unsent byte and sendmsg()
+ *    is called again. Returns -1 on failure.
+ */
+int framer_flush(struct framer* f) {
+
+    struct iovec* iov = f -> iov;
+    struct msghdr msg;
+    int left = f -> count;
+    ssize_t n;
+
+    while (left > 0) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = left;
+        if ((n = sendmsg(f -> fd, &msg, MSG_NOSIGNAL)) == -1) {
+            if (errno == EINTR) continue;
+            perror("[Client Program]: sendmsg");
+            return -1;
+        }
+        f -> flushes++;
+
+        /* Skip the records that were sent whole, then the sent part of the next */
+        while (left > 0 && (size_t)n >= iov -> iov_len) {
+            n -= iov -> iov_len;
+            iov++;
+            left--;
+        }
+        if (left > 0) {
+            iov -> iov_base = (char*)iov -> iov_base + n;
+            iov -> iov_len -= n;
+        }
+    }
+    f -> count = 0;
+    return 0;
+}
+
+/*
+ *  reader_init
+ *
+ *  Description:
+ *    Prepare an empty reader for a connected socket of 'profile'.
+ */
+void reader_init(struct frame_reader* r, int fd, enum sock_profile profile) {
+    r -> fd = fd;
+    r -> profile = profile;
+    r -> start = 0;
+    r -> len = 0;
+    r -> recvs = 0;
+}
+
+/*
+ *  reader_buffered
+ *
+ *  Description:
+ *    True if a whole packet is already buffered, i.e. reader_next()
+ *    will not block.
+ */
+bool reader_buffered(struct frame_reader* r) {
+    return r -> len >= sizeof(struct packet);
+}
+
+/*
+ *  reader_next
+ *
+ *  Description:
+ *    Copy the next packet into 'pkt'. When less than a packet is
+ *    buffered, the partial packet is moved to the front and one
+ *    recv() takes as much as the buffer holds. Returns 1 for a packet,
+ *    0 if the peer closed the connection, and -1 on failure.
+ */
+int reader_next(struct frame_reader* r, struct packet* pkt) {
+
+    ssize_t n;
+
+    while (r -> len < sizeof(struct packet)) {
+        memmove(r -> buf, r -> buf + r -> start, r -> len);
+        r -> start = 0;
+        if ((n = recv(r -> fd, r -> buf + r -> len, FRAME_BUFSIZE - r -> len, 0)) == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        r -> len += n;
+        r -> recvs++;
+        if (r -> len % sizeof(struct packet) != 0) {
+            rearm_quickack(r -> fd, r -> profile);   // Part of a packet: ACK it now
+        }
+    }
+    memcpy(pkt, r -> buf + r -> start, sizeof(struct packet));
+    r -> start += sizeof(struct packet);
+    r -> len -= sizeof(struct packet);
+    return 1;
+}
+
+/*
+ *  reader_take
+ *
+ *  Description:
+ *    Consume up to 'max' bytes that are already buffered (the start
+ *    of a bulk payload read along with its packet). Sets 'data' to
+ *    them and returns how many there were.
+ */
+size_t reader_take(struct frame_reader* r, size_t max, char** data) {
+
+    size_t n = r -> len < max ? r -> len : max;
+
+    *data = r -> buf + r -> start;
+    r -> start += n;
+    r -> len -= n;
+    return n;
+}
+
+/*
+ *  flush_replies
+ *
+ *  Description:
+ *    Send the 'numreplies' one byte replies collected in 'replies'
+ *    with one sendall() and empty the buffer. Returns -1 on failure.
+ */
+int flush_replies(int fd, char* replies, int* numreplies) {
+
+    int ret = 0;
+
+    if (*numreplies > 0 && (ret = sendall(fd, replies, numreplies)) == -1) {
+        fprintf(stderr, "[Server Program]: Failed to sendall\n");
+    }
+    *numreplies = 0;
+    return ret;
+}
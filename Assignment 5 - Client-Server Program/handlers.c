@@ -0,0 +1,99 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  REQUEST HANDLERS used by the server program
+ *
+ *  The version byte of a packet selects the handler that computes
+ *  its one byte reply. Every serving mode looks the handler up in
+ *  this registry, so new work is added by writing a handler and
+ *  registering it in init_handlers(); no I/O loop changes.
+ *
+ *  A handler marked 'compute' is expensive. The event loop does not
+ *  run it on its own thread when compute threads are started with
+ *  '-j <number>' (compute.c), so a slow request does not hold up the
+ *  I/O of every other connection.
+ *
+ *  PROTO_BULK is not in the registry: its payload follows the packet
+ *  on the stream, so the fork and pool modes receive it themselves.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static struct handler handlers[UINT8_MAX + 1];
+
+static uint8_t reply_number(uint32_t number);
+static uint8_t hash_rounds(uint32_t number);
+
+/*
+ *  init_handlers
+ *
+ *  Description:
+ *    Register the built-in handlers. Called once by the server
+ *    program before any thread is started.
+ */
+void init_handlers(void) {
+    register_handler(PROTO_SINGLE, "single", reply_number, false);
+    register_handler(PROTO_PERSISTENT, "persistent", reply_number, false);
+    register_handler(PROTO_WORK, "work", hash_rounds, true);
+}
+
+/*
+ *  register_handler
+ *
+ *  Description:
+ *    Make 'fn' the handler of packets with the given version. The
+ *    registry is not locked, so handlers are registered before the
+ *    server starts serving.
+ */
+void register_handler(uint8_t version, const char* name, handler_fn fn, bool compute) {
+    handlers[version].name = name;
+    handlers[version].fn = fn;
+    handlers[version].compute = compute;
+}
+
+/*
+ *  find_handler
+ *
+ *  Description:
+ *    Returns the handler registered for 'version', or NULL if there
+ *    is none (the serving modes close such a connection).
+ */
+const struct handler* find_handler(uint8_t version) {
+    return handlers[version].fn != NULL ? &handlers[version] : NULL;
+}
+
+/*
+ *  reply_number
+ *
+ *  Description:
+ *    The original server logic: every number is answered with 1.
+ */
+static uint8_t reply_number(UNUSED_PARAM uint32_t number) {
+    return 1;
+}
+
+/*
+ *  hash_rounds
+ *
+ *  Description:
+ *    Sample CPU-bound handler for PROTO_WORK: run 'number' rounds of
+ *    a 64-bit mixing function (capped at WORK_MAX_ROUNDS), a few
+ *    nanoseconds each. Every round depends on the last, so the work
+ *    cannot be vectorized or skipped. The reply is still 1, so any
+ *    client can send these packets.
+ */
+static uint8_t hash_rounds(uint32_t number) {
+
+    uint64_t h = number;
+    uint32_t i, rounds = number < WORK_MAX_ROUNDS ? number : WORK_MAX_ROUNDS;
+
+    for (i = 0; i < rounds; i++) {
+        h ^= h >> 31;
+        h *= 0x9E3779B97F4A7C15ULL;
+        h ^= i;
+    }
+    __asm__ volatile("" : : "r"(h));   // The result is used, so the loop is kept
+    return 1;
+}
@@ -1,28 +1,77 @@
+#define _GNU_SOURCE     // recvmmsg(), sendmmsg(), splice() and memfd_create()
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <sys/wait.h>
 #include <stdbool.h>
 #include <sys/time.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#include <endian.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/* 
+ *  Socket profile definitions (see profile.c)
+ */
+#define PROFILE_BUFSIZE       (8 * 1024 * 1024)  // Socket buffers of the throughput profile
+#define PROFILE_LOWAT         (256 * 1024)       // Unsent bytes that wake a writer
+#define PROFILE_BUSY_POLL_US  50                 // Busy polling of the latency profile
+
+enum sock_profile { PROFILE_DEFAULT, PROFILE_LATENCY, PROFILE_THROUGHPUT, PROFILE_COUNT };
 
 /* 
  *  Struct for collecting command-line input
  */
 struct cmdline {
     uint32_t data;
-    char socktype[3];
+    char socktype[4];
     struct in_addr ipv4_address;
     char* hostname;
     char* port;
+    char mode[8];
+    int workers;
+    int pool;
+    uint32_t count;
+    uint32_t depth;
+    uint32_t connections;
+    uint32_t rate;
+    uint32_t duration;
+    int batch;
+    bool quiet;
+    char method[12];
+    char* file;
+    uint32_t attempt_delay;
+    uint8_t version;
+    int compute;
+    char* admin;
+    int backlog;
+    int max_conns;
+    enum sock_profile profile;
 };
 
 /* 
@@ -45,6 +94,7 @@ struct packet {
     uint8_t version;
     uint32_t number;
 };
+#pragma pack()
 
 /* 
  *  Attribute to notify compiler of unused parameters
@@ -56,9 +106,576 @@ struct packet {
  */
 #define BACKLOG         10      // Size of the pending connection queue
 #define MAXDATASIZE     100     // Maximum number of bytes sent by client
+#define MAXDEPTH        1024    // Maximum packets a client keeps in flight
 #define SERVER          0
 #define CLIENT          1
 
+/* 
+ *  Packet versions. The version byte frames the TCP stream:
+ *  
+ *    PROTO_SINGLE:      one packet per connection; the server replies
+ *                       and closes the connection (the original protocol)
+ *    PROTO_PERSISTENT:  any number of packets per connection, sent back
+ *                       to back; each is answered with a one byte reply 
+ *                       in the order the packets were sent
+ *    PROTO_BULK:        'number' bytes of payload follow the packet; the
+ *                       reply is sent once all of them have arrived, and
+ *                       the connection stays open as for PROTO_PERSISTENT
+ *    PROTO_WORK:        framed as PROTO_PERSISTENT; the server spends
+ *                       'number' rounds of CPU work on it (handlers.c)
+ *    PROTO_RUDP:        UDP only: a segment of a reliable transfer, with
+ *                       'number' its sequence number (rudp.c)
+ *
+ *  Every version but PROTO_BULK and PROTO_RUDP is answered by the 
+ *  handler registered for it (handlers.c).
+ */
+#define PROTO_SINGLE        0x1
+#define PROTO_PERSISTENT    0x2
+#define PROTO_BULK          0x3
+#define PROTO_WORK          0x4
+#define PROTO_RUDP          0x5
+
+/* 
+ *  Replies. A handler answers 1; a request shed by admission control
+ *  (admission.c) is answered REPLY_REJECTED without being served.
+ */
+#define REPLY_REJECTED      0x2
+
+/* 
+ *  A UDP request may carry a tag of UDP_TAGSIZE bytes after its packet,
+ *  which the server copies after the reply byte. Datagrams can be lost,
+ *  so the benchmark client tags each request with its sequence number
+ *  to tell which request a reply answers (bench.c).
+ */
+#define UDP_TAGSIZE         4
+#define UDP_REQUESTSIZE     (sizeof(struct packet) + UDP_TAGSIZE)
+#define UDP_REPLYSIZE       (1 + UDP_TAGSIZE)
+
+/* 
+ *  Admission control definitions (see admission.c)
+ */
+#define ADMIT_CLIENTS       4096   // Token buckets, by hash of the client address
+#define ADMIT_BURST_MS      100    // A bucket holds this long's worth of '-r' requests
+
+/* 
+ *  Struct for one client's token bucket: 'full' is when the bucket
+ *  will be full again, and 'key' the hash of the client's address.
+ */
+struct client_bucket {
+    atomic_ullong key;
+    atomic_ullong full;
+};
+
+/* 
+ *  Struct for the admission state, mapped shared before any fork().
+ *  'interval' is the time between two tokens, and 'tolerance' how far
+ *  ahead of now a bucket may be emptied before requests are rejected.
+ */
+struct admission {
+    atomic_int active;
+    int max_conns;
+    uint64_t interval;
+    uint64_t tolerance;
+    struct client_bucket buckets[ADMIT_CLIENTS];
+};
+
+/* 
+ *  Request handler definitions (see handlers.c and compute.c)
+ */
+#define WORK_MAX_ROUNDS     100000000  // Most rounds a PROTO_WORK packet runs
+#define MAXCOMPUTE          64         // Upper limit for '-j' compute threads
+#define JOB_QUEUESIZE       4096       // Jobs in one lock-free ring (a power of two)
+
+/* 
+ *  A handler computes the reply to the number of one packet. A
+ *  'compute' handler is expensive and, with '-j', the event loop
+ *  hands it to a compute thread.
+ */
+typedef uint8_t (*handler_fn)(uint32_t number);
+
+struct handler {
+    const char* name;
+    handler_fn fn;
+    bool compute;
+};
+
+/* 
+ *  Struct for a request handed from an event loop to a compute thread
+ *  and back. 'seq' is the request's place in its connection's order
+ *  of replies, and 'queued_at' is when its bytes were read.
+ */
+struct job {
+    struct evloop* loop;
+    struct connection* conn;
+    uint32_t seq;
+    uint32_t number;
+    handler_fn fn;
+    uint8_t reply;
+    uint64_t queued_at;
+};
+
+/* 
+ *  Struct for a bounded lock-free queue of jobs. 'head' and 'tail'
+ *  sit on their own cache lines, so consumers and producers do not
+ *  slow each other down.
+ */
+struct job_cell {
+    atomic_size_t seq;
+    struct job job;
+};
+
+struct job_queue {
+    struct job_cell* cells;
+    size_t mask;
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+};
+
+/* 
+ *  Struct for the compute threads shared by the event loops
+ */
+struct compute {
+    int size;
+    pthread_t* threads;
+    struct job_queue queue;
+    sem_t items;                // Counts queued jobs, so idle threads sleep
+};
+
+/* 
+ *  Connection establishment definitions (see connect.c)
+ */
+#define CONNECT_DELAY_MS    250    // Default '-a' delay between connection attempts
+#define MAXATTEMPTS         16     // Connection attempts pending at once
+
+/* 
+ *  Bulk transfer definitions (see bulk.c)
+ */
+#define BULK_BUFSIZE    (256 * 1024)     // Buffer of the 'copy' method
+#define BULK_PIPESIZE   (1024 * 1024)    // Pipe between the two halves of a splice()
+
+/* 
+ *  Shared memory transport definitions (see shm.c and shm_server.c)
+ */
+#define SHM_SLOTS           MAXDEPTH      // Entries of each ring: a whole window fits
+#define SHM_PATH            "pa5-shm-%s"  // Abstract UNIX socket name, by port
+#define SHM_SPINS           2000          // Checks of a ring before sleeping on it
+#define SHM_POLL_MS         100           // The server checks for a dead client this often
+#define SHM_UNAVAILABLE     -2            // run_shm(): no server to share memory with
+
+/* 
+ *  Struct for one direction of a shared memory channel: a single
+ *  producer, single consumer ring. The consumer owns 'head' and the
+ *  producer 'tail', each on its own cache line. The producer adds 1
+ *  to the futex word 'seq' after every publish and wakes the consumer
+ *  only if 'waiting' says it went to sleep on it.
+ */
+struct shm_ring {
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+    _Alignas(64) atomic_uint seq;
+    atomic_uint waiting;
+};
+
+/* 
+ *  Struct for the memory a server shares with one client: packets go
+ *  one way and one byte replies the other. 'closed' is set by the
+ *  client when it is done.
+ */
+struct shm_channel {
+    struct shm_ring requests;
+    struct shm_ring replies;
+    struct packet request[SHM_SLOTS];
+    uint8_t reply[SHM_SLOTS];
+    atomic_bool closed;
+};
+
+/* 
+ *  Reliable UDP definitions (see rudp.c)
+ */
+#define RUDP_MSS            1400          // Payload bytes in one segment
+#define RUDP_WINDOW         64            // Default and largest '-k' window, in segments
+#define RUDP_DUPTHRESH      3             // SACKed segments above a hole that resend it
+#define RUDP_ACK_EVERY      16            // Segments the event loop receives per ack
+#define RUDP_MAXPEERS       64            // Transfers a server receives at once
+#define RUDP_MAX_TRIES      16            // Sends of one segment before giving up
+#define RUDP_INIT_RTO       200000000ULL  // Retransmit timeout before an RTT sample (ns)
+#define RUDP_MIN_RTO        2000000ULL    // Lower bound of the retransmit timeout (ns)
+#define RUDP_MAX_RTO        1000000000ULL // Upper bound of the retransmit timeout (ns)
+#define RUDP_DATA           0x1
+#define RUDP_FIN            0x2           // Last segment of the transfer
+#define RUDP_ACK            0x4
+
+/* 
+ *  Struct for the header of a reliable UDP segment. Data segments
+ *  carry up to RUDP_MSS payload bytes after it. An acknowledgement
+ *  echoes the sequence number of the segment that triggered it in
+ *  'pkt.number'; 'ack' is the first sequence number not yet received,
+ *  and bit i of 'sack' is set if 'ack + 1 + i' has been received.
+ */
+#pragma pack(1)
+struct rudp_header {
+    struct packet pkt;
+    uint8_t flags;
+    uint32_t conn;
+    uint32_t ack;
+    uint64_t sack;
+};
+#pragma pack()
+
+#define RUDP_DGRAMSIZE      (sizeof(struct rudp_header) + RUDP_MSS)
+#define RUDP_GSO_SEGS       ((int)(65507 / RUDP_DGRAMSIZE))  // Segments in one offloaded send
+#define RUDP_GRO_BUFSIZE    65536         // Receive buffer for coalesced segments
+
+/* 
+ *  Struct for one segment in the sender's window. 'fast' is set once
+ *  the segment has been resent for a hole below SACKed segments.
+ */
+struct rudp_slot {
+    uint64_t sent_at;
+    uint8_t tries;
+    bool acked;
+    bool fast;
+};
+
+/* 
+ *  Struct for the sender of a reliable transfer. Segments 'base' to
+ *  'next - 1' are in flight, in slot 'seq % RUDP_WINDOW'; the ones to
+ *  send are gathered for one sendmmsg(), with a UDP_SEGMENT control
+ *  message per offloaded run while 'gso' holds. Times are in 
+ *  nanoseconds and 'srtt' is 0 until the first RTT sample.
+ */
+struct rudp_sender {
+    int sock;
+    uint32_t conn;
+    const char* payload;
+    size_t len;
+    uint32_t segments;
+    uint32_t window;
+    uint32_t base;
+    uint32_t next;
+    struct rudp_slot slots[RUDP_WINDOW];
+    struct rudp_header headers[RUDP_WINDOW];
+    struct iovec iov[RUDP_WINDOW][2];
+    struct mmsghdr msgs[RUDP_WINDOW];
+    char control[RUDP_WINDOW][CMSG_SPACE(sizeof(uint16_t))];
+    int queued;
+    bool gso;
+    uint64_t srtt;
+    uint64_t rttvar;
+    uint64_t rto;
+    uint64_t backoff_at;
+    unsigned long sent;
+    unsigned long timeouts;
+    unsigned long fast_retransmits;
+};
+
+/* 
+ *  Struct for the receiving end of one transfer, keyed by the
+ *  sender's address and connection id. 'next' and 'sack' are sent
+ *  back in every acknowledgement, with 'echo', the last segment
+ *  received; 'unacked' counts the segments received since. 'fin' is
+ *  the FIN segment's sequence number plus one (0 until it arrives).
+ */
+struct rudp_peer {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    uint32_t conn;
+    uint32_t next;
+    uint64_t sack;
+    uint32_t fin;
+    uint32_t echo;
+    int unacked;
+    int fd;
+    bool done;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t last;
+    unsigned long segments;
+    unsigned long duplicates;
+};
+
+struct rudp_receiver {
+    struct rudp_peer peers[RUDP_MAXPEERS];
+};
+
+/* 
+ *  Event loop (epoll) definitions
+ */
+#define EVENT_BACKLOG   SOMAXCONN  // Pending connection queue in epoll mode
+#define MAXEVENTS       256        // Events returned by one epoll_wait()
+#define CONN_BUFSIZE    4096       // Per-connection input and output buffer
+#define MAXWORKERS      64         // Upper limit for '-w' worker threads
+#define MAXBATCH        256        // Upper limit for '-b' datagrams per batch
+
+/* 
+ *  Message framing definitions (see framing.c)
+ */
+#define FRAME_BUFSIZE       (64 * 1024)  // Bytes taken by one recv() of a reader
+#define FRAME_MAX_DELAY_NS  1000000ULL   // A queued record is sent within 1 ms
+
+/* 
+ *  Struct for gathering outgoing records into one sendmsg(). 'iov'
+ *  points at the caller's records; 'oldest' is when the first record
+ *  of the current batch was queued.
+ */
+struct framer {
+    int fd;
+    struct iovec iov[MAXBATCH];
+    int count;
+    int batch;
+    uint64_t max_delay;
+    uint64_t oldest;
+    unsigned long records;
+    unsigned long flushes;
+};
+
+/* 
+ *  Struct for parsing packets out of large reads. The unparsed bytes
+ *  are buf[start] to buf[start + len - 1]. 'profile' is the socket
+ *  profile of the connection (profile.c).
+ */
+struct frame_reader {
+    int fd;
+    enum sock_profile profile;
+    char buf[FRAME_BUFSIZE];
+    size_t start;
+    size_t len;
+    unsigned long recvs;
+};
+
+/* 
+ *  Connection pool definitions (see pool.c)
+ */
+#define POOL_THREADS    8          // Default '-n' threads in pool mode
+#define MAXPOOL         1024       // Upper limit for '-n' pool threads
+#define POOL_QUEUESIZE  256        // Accepted connections waiting for a thread
+#define POOL_FIRST_MS   1000       // Wait for the first packet of a connection in a drain
+
+/* 
+ *  Struct for the bounded queue of accepted connections shared by
+ *  the acceptor and the pool threads. 'slots' counts free entries
+ *  and 'items' counts queued connections, so the acceptor blocks
+ *  while the queue is full and the threads block while it is empty.
+ */
+struct conn_queue {
+    int fds[POOL_QUEUESIZE];
+    uint64_t accepted[POOL_QUEUESIZE];
+    uint64_t clients[POOL_QUEUESIZE];
+    int head;
+    int count;
+    sem_t slots;
+    sem_t items;
+    pthread_mutex_t lock;
+};
+
+/* 
+ *  Struct for one pool thread. 'fd' is the connection it is serving
+ *  (-1 while idle) so a drain can interrupt an idle persistent client.
+ */
+struct pool_thread {
+    int id;
+    pthread_t tid;
+    int fd;
+    unsigned long connections;
+    unsigned long requests;
+    struct pool* pool;
+};
+
+/* 
+ *  Struct for a connection pool: one acceptor feeding 'size' threads
+ */
+struct pool {
+    int listenSock;
+    int size;
+    struct conn_queue queue;
+    struct pool_thread* threads;
+    pthread_mutex_t lock;          // Guards every thread's 'fd'
+    atomic_bool shutdown;
+    struct cmdline* opts;
+};
+
+/* 
+ *  Struct for the state of one client connection in the event loop.
+ * 
+ *    Edge-triggered epoll only reports a socket once per state change,
+ *    so a connection is read until recv() returns EAGAIN. Bytes that
+ *    do not yet make up a whole packet wait in 'inbuf', and replies
+ *    that send() could not take wait in 'outbuf' for EPOLLOUT.
+ *
+ *    Replies must go out in the order the packets came in, but a job
+ *    on a compute thread may finish after later packets. Packet number
+ *    'seq' keeps its reply in 'ready[seq % CONN_BUFSIZE]' (REPLY_READY
+ *    is set once it is known), and replies move to 'outbuf' from
+ *    'seq_head' until one is still missing. 'jobs' counts the packets
+ *    out on compute threads; a connection closed while it has any 
+ *    keeps its memory (with 'fd' -1) until the last one comes back.
+ *    'read_at' is the time of the last read, for the queue times of
+ *    the packets it brought (metrics.c), and 'client' the hash of the
+ *    client's address, for its token bucket (admission.c).
+ */
+#define REPLY_READY     0x100
+
+struct connection {
+    int fd;
+    char inbuf[CONN_BUFSIZE];
+    size_t inlen;
+    char outbuf[CONN_BUFSIZE];
+    size_t outlen;
+    uint16_t ready[CONN_BUFSIZE];
+    uint32_t seq_head;
+    uint32_t seq_tail;
+    int jobs;
+    uint64_t read_at;
+    uint64_t client;
+    bool close_after_write;
+    bool touched;
+    struct connection* touched_next;
+    struct connection* prev;
+    struct connection* next;
+};
+
+/* 
+ *  Latency histogram definitions (see stats.c)
+ */
+#define HIST_SUB_BITS       5
+#define HIST_SUB_BUCKETS    (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS        ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+/* 
+ *  Struct for a log-linear latency histogram in nanoseconds
+ */
+struct histogram {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+};
+
+/* 
+ *  Server metrics definitions (see metrics.c)
+ */
+#define METRIC_SHARDS   64         // Copies of the counters: one per thread, the last shared
+#define ADMIN_BUFSIZE   4096       // Largest statistics reply
+
+enum metric_counter {
+    MC_ACCEPTS, MC_CLOSES, MC_TCP_REQUESTS, MC_UDP_REQUESTS, MC_BYTES_IN, MC_BYTES_OUT,
+    MC_ERRORS, MC_REJECTED_CONNS, MC_REJECTED_REQUESTS, MC_SHM_REQUESTS, MC_COUNT
+};
+enum metric_timing { MT_QUEUE, MT_SERVICE, MT_COUNT };
+
+/* 
+ *  Struct for one copy of the server metrics. Each shard starts on 
+ *  its own cache line and is written by one thread (the last one by
+ *  any number); its histogram buckets use the layout of struct 
+ *  histogram.
+ */
+struct metric_shard {
+    _Alignas(64) atomic_ulong counters[MC_COUNT];
+    atomic_ulong sums[MT_COUNT];
+    atomic_ulong maxes[MT_COUNT];
+    atomic_ulong buckets[MT_COUNT][HIST_BUCKETS];
+};
+
+/* 
+ *  Struct for the server metrics, mapped shared before any fork()
+ */
+struct metrics {
+    uint64_t started;
+    atomic_int next_shard;
+    struct metric_shard shards[METRIC_SHARDS];
+};
+
+/* 
+ *  Struct for the sum of every shard, as sent by the endpoint
+ */
+struct metrics_snapshot {
+    double uptime;
+    unsigned long counters[MC_COUNT];
+    long active;
+    uint64_t sums[MT_COUNT];
+    struct histogram timings[MT_COUNT];
+};
+
+/* 
+ *  Benchmark client definitions (see bench.c)
+ */
+#define MAXBENCHCONNS   1024                  // Upper limit for '-c' connections
+#define UDP_TIMEOUT_NS  1000000000ULL         // A UDP reply older than 1 s is lost
+#define UDP_REORDER     3                     // ...or once 3 later requests are answered
+#define DRAIN_NS        2000000000ULL         // Wait for late replies after the run
+
+/* 
+ *  Struct for one benchmark connection. 'sent_at' is a ring of the
+ *  intended send times of the packets in flight; the server replies
+ *  to a TCP connection in order, so the oldest entry belongs to the
+ *  next reply. A UDP reply echoes the sequence number of its request
+ *  (its tag), which picks the entry; an entry that was answered
+ *  is set to 0 until the replies before it are in or lost. 'sent'
+ *  counts the packets queued since the socket was connected,
+ *  'connecting' is set while a non-blocking connect() is pending, and
+ *  'rejected' once the server answered REPLY_REJECTED on it.
+ */
+struct bench_conn {
+    int fd;
+    uint64_t sent_at[MAXDEPTH];
+    uint32_t head;
+    uint32_t inflight;
+    uint32_t sent;
+    bool connecting;
+    bool rejected;
+    char outbuf[MAXDEPTH * UDP_REQUESTSIZE];
+    size_t outlen;
+};
+
+/* 
+ *  Struct for the statistics kept by one event loop. Each worker
+ *  owns its counters, so they are updated without locks.
+ */
+struct loop_stats {
+    unsigned long accepts;
+    unsigned long tcp_requests;
+    unsigned long udp_requests;
+    unsigned long bytes_in;
+    unsigned long bytes_out;
+    unsigned long syscalls;
+    unsigned long offloaded;
+};
+
+/* 
+ *  Struct for an epoll event loop and the connections it owns.
+ * 
+ *    'listenSock' or 'udpSock' is -1 when the loop does not serve
+ *    that protocol. Every loop watches the same 'wakefd' eventfd
+ *    and 'shutdown' flag, so a termination request that arrives at
+ *    one worker stops all of them.
+ *
+ *    With compute threads, each loop also has its own completion
+ *    queue 'done' and 'donefd' eventfd for the jobs it handed out;
+ *    'notified' is set while a wakeup is pending on 'donefd'. It has
+ *    at most JOB_QUEUESIZE jobs out ('jobs_out'), so 'done' can hold
+ *    all of them and a compute thread never waits for the loop.
+ *
+ *    'rudp' holds the reliable UDP transfers the loop is receiving,
+ *    allocated with the first PROTO_RUDP segment (rudp.c).
+ */
+struct evloop {
+    int id;
+    int epfd;
+    int listenSock;
+    int udpSock;
+    int wakefd;
+    atomic_bool* shutdown;
+    struct connection* conns;
+    struct cmdline* opts;
+    struct loop_stats stats;
+    struct compute* compute;
+    struct job_queue done;
+    int donefd;
+    atomic_bool notified;
+    unsigned jobs_out;
+    struct rudp_receiver* rudp;
+};
+
 /*
  *  Function prototypes
  */
@@ -70,4 +687,83 @@ void usageErrorMsg();
 void init_sigchld_handler(struct sigaction* sa);
 void init_hints(struct addrinfo* hints, char* socktype, int client);
 int sendall(int s, char* buf, int* len);
+int recvall(int s, char* buf, int* len);
 struct packet init_packet(uint8_t ver, uint32_t num, struct packet*);
+int set_nonblocking(int fd);
+int bind_socket(char* port, int socktype, bool reuseport);
+size_t udp_reply(uint8_t* out, uint8_t reply, const char* dgram, size_t len);
+void event_loop(struct evloop* loop);
+void serve_event_loop(int listenSock, int udpSock, struct cmdline* opts);
+void run_workers(struct cmdline* opts);
+void print_loop_stats(struct evloop* loop);
+uint64_t now_ns(void);
+void hist_init(struct histogram* h);
+void hist_record(struct histogram* h, uint64_t value);
+void hist_merge(struct histogram* dst, const struct histogram* src);
+uint64_t hist_percentile(const struct histogram* h, double q);
+void hist_print(const struct histogram* h, const char* prefix);
+int hist_index(uint64_t value);
+uint64_t hist_bucket_value(int idx);
+int metrics_init(void);
+void metric_add(enum metric_counter c, unsigned long n);
+void metric_time(enum metric_timing t, uint64_t ns);
+int start_admin(const char* endpoint);
+void metrics_child(void);
+int parse_profile(const char* name);
+const char* profile_name(enum sock_profile profile);
+int apply_profile(int fd, enum sock_profile profile, const char* prefix);
+void rearm_quickack(int fd, enum sock_profile profile);
+void cork_socket(int fd, enum sock_profile profile, bool on);
+int admission_init(struct cmdline* opts);
+bool admit_connection(void);
+void release_connection(void);
+void reject_connection(int fd);
+bool reject_request(uint64_t client, uint8_t version, uint32_t number);
+uint64_t client_key(struct sockaddr_storage* addr);
+int run_benchmark(struct cmdline* opts, struct addrinfo* serverInfo);
+void init_handlers(void);
+void register_handler(uint8_t version, const char* name, handler_fn fn, bool compute);
+const struct handler* find_handler(uint8_t version);
+int job_queue_init(struct job_queue* q, size_t size);
+void job_queue_free(struct job_queue* q);
+bool job_queue_push(struct job_queue* q, const struct job* job);
+bool job_queue_pop(struct job_queue* q, struct job* job);
+struct compute* start_compute(int size);
+int submit_job(struct compute* compute, const struct job* job);
+void stop_compute(struct compute* compute);
+int attach_compute(struct evloop* loop, struct compute* compute);
+void detach_compute(struct evloop* loop);
+int resolve_hosts(char* hosts, char* port, struct addrinfo* hints, struct addrinfo** res);
+int race_connect(struct addrinfo* list, uint32_t delay_ms, struct addrinfo** winner,
+                 int* attempts);
+int serve_datagram_batch(int sock, struct cmdline* opts, struct loop_stats* stats,
+                         struct rudp_receiver** rudp, int flags, bool* terminate);
+int serve_udp_batched(int sock, struct cmdline* opts);
+void print_udp_stats(struct loop_stats* stats);
+void run_pool(int listenSock, struct cmdline* opts);
+int run_bulk(int sock, struct cmdline* opts);
+int recv_bulk(int sock, uint32_t len, const char* head, size_t headlen,
+              struct cmdline* opts);
+void framer_init(struct framer* f, int fd, int batch, uint64_t max_delay);
+int framer_add(struct framer* f, void* buf, size_t len);
+uint64_t framer_due(struct framer* f);
+int framer_flush(struct framer* f);
+void reader_init(struct frame_reader* r, int fd, enum sock_profile profile);
+bool reader_buffered(struct frame_reader* r);
+int reader_next(struct frame_reader* r, struct packet* pkt);
+size_t reader_take(struct frame_reader* r, size_t max, char** data);
+int flush_replies(int fd, char* replies, int* numreplies);
+int open_payload(struct cmdline* opts, size_t* len);
+int run_rudp(int sock, struct addrinfo* server, struct cmdline* opts);
+int start_shm(struct cmdline* opts);
+int run_shm(struct cmdline* opts, struct addrinfo* serverInfo, uint8_t* reply);
+socklen_t shm_address(char* port, struct sockaddr_un* addr);
+bool shm_wait(struct shm_ring* r, int timeout_ms);
+void shm_signal(struct shm_ring* r);
+int shm_send_fd(int sock, int fd);
+int shm_recv_fd(int sock, uint8_t* byte);
+ssize_t rudp_receive(struct rudp_receiver* rx, int sock, const char* dgram, size_t len,
+                     struct sockaddr_storage* from, socklen_t fromlen, struct cmdline* opts,
+                     bool defer);
+ssize_t rudp_flush_acks(struct rudp_receiver* rx, int sock, unsigned long* syscalls);
+void rudp_receiver_free(struct rudp_receiver* rx);
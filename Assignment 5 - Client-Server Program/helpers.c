@@ -26,10 +26,23 @@
 struct cmdline parser(int argc, char* argv[], int client) {
 
     struct cmdline options;
-    int opt = 0, numopts = 0;
+    int opt = 0, numopts = 0, required = 0;
+    bool counted = false, windowed = false;
+
+    /* Optional settings fall back to these defaults */
+    memset(&options, 0, sizeof(options));
+    strcpy(options.mode, client ? "send" : "fork");
+    strcpy(options.method, client ? "sendfile" : "splice");
+    options.count = 1;
+    options.depth = 1;
+    options.connections = 1;
+    options.duration = 5;
+    options.batch = client ? 0 : 1;   // Client: 0 sends a whole window at once
+    options.attempt_delay = CONNECT_DELAY_MS;
+    options.version = PROTO_PERSISTENT;
 
     /* Fill the command-line options struct with getopt() */
-    while ((opt = getopt(argc, argv, ": x: t: s: p:")) != -1) {
+    while ((opt = getopt(argc, argv, ": x: t: s: p: m: w: n: k: c: r: d: b: z: f: a: v: j: e: l: o: q")) != -1) {
 
         switch(opt) {
             /* Data sent */
@@ -40,16 +53,18 @@ struct cmdline parser(int argc, char* argv[], int client) {
                     usageErrorMsg();
                 } 
                 if (checkInteger(optarg)) {
-                    options.data = atoi(optarg);
+                    options.data = strtoul(optarg, NULL, 10);
                 }
+                required++;
                 break;
 
             /* Socket type */
             case 't' : 
-                strncpy(options.socktype, optarg, 3);
+                strncpy(options.socktype, optarg, sizeof(options.socktype) - 1);
+                required++;
                 break;
 
-            /* IPv4 address or hostname */
+            /* IPv4 address or hostname, or a comma separated list of them */
             case 's' : 
                 if (!client) { 
                     printf("\nERROR: %s: Unrecognized server option: '-%c'\n", 
@@ -65,6 +80,7 @@ struct cmdline parser(int argc, char* argv[], int client) {
                     options.ipv4_address.s_addr = 0;
                     options.hostname = optarg;
                 }
+                required++;
                 break;
 
             /* Port number */
@@ -72,6 +88,159 @@ struct cmdline parser(int argc, char* argv[], int client) {
                 if (checkInteger(optarg)) {
                     options.port = optarg;
                 }
+                required++;
+                break;
+
+            /* Server event handling mode or client mode */
+            case 'm' : 
+                strncpy(options.mode, optarg, sizeof(options.mode) - 1);
+                break;
+
+            /* Number of worker threads */
+            case 'w' : 
+                if (client) { 
+                    printf("\nERROR: %s: Unrecognized client option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                if (checkInteger(optarg)) {
+                    options.workers = atoi(optarg);
+                }
+                break;
+
+            /* Version of the client's pipelined and benchmark packets */
+            case 'v' : 
+                if (!client) { 
+                    printf("\nERROR: %s: Unrecognized server option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                if (checkInteger(optarg)) {
+                    options.version = strtoul(optarg, NULL, 10) > UINT8_MAX ? 0 
+                                      : strtoul(optarg, NULL, 10);
+                }
+                break;
+
+            /* Compute threads of the event loop */
+            case 'j' : 
+                if (client) { 
+                    printf("\nERROR: %s: Unrecognized client option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                if (checkInteger(optarg)) {
+                    options.compute = atoi(optarg);
+                }
+                break;
+
+            /* Datagrams per recvmmsg() batch, or packets per client sendmsg() */
+            case 'b' : 
+                if (checkInteger(optarg)) {
+                    options.batch = atoi(optarg);
+                }
+                break;
+
+            /* Bulk transfer method */
+            case 'z' : 
+                strncpy(options.method, optarg, sizeof(options.method) - 1);
+                break;
+
+            /* File sent by a bulk transfer, or where the server writes it */
+            case 'f' : 
+                options.file = optarg;
+                break;
+
+            /* Socket profile: default, latency or throughput (profile.c) */
+            case 'o' : 
+                if (parse_profile(optarg) == -1) {
+                    printf("\nERROR: %s: socket profile \"%s\" not allowed\n", 
+                            argv[0], optarg);
+                    usageErrorMsg();
+                }
+                options.profile = parse_profile(optarg);
+                break;
+
+            /* Listen backlog of the server's TCP socket */
+            case 'l' : 
+                if (client) { 
+                    printf("\nERROR: %s: Unrecognized client option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                if (checkInteger(optarg)) {
+                    options.backlog = atoi(optarg);
+                }
+                break;
+
+            /* Statistics endpoint: a local TCP port or a UNIX socket path */
+            case 'e' : 
+                if (client) { 
+                    printf("\nERROR: %s: Unrecognized client option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                options.admin = optarg;
+                break;
+
+            /* Quiet: no output per request */
+            case 'q' : 
+                if (client) { 
+                    printf("\nERROR: %s: Unrecognized client option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                options.quiet = true;
+                break;
+
+            /* Packets sent on one connection, or the server's pool threads */
+            case 'n' : 
+                if (checkInteger(optarg)) {
+                    if (client) options.count = strtoul(optarg, NULL, 10);
+                    else options.pool = atoi(optarg);
+                }
+                counted = true;
+                break;
+
+            /* Number of packets in flight (pipeline depth) */
+            case 'k' : 
+                if (!client) { 
+                    printf("\nERROR: %s: Unrecognized server option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                if (checkInteger(optarg)) {
+                    options.depth = strtoul(optarg, NULL, 10);
+                }
+                windowed = true;
+                break;
+
+            /* Server limits: connections at once and requests/s per client */
+            case 'c' : 
+            case 'r' : 
+                if (!client) {
+                    if (checkInteger(optarg)) {
+                        if (opt == 'c') options.max_conns = atoi(optarg);
+                        if (opt == 'r') options.rate = strtoul(optarg, NULL, 10);
+                    }
+                    break;
+                }
+                /* fall through */
+
+            /* Benchmark connections, request rate and duration, and the
+               delay between connection attempts */
+            case 'd' : 
+            case 'a' : 
+                if (!client) { 
+                    printf("\nERROR: %s: Unrecognized server option: '-%c'\n", 
+                            argv[0], opt);
+                    usageErrorMsg();
+                }
+                if (checkInteger(optarg)) {
+                    if (opt == 'c') options.connections = strtoul(optarg, NULL, 10);
+                    if (opt == 'r') options.rate = strtoul(optarg, NULL, 10);
+                    if (opt == 'd') options.duration = strtoul(optarg, NULL, 10);
+                    if (opt == 'a') options.attempt_delay = strtoul(optarg, NULL, 10);
+                }
                 break;
 
             /* Error: An option has no argument */
@@ -96,13 +265,17 @@ struct cmdline parser(int argc, char* argv[], int client) {
     }
 
     /* Too many command-line arguments are selected */
-    if ((numopts > 4 && client) || (numopts > 2 && !client)) {
+    if ((numopts > 16 && client) || (numopts > 15 && !client)) {
         printf("\nERROR: %s: Too many options\n", argv[0]);
         usageErrorMsg();
     }
 
-    /* Command-line arguments are missing */
-    if (numopts < 4 && client) {
+    /* Command-line arguments are missing ('-x' is optional for a benchmark
+       and for a bulk or reliable transfer of a file) */
+    if ((required < 4 && client && strcmp(options.mode, "bench") && 
+         !((!strcmp(options.mode, "bulk") || !strcmp(options.mode, "rudp")) && 
+           options.file != NULL)) || 
+        (required < 3 && client) || (required < 2 && !client)) {
         printf("\nERROR: %s: Not enough options selected\n", argv[0]);
         usageErrorMsg();
     }
@@ -120,11 +293,116 @@ struct cmdline parser(int argc, char* argv[], int client) {
         printf("\tSelect a port number between: 1025 to 65535\n");
         usageErrorMsg();
     }
-    /* The socket type is not 'udp' or 'tcp' */
-    if (!(!strcmp(options.socktype, "udp") ^ !strcmp(options.socktype, "tcp"))) {
+    /* The socket type is not 'udp', 'tcp' or 'shm' */
+    if (strcmp(options.socktype, "udp") && strcmp(options.socktype, "tcp") &&
+        strcmp(options.socktype, "shm")) {
         printf("\nERROR: %s: socket type \"%s\" not allowed\n", argv[0], options.socktype);
         usageErrorMsg();
     }
+    /* The client mode is not 'send', 'bench', 'bulk' or 'rudp' */
+    if (client && strcmp(options.mode, "send") && strcmp(options.mode, "bench") &&
+        strcmp(options.mode, "bulk") && strcmp(options.mode, "rudp")) {
+        printf("\nERROR: %s: client mode \"%s\" not allowed\n", argv[0], options.mode);
+        usageErrorMsg();
+    }
+    /* A benchmark must not send the termination number */
+    if (client && !strcmp(options.mode, "bench")) {
+        if (required < 4) {
+            options.data = 1;
+        }
+        if (!counted) {
+            options.count = 0;   // Keep every benchmark connection open
+        }
+        if (options.data == 0 || options.connections < 1 || 
+            options.connections > MAXBENCHCONNS || options.duration < 1 ||
+            !strcmp(options.socktype, "shm")) {
+            printf("\nERROR: %s: a benchmark needs TCP or UDP, nonzero data, 1 to %d "
+                   "connections and a duration of at least 1 second\n", argv[0], MAXBENCHCONNS);
+            usageErrorMsg();
+        }
+    }
+    /* A bulk transfer needs TCP, a payload and a known method */
+    if (client && !strcmp(options.mode, "bulk") && (strcmp(options.socktype, "tcp") ||
+        (options.file == NULL && options.data == 0) || 
+        (strcmp(options.method, "copy") && strcmp(options.method, "sendfile") &&
+         strcmp(options.method, "splice") && strcmp(options.method, "zerocopy")))) {
+        printf("\nERROR: %s: a bulk transfer needs TCP, a '-f' file or '-x' bytes, and a "
+               "method: copy, sendfile, splice or zerocopy\n", argv[0]);
+        usageErrorMsg();
+    }
+    /* A reliable transfer needs UDP, a payload and a window of 1 to 
+       RUDP_WINDOW segments */
+    if (client && !strcmp(options.mode, "rudp")) {
+        if (!windowed) {
+            options.depth = RUDP_WINDOW;
+        }
+        if (strcmp(options.socktype, "udp") || (options.file == NULL && options.data == 0) ||
+            options.depth > RUDP_WINDOW) {
+            printf("\nERROR: %s: a reliable transfer needs UDP, a '-f' file or '-x' bytes, "
+                   "and a '-k' window of 1 to %d segments\n", argv[0], RUDP_WINDOW);
+            usageErrorMsg();
+        }
+    }
+    if (!client && strcmp(options.method, "copy") && strcmp(options.method, "splice")) {
+        printf("\nERROR: %s: bulk receive method \"%s\" not allowed\n", argv[0], 
+                options.method);
+        usageErrorMsg();
+    }
+    /* The server mode is not 'fork', 'epoll' or 'pool' */
+    if (!client && strcmp(options.mode, "fork") && strcmp(options.mode, "epoll") &&
+        strcmp(options.mode, "pool")) {
+        printf("\nERROR: %s: server mode \"%s\" not allowed\n", argv[0], options.mode);
+        usageErrorMsg();
+    }
+    /* The packet count or pipeline depth is out of range */
+    if (client && ((options.count < 1 && strcmp(options.mode, "bench")) || 
+                   options.depth < 1 || options.depth > MAXDEPTH)) {
+        printf("\nERROR: %s: select at least 1 packet and a depth of 1 to %d\n", 
+                argv[0], MAXDEPTH);
+        usageErrorMsg();
+    }
+    if (client && strcmp(options.socktype, "tcp") && strcmp(options.socktype, "shm") &&
+        strcmp(options.mode, "rudp") &&
+        (strcmp(options.mode, "bench") ? options.count > 1 : options.count > 0)) {
+        printf("\nERROR: %s: '-n' and '-k' require a TCP or shared memory connection\n",
+               argv[0]);
+        usageErrorMsg();
+    }
+    /* The batch size is out of range */
+    if ((!client && options.batch < 1) || options.batch > MAXBATCH) {
+        printf("\nERROR: %s: batch size %d not allowed, select 1 to %d\n", 
+                argv[0], options.batch, MAXBATCH);
+        usageErrorMsg();
+    }
+    /* The pool size is out of range or given without pool mode */
+    if (!client && !strcmp(options.mode, "pool") && !counted) {
+        options.pool = POOL_THREADS;
+    }
+    if (!client && (counted && (strcmp(options.mode, "pool") || 
+                                options.pool < 1 || options.pool > MAXPOOL))) {
+        printf("\nERROR: %s: '-n' selects 1 to %d pool threads with '-m pool'\n", 
+                argv[0], MAXPOOL);
+        usageErrorMsg();
+    }
+    /* The packet version is framed by the server like PROTO_PERSISTENT */
+    if (client && (options.version == 0 || options.version == PROTO_SINGLE || 
+                   options.version == PROTO_BULK)) {
+        printf("\nERROR: %s: '-v' selects packet version 2 or 4 to 255\n", argv[0]);
+        usageErrorMsg();
+    }
+    /* Compute threads are out of range or given without an event loop */
+    if (!client && (options.compute > MAXCOMPUTE || (options.compute > 0 && 
+        strcmp(options.mode, "epoll") && options.workers == 0))) {
+        printf("\nERROR: %s: '-j' selects 1 to %d compute threads with '-m epoll' "
+               "or '-w'\n", argv[0], MAXCOMPUTE);
+        usageErrorMsg();
+    }
+    /* The worker count is out of range */
+    if (!client && options.workers > MAXWORKERS) {
+        printf("\nERROR: %s: %d workers not allowed, select 1 to %d\n", 
+                argv[0], options.workers, MAXWORKERS);
+        usageErrorMsg();
+    }
     
     return options;
 }
@@ -177,12 +455,56 @@ void usageErrorMsg() {
     printf("\nUsage: [-OPTION] [VALUE]\n");
     printf("Client program creates messages and sends them to a server.\n\n");
     printf("\t-x <data> \t\t 32-bit unsigned integer message\n");
-    printf("\t-t <tcp> or <udp> \t server connection protocol\n");
-    printf("\t-s <ip> \t\t IPv4 address of the server\n");
-    printf("\t-p <number> \t\t port number used by the server\n\n");
+    printf("\t-t <tcp>, <udp>, <shm> \t server connection protocol, shm: shared memory\n");
+    printf("\t\t\t\t with a server on this host, otherwise TCP\n");
+    printf("\t-s <ip> \t\t address or hostname of the server, or a comma\n");
+    printf("\t\t\t\t separated list of them (IPv4 and IPv6)\n");
+    printf("\t-p <number> \t\t port number used by the server\n");
+    printf("\t-n <number> \t\t (optional) packets sent on one TCP connection\n");
+    printf("\t\t\t\t (benchmark: requests per connection, default: keep open)\n");
+    printf("\t-k <number> \t\t (optional) packets in flight at once (pipeline depth)\n");
+    printf("\t-b <number> \t\t (optional) packets per sendmsg(), default: a window\n");
+    printf("\t-m <send>, <bench> \t (optional) send one message, run a benchmark\n");
+    printf("\t   or <bulk> \t\t or send '-n' bulk transfers of '-x' bytes\n");
+    printf("\t   or <rudp> \t\t or send them reliably over UDP ('-k' segments\n");
+    printf("\t\t\t\t in flight, default: %d)\n", RUDP_WINDOW);
+    printf("\t-f <file> \t\t (optional) bulk transfer this file instead\n");
+    printf("\t-z <method> \t\t (optional) bulk send: copy, sendfile, splice, zerocopy\n");
+    printf("\t-c <number> \t\t (optional) benchmark connections\n");
+    printf("\t-r <number> \t\t (optional) benchmark requests per second, 0: closed-loop\n");
+    printf("\t-d <seconds> \t\t (optional) benchmark duration\n");
+    printf("\t-v <version> \t\t (optional) version of '-n' and benchmark packets,\n");
+    printf("\t\t\t\t 4: CPU work of '-x' rounds (default: %d)\n", PROTO_PERSISTENT);
+    printf("\t-a <ms> \t\t (optional) start a connection to the next address\n");
+    printf("\t\t\t\t after this delay (default: %d), 0: one at a time\n",
+           CONNECT_DELAY_MS);
+    printf("\t-o <profile> \t\t (optional) TCP socket options: default, latency\n");
+    printf("\t\t\t\t or throughput\n\n");
     printf("Server program receives messages from a client.\n\n");
-    printf("\t-t <tcp> or <udp> \t protocol for incoming connections\n");
-    printf("\t-p <number> \t\t port number to listen for messages\n\n");
+    printf("\t-t <tcp>, <udp>, <shm> \t protocol for incoming connections, shm: TCP\n");
+    printf("\t\t\t\t and shared memory for clients on this host\n");
+    printf("\t-p <number> \t\t port number to listen for messages\n");
+    printf("\t-m <fork>, <epoll> \t (optional) fork per reply, epoll event loop\n");
+    printf("\t   or <pool> \t\t or a pool of threads started at launch\n");
+    printf("\t-n <number> \t\t (optional) pool threads (default: %d)\n", POOL_THREADS);
+    printf("\t-w <number> \t\t (optional) epoll worker threads sharing the port\n");
+    printf("\t-j <number> \t\t (optional) compute threads for expensive requests\n");
+    printf("\t-b <number> \t\t (optional) UDP datagrams per recvmmsg()/sendmmsg()\n");
+    printf("\t-z <method> \t\t (optional) bulk receive: splice or copy\n");
+    printf("\t-f <file> \t\t (optional) write reliable UDP payloads to this file,\n");
+    printf("\t\t\t\t and bulk payloads to <file>.<pid>.<n>\n");
+    printf("\t-l <number> \t\t (optional) listen backlog (default: %d with '-m fork',\n",
+           BACKLOG);
+    printf("\t\t\t\t otherwise SOMAXCONN)\n");
+    printf("\t-c <number> \t\t (optional) connections served at once; more are\n");
+    printf("\t\t\t\t rejected (reply %d)\n", REPLY_REJECTED);
+    printf("\t-r <number> \t\t (optional) requests/s per client address; more are\n");
+    printf("\t\t\t\t rejected (reply %d)\n", REPLY_REJECTED);
+    printf("\t-e <port> or <path> \t (optional) serve statistics on 127.0.0.1:port\n");
+    printf("\t\t\t\t or on a UNIX socket, as text or JSON\n");
+    printf("\t-o <profile> \t\t (optional) TCP socket options: default, latency\n");
+    printf("\t\t\t\t or throughput\n");
+    printf("\t-q \t\t\t (optional) quiet: print nothing per request\n\n");
     exit(0);
 }
 
@@ -221,6 +543,38 @@ int sendall(int s, char* buf, int* len) {
     return n == -1 ? -1 : 0;  // return -1 on failure, 0 on success
 }
 
+/*  
+ *  recvall
+ * 
+ *  Description:
+ *    The receiving side of sendall(): TCP is a byte stream, so one
+ *    recv() may return only part of a packet. Call recv() until 
+ *    'len' bytes have arrived, the peer closes the connection, or
+ *    an error occurs.
+ *  
+ *  Use:
+ *    Called by the client and server programs when reading whole
+ *    packets or replies via TCP. 'len' is set to the number of bytes
+ *    actually receieved. Returns -1 on failure, 0 otherwise.
+ */
+int recvall(int s, char* buf, int* len) {
+
+    int total = 0;          // Running total of bytes receieved
+    int n = 0;
+
+    while (total < *len) {
+        if ((n = recv(s, buf+total, *len - total, 0)) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (n == 0) break;  // Peer closed the connection
+        total += n;
+    }
+
+    *len = total; // len indicates total bytes actually receieved
+    return n == -1 ? -1 : 0;
+}
+
 /*  
  *  init_sigchld_handler
  * 
@@ -264,13 +618,13 @@ void init_sigchld_handler(struct sigaction* sa) {
 void init_hints(struct addrinfo* hints, char* socktype, int client) {
 
     memset(hints, 0, sizeof(*hints));        // Empty the addrinfo struct
-    hints -> ai_family = AF_INET;            // IPv4 socket addresses
+    hints -> ai_family = AF_UNSPEC;          // IPv4 and IPv6 socket addresses
 
     if (!client) {
         hints -> ai_flags = AI_PASSIVE;      // Server socket address flag
     }
-    if (strncmp(socktype, "tcp", 3) == 0) {
-        hints -> ai_socktype = SOCK_STREAM;  // TCP socket selected
+    if (strncmp(socktype, "tcp", 3) == 0 || strncmp(socktype, "shm", 3) == 0) {
+        hints -> ai_socktype = SOCK_STREAM;  // TCP socket selected (shm.c falls back to it)
     } 
     if (strncmp(socktype, "udp", 3) == 0) {
         hints -> ai_socktype = SOCK_DGRAM;   // UDP socket selected
@@ -300,13 +654,15 @@ void sigchld_handler(UNUSED_PARAM int s) {
     /* Wait for a child to exit and check exit status */
     while(waitpid(-1, &status, WNOHANG | WUNTRACED) > 0) {
         
-        /* Child terminated normally */
+        /* Child terminated normally (printf() is not async-signal-safe) */
         if (WIFEXITED(status)) {
-            printf("[Success] Server request completed.\n");
+            static const char done[] = "[Success] Server request completed.\n";
+            write(STDOUT_FILENO, done, sizeof(done) - 1);
         }
         /* Child did not terminate normally */
         else {
-            perror("[Error] Server request exit");
+            static const char fail[] = "[Error] Server request exit\n";
+            write(STDERR_FILENO, fail, sizeof(fail) - 1);
         }
     }
     errno = saved_errno;
@@ -316,10 +672,10 @@ void sigchld_handler(UNUSED_PARAM int s) {
  *  get_sock_ip
  * 
  *  Description:
- *     Get a pointer to a socket's IPv4 address by casting
+ *     Get a pointer to a socket's IPv4 or IPv6 address by casting
  *     the argument struct sockaddr to the parallel struct
- *     sockaddr_in, and then accessing the sin_addr, the 
- *     socket's internet address.
+ *     sockaddr_in (or sockaddr_in6), and then accessing the 
+ *     sin_addr (sin6_addr), the socket's internet address.
  * 
  *  Use: 
  *     Called by the server and client programs to be passed
@@ -330,5 +686,135 @@ void sigchld_handler(UNUSED_PARAM int s) {
  *          (pages 33 to 35)
  */ 
 void* get_sock_ip(struct sockaddr* socket_address_info) {
+    if (socket_address_info -> sa_family == AF_INET6) {
+        return &(((struct sockaddr_in6*)socket_address_info)->sin6_addr);
+    }
     return &(((struct sockaddr_in*)socket_address_info)->sin_addr);
 }
+
+/* 
+ *  set_nonblocking
+ * 
+ *  Description:
+ *     Add O_NONBLOCK to a file descriptor's status flags so that
+ *     accept(), recv() and send() return EAGAIN instead of 
+ *     blocking when no progress can be made.
+ * 
+ *  Use: 
+ *     Called by the event loop on the listening socket and on 
+ *     every accepted connection. Returns -1 on failure.
+ */ 
+int set_nonblocking(int fd) {
+
+    int flags;
+
+    if ((flags = fcntl(fd, F_GETFL, 0)) == -1) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/*  
+ *  bind_socket
+ * 
+ *  Description:
+ *    Walk the addrinfo list for the server port until a socket of
+ *    the given type can be created and bound. IPv6 addresses are
+ *    tried first with IPV6_V6ONLY cleared, so one socket also takes
+ *    IPv4 clients (as ::ffff:a.b.c.d); IPv4 is the fallback on a host
+ *    without IPv6. SO_REUSEADDR is always set; SO_REUSEPORT is set 
+ *    when several sockets must bind the same port, so the kernel 
+ *    spreads new connections and datagrams across them.
+ *  
+ *  Use:
+ *    Called by the server program and by each worker thread.
+ *    Returns the bound socket, or -1 on failure.
+ * 
+ *  SOURCE: Beej's Guide to Network Programming 2019 
+ *          (pages 29 to 30)
+ */
+int bind_socket(char* port, int socktype, bool reuseport) {
+
+    struct addrinfo hints, *serverInfo, *cursor = NULL;
+    int ret, pass, sock = -1, set = 1, unset = 0;
+
+    init_hints(&hints, socktype == SOCK_STREAM ? "tcp" : "udp", SERVER);
+
+    /* Create a list of addrinfo structures for the server program */
+    if ((ret = getaddrinfo(NULL, port, &hints, &serverInfo)) != 0) {
+        fprintf(stderr, "[Server Program]: getaddrinfo: %s\n", gai_strerror(ret));
+        return -1;
+    }
+
+    /* Loop through addrinfo structs until a socket can be created and bound,
+       the IPv6 ones on the first pass */
+    for (pass = 0; pass < 2 && cursor == NULL; pass++) {
+        for (cursor = serverInfo; cursor != NULL; cursor = cursor -> ai_next) {
+
+            if ((cursor -> ai_family == AF_INET6) != (pass == 0)) {
+                continue;
+            }
+
+            /* Create a server socket */
+            if ((sock = socket(cursor -> ai_family, cursor -> ai_socktype, 
+                               cursor -> ai_protocol)) == -1) {
+                perror("[Server Program]: socket");
+                continue;
+            }
+
+            /* Set the socket options to reuse the socket address (and port) */
+            if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &set, sizeof(int)) == -1 ||
+                (reuseport && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &set, 
+                                         sizeof(int)) == -1)) {
+                close(sock);
+                perror("[Server Program]: setsockopt");
+                continue;
+            }
+
+            /* Accept IPv4 clients on an IPv6 socket too */
+            if (cursor -> ai_family == AF_INET6 &&
+                setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &unset, sizeof(int)) == -1) {
+                close(sock);
+                perror("[Server Program]: setsockopt");
+                continue;
+            }
+
+            /* Bind the server socket */
+            if (bind(sock, cursor -> ai_addr, cursor -> ai_addrlen) == -1) {
+                close(sock);
+                perror("[Server Program]: bind");
+                continue;
+            }
+            break;
+        }
+    }
+    freeaddrinfo(serverInfo);
+
+    /* The socket failed to bind */
+    if (cursor == NULL) {
+        fprintf(stderr, "[Server Program]: failed to bind socket\n");
+        return -1;
+    }
+    return sock;
+}
+
+/*  
+ *  udp_reply
+ * 
+ *  Description:
+ *    Build the reply to a UDP request of 'len' bytes at 'dgram' in
+ *    'out' (UDP_REPLYSIZE bytes): the reply byte, then the request's
+ *    tag if it carried one. Returns the length of the reply.
+ *  
+ *  Use:
+ *    Called by every UDP server loop before it sends a reply.
+ */
+size_t udp_reply(uint8_t* out, uint8_t reply, const char* dgram, size_t len) {
+
+    out[0] = reply;
+    if (len < UDP_REQUESTSIZE) {
+        return 1;
+    }
+    memcpy(out + 1, dgram + sizeof(struct packet), UDP_TAGSIZE);
+    return UDP_REPLYSIZE;
+}
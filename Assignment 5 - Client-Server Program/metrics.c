@@ -0,0 +1,437 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  SERVER METRICS and the statistics endpoint ('-e <port|path>')
+ *
+ *  Every serving mode counts accepted and closed connections, TCP
+ *  and UDP requests, bytes in and out and errors, and records two
+ *  latencies per request into log-linear histograms (stats.c):
+ *
+ *      queue time      from the moment the server has a request (its
+ *                      connection accepted or its bytes read) until
+ *                      a thread starts on it
+ *      service time    how long the handler (or a bulk receive) ran
+ *
+ *  The counters live in shared memory, so the children of the fork()
+ *  server add to the same ones as their parent. They are split into
+ *  METRIC_SHARDS copies on separate cache lines, and a reader sums
+ *  the copies. Each of the first threads (or fork() children) to
+ *  record anything gets a copy of its own, which it updates with
+ *  plain relaxed loads and stores: no lock, and not even a locked
+ *  instruction. Once those run out, the remaining threads share the
+ *  last copy and update it with relaxed atomic adds.
+ *
+ *  With '-e' a thread of the server answers every connection to a
+ *  local TCP port (127.0.0.1) or UNIX socket with one snapshot of the
+ *  metrics, as "name value" lines or, if the request mentions "json",
+ *  as one JSON object. A request starting with "GET" gets an HTTP/1.0
+ *  reply, so both of these work:
+ *
+ *      curl http://127.0.0.1:9000/json
+ *      echo json | nc -U /tmp/server.sock
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static struct metrics* metrics;        // Shared with the fork() children
+static __thread int shard = -1;        // This thread's copy of the counters
+static int admin_sock = -1;
+static pid_t admin_pid;
+static char admin_path[sizeof(((struct sockaddr_un*)0) -> sun_path)];
+
+static const char* counter_names[MC_COUNT] = {
+    "accepts", "closes", "tcp_requests", "udp_requests", "bytes_in", "bytes_out", "errors",
+    "rejected_connections", "rejected_requests", "shm_requests"
+};
+static const char* timing_names[MT_COUNT] = { "queue_time", "service_time" };
+
+static struct metric_shard* my_shard(void);
+static void shard_add(atomic_ulong* counter, unsigned long n);
+static void metrics_snapshot(struct metrics_snapshot* snap);
+static int format_text(const struct metrics_snapshot* snap, char* buf, size_t size);
+static int format_json(const struct metrics_snapshot* snap, char* buf, size_t size);
+static void* admin_routine(void* arg);
+static void answer_admin(int fd);
+static void remove_admin_path(void);
+
+/*
+ *  metrics_init
+ *
+ *  Description:
+ *    Map the shared, zeroed counters and start the uptime clock.
+ *
+ *  Use:
+ *    Called once by the server program before it serves anything.
+ *    Returns -1 on failure.
+ */
+int metrics_init(void) {
+
+    if ((metrics = mmap(NULL, sizeof(struct metrics), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        perror("[Server Program]: mmap");
+        metrics = NULL;
+        return -1;
+    }
+    metrics -> started = now_ns();
+    return 0;
+}
+
+/*
+ *  metric_add
+ *
+ *  Description:
+ *    Add 'n' to a counter in this thread's shard.
+ */
+void metric_add(enum metric_counter c, unsigned long n) {
+    shard_add(&my_shard() -> counters[c], n);
+}
+
+/*
+ *  metric_time
+ *
+ *  Description:
+ *    Record one latency (in nanoseconds) in this thread's shard: its
+ *    histogram bucket, the running sum for the mean, and the largest
+ *    value seen. In the shared shard the largest value is raised with
+ *    a compare-and-swap.
+ */
+void metric_time(enum metric_timing t, uint64_t ns) {
+
+    struct metric_shard* s = my_shard();
+    unsigned long max;
+
+    shard_add(&s -> buckets[t][hist_index(ns)], 1);
+    shard_add(&s -> sums[t], ns);
+    max = atomic_load_explicit(&s -> maxes[t], memory_order_relaxed);
+    if (shard < METRIC_SHARDS - 1) {
+        if (ns > max) atomic_store_explicit(&s -> maxes[t], ns, memory_order_relaxed);
+        return;
+    }
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&s -> maxes[t], &max, ns,
+                                                               memory_order_relaxed,
+                                                               memory_order_relaxed));
+}
+
+/*
+ *  start_admin
+ *
+ *  Description:
+ *    Listen on 'endpoint' and answer it from a detached thread. A
+ *    number is a TCP port on 127.0.0.1, anything else the path of a
+ *    UNIX socket, which is replaced if it exists and removed when the
+ *    server exits.
+ *
+ *  Use:
+ *    Called by the server program for '-e'. Returns -1 on failure.
+ */
+int start_admin(const char* endpoint) {
+
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+    struct sockaddr* addr;
+    socklen_t addrlen;
+    pthread_t tid;
+    int err, yes = 1;
+
+    if (strspn(endpoint, "0123456789") == strlen(endpoint)) {
+        memset(&in, 0, sizeof(in));
+        in.sin_family = AF_INET;
+        in.sin_port = htons(atoi(endpoint));
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr = (struct sockaddr*)&in;
+        addrlen = sizeof(in);
+    }
+    else {
+        if (strlen(endpoint) >= sizeof(un.sun_path)) {
+            fprintf(stderr, "[Server Program]: statistics socket path is too long\n");
+            return -1;
+        }
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strcpy(un.sun_path, endpoint);
+        unlink(endpoint);
+        addr = (struct sockaddr*)&un;
+        addrlen = sizeof(un);
+    }
+
+    if ((admin_sock = socket(addr -> sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+        perror("[Server Program]: socket");
+        return -1;
+    }
+    setsockopt(admin_sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(admin_sock, addr, addrlen) == -1 || listen(admin_sock, BACKLOG) == -1) {
+        perror("[Server Program]: statistics endpoint");
+        close(admin_sock);
+        admin_sock = -1;
+        return -1;
+    }
+    if (addr -> sa_family == AF_UNIX) {
+        strcpy(admin_path, endpoint);
+        admin_pid = getpid();
+        atexit(remove_admin_path);
+    }
+
+    if ((err = pthread_create(&tid, NULL, admin_routine, NULL)) != 0) {
+        errno = err;
+        perror("[Server Program]: pthread_create");
+        return -1;
+    }
+    pthread_detach(tid);
+    printf("[Server Program]: Statistics on %s%s\n",
+           addr -> sa_family == AF_UNIX ? "" : "127.0.0.1:", endpoint);
+    return 0;
+}
+
+/*
+ *  metrics_child
+ *
+ *  Description:
+ *    A fork() child does not answer the statistics endpoint: close
+ *    its copy of the listening socket, so the endpoint goes away with
+ *    the server and not with its last child. The child must not write
+ *    to its parent's shard, so it takes a shard of its own.
+ */
+void metrics_child(void) {
+    shard = -1;
+    if (admin_sock != -1) {
+        close(admin_sock);
+        admin_sock = -1;
+    }
+}
+
+/*
+ *  my_shard
+ *
+ *  Description:
+ *    The shard of the calling thread, handed out in order the first
+ *    time a thread records anything. The last shard is shared by every
+ *    thread that comes after the others are taken.
+ */
+static struct metric_shard* my_shard(void) {
+
+    int next;
+
+    if (shard == -1) {
+        next = atomic_fetch_add(&metrics -> next_shard, 1);
+        shard = next < METRIC_SHARDS - 1 ? next : METRIC_SHARDS - 1;
+    }
+    return &metrics -> shards[shard];
+}
+
+/*
+ *  shard_add
+ *
+ *  Description:
+ *    Add 'n' to a counter of the calling thread's shard. Only this
+ *    thread writes to its own shard, so a relaxed load and store is 
+ *    enough; readers see either the old or the new count. The shared
+ *    shard needs an atomic add.
+ */
+static void shard_add(atomic_ulong* counter, unsigned long n) {
+    if (shard < METRIC_SHARDS - 1) {
+        atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                              memory_order_relaxed);
+    }
+    else {
+        atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+    }
+}
+
+/*
+ *  metrics_snapshot
+ *
+ *  Description:
+ *    Sum every shard into 'snap'. The counters are read one at a time
+ *    while the server runs, so a snapshot is not a single instant, but
+ *    no count is lost or read twice.
+ */
+static void metrics_snapshot(struct metrics_snapshot* snap) {
+
+    struct metric_shard* s;
+    unsigned long count, max;
+    int i, t, b;
+
+    memset(snap, 0, sizeof(*snap));
+    snap -> uptime = (now_ns() - metrics -> started) / 1e9;
+    for (t = 0; t < MT_COUNT; t++) {
+        hist_init(&snap -> timings[t]);
+    }
+    for (i = 0; i < METRIC_SHARDS; i++) {
+        s = &metrics -> shards[i];
+        for (t = 0; t < MC_COUNT; t++) {
+            snap -> counters[t] += atomic_load_explicit(&s -> counters[t],
+                                                        memory_order_relaxed);
+        }
+        for (t = 0; t < MT_COUNT; t++) {
+            for (b = 0; b < HIST_BUCKETS; b++) {
+                if ((count = atomic_load_explicit(&s -> buckets[t][b],
+                                                  memory_order_relaxed)) == 0) {
+                    continue;
+                }
+                snap -> timings[t].counts[b] += count;
+                snap -> timings[t].total += count;
+            }
+            snap -> sums[t] += atomic_load_explicit(&s -> sums[t], memory_order_relaxed);
+            max = atomic_load_explicit(&s -> maxes[t], memory_order_relaxed);
+            if (max > snap -> timings[t].max) snap -> timings[t].max = max;
+        }
+    }
+
+    /* The smallest value is known to within its bucket */
+    for (t = 0; t < MT_COUNT; t++) {
+        for (b = 0; b < HIST_BUCKETS && snap -> timings[t].counts[b] == 0; b++);
+        if (b < HIST_BUCKETS) {
+            snap -> timings[t].min = b == 0 ? 0 : hist_bucket_value(b - 1) + 1;
+        }
+    }
+    snap -> active = (long)(snap -> counters[MC_ACCEPTS] - snap -> counters[MC_CLOSES]);
+}
+
+/*
+ *  format_text
+ *
+ *  Description:
+ *    Write a snapshot as "name value" lines, latencies in microseconds.
+ *    Returns the length written.
+ */
+static int format_text(const struct metrics_snapshot* snap, char* buf, size_t size) {
+
+    const struct histogram* h;
+    int len, t;
+
+    len = snprintf(buf, size, "uptime_seconds %.3f\n", snap -> uptime);
+    for (t = 0; t < MC_COUNT; t++) {
+        len += snprintf(buf + len, size - len, "%s %lu\n", counter_names[t],
+                        snap -> counters[t]);
+    }
+    len += snprintf(buf + len, size - len, "active_connections %ld\n", snap -> active);
+    for (t = 0; t < MT_COUNT; t++) {
+        h = &snap -> timings[t];
+        len += snprintf(buf + len, size - len,
+                        "%s_count %lu\n%s_mean_us %.3f\n%s_p50_us %.3f\n%s_p90_us %.3f\n"
+                        "%s_p99_us %.3f\n%s_p999_us %.3f\n%s_max_us %.3f\n",
+                        timing_names[t], (unsigned long)h -> total,
+                        timing_names[t], h -> total ? snap -> sums[t] / 1e3 / h -> total : 0,
+                        timing_names[t], hist_percentile(h, 0.50) / 1e3,
+                        timing_names[t], hist_percentile(h, 0.90) / 1e3,
+                        timing_names[t], hist_percentile(h, 0.99) / 1e3,
+                        timing_names[t], hist_percentile(h, 0.999) / 1e3,
+                        timing_names[t], h -> max / 1e3);
+    }
+    return len;
+}
+
+/*
+ *  format_json
+ *
+ *  Description:
+ *    Write a snapshot as one JSON object, latencies in microseconds.
+ *    Returns the length written.
+ */
+static int format_json(const struct metrics_snapshot* snap, char* buf, size_t size) {
+
+    const struct histogram* h;
+    int len, t;
+
+    len = snprintf(buf, size, "{\"uptime_seconds\": %.3f", snap -> uptime);
+    for (t = 0; t < MC_COUNT; t++) {
+        len += snprintf(buf + len, size - len, ", \"%s\": %lu", counter_names[t],
+                        snap -> counters[t]);
+    }
+    len += snprintf(buf + len, size - len, ", \"active_connections\": %ld", snap -> active);
+    for (t = 0; t < MT_COUNT; t++) {
+        h = &snap -> timings[t];
+        len += snprintf(buf + len, size - len,
+                        ", \"%s_us\": {\"count\": %lu, \"mean\": %.3f, \"p50\": %.3f, "
+                        "\"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}",
+                        timing_names[t], (unsigned long)h -> total,
+                        h -> total ? snap -> sums[t] / 1e3 / h -> total : 0,
+                        hist_percentile(h, 0.50) / 1e3, hist_percentile(h, 0.90) / 1e3,
+                        hist_percentile(h, 0.99) / 1e3, hist_percentile(h, 0.999) / 1e3,
+                        h -> max / 1e3);
+    }
+    len += snprintf(buf + len, size - len, "}\n");
+    return len;
+}
+
+/*
+ *  admin_routine
+ *
+ *  Description:
+ *    Thread routine of the statistics endpoint: answer one connection
+ *    at a time until the server exits.
+ */
+static void* admin_routine(UNUSED_PARAM void* arg) {
+
+    int fd;
+
+    while (1) {
+        if ((fd = accept(admin_sock, NULL, NULL)) == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("[Server Program]: accept (statistics)");
+            return NULL;
+        }
+        answer_admin(fd);
+        close(fd);
+    }
+}
+
+/*
+ *  answer_admin
+ *
+ *  Description:
+ *    Read the request (whatever arrives within a second, possibly
+ *    nothing) and send one snapshot back in the format it asks for.
+ */
+static void answer_admin(int fd) {
+
+    struct metrics_snapshot snap;
+    struct timeval tv = { .tv_sec = 1 };
+    char request[512], body[ADMIN_BUFSIZE], head[128];
+    bool json, http;
+    ssize_t n, off;
+    int len, headlen = 0;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if ((n = recv(fd, request, sizeof(request) - 1, 0)) < 0) {
+        n = 0;
+    }
+    request[n] = '\0';
+    json = strstr(request, "json") != NULL;
+    http = !strncmp(request, "GET", 3);
+
+    metrics_snapshot(&snap);
+    len = json ? format_json(&snap, body, sizeof(body))
+               : format_text(&snap, body, sizeof(body));
+    if (http) {
+        headlen = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+                           "Content-Length: %d\r\n\r\n",
+                           json ? "application/json" : "text/plain", len);
+        send(fd, head, headlen, MSG_NOSIGNAL | MSG_MORE);
+    }
+    for (off = 0; off < len; off += n) {
+        if ((n = send(fd, body + off, len - off, MSG_NOSIGNAL)) == -1) {
+            if (errno == EINTR) {
+                n = 0;
+                continue;
+            }
+            return;
+        }
+    }
+}
+
+/*
+ *  remove_admin_path
+ *
+ *  Description:
+ *    atexit() handler removing the UNIX socket of the endpoint. The
+ *    fork() children run it too when they exit, so it only acts in
+ *    the process that created the socket.
+ */
+static void remove_admin_path(void) {
+    if (getpid() == admin_pid) {
+        unlink(admin_path);
+    }
+}
@@ -0,0 +1,410 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  CONNECTION POOL used by the server program ('-m pool')
+ *
+ *  The fork() server pays for a new process, and a SIGCHLD, on every
+ *  connection. In pool mode the main thread only accepts: every new
+ *  connection is put on a bounded queue (the producer/consumer buffer
+ *  of assignment 3) and one of '-n' threads started at launch takes
+ *  it off the queue and serves it with blocking recvall()/sendall().
+ *
+ *  Shutdown (a termination number 0, SIGINT or SIGTERM) drains the
+ *  pool: no new connections are accepted, every connection already
+ *  queued is still served (if its client sends its first packet
+ *  within POOL_FIRST_MS), and idle persistent clients are closed
+ *  once the packets they already sent are answered.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static struct pool* signal_pool;   // The pool stopped by SIGINT or SIGTERM
+
+static void* pool_routine(void* arg);
+static void serve_pool_connection(struct pool_thread* self, int fd, uint64_t client);
+static bool begin_idle(struct pool_thread* self, int fd, bool first);
+static void end_idle(struct pool_thread* self);
+static void request_drain(struct pool* pool);
+static void drain_signal_handler(int s);
+static void pool_enqueue(struct conn_queue* queue, int fd, uint64_t client);
+static int pool_dequeue(struct conn_queue* queue, uint64_t* accepted, uint64_t* client);
+
+/*
+ *  run_pool
+ *
+ *  Description:
+ *    Start the pool threads, accept connections into the queue until
+ *    a drain is requested, then queue one stop marker (-1) per thread
+ *    behind the connections still waiting, join the threads and print
+ *    their statistics.
+ *
+ *  Use:
+ *    Called by the server program for '-t tcp -m pool' with a socket
+ *    that is already listening.
+ */
+void run_pool(int listenSock, struct cmdline* opts) {
+
+    struct pool pool;
+    struct sigaction sa;
+    struct sockaddr_storage from;
+    socklen_t fromlen;
+    unsigned long connections = 0, requests = 0;
+    int i, fd, err, started = 0;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.listenSock = listenSock;
+    pool.size = opts -> pool;
+    pool.opts = opts;
+    atomic_init(&pool.shutdown, false);
+    if ((pool.threads = calloc(pool.size, sizeof(struct pool_thread))) == NULL) {
+        perror("[Server Program]: calloc");
+        exit(1);
+    }
+    if (sem_init(&pool.queue.slots, 0, POOL_QUEUESIZE) == -1 ||
+        sem_init(&pool.queue.items, 0, 0) == -1) {
+        perror("[Server Program]: sem_init");
+        exit(1);
+    }
+    pthread_mutex_init(&pool.queue.lock, NULL);
+    pthread_mutex_init(&pool.lock, NULL);
+
+    /* SIGINT and SIGTERM drain the pool instead of killing it */
+    signal_pool = &pool;
+    sa.sa_handler = drain_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGINT, &sa, NULL) == -1 || sigaction(SIGTERM, &sa, NULL) == -1) {
+        perror("[Server Program]: sigaction");
+        exit(1);
+    }
+
+    /* A client that resets its connection must not kill every thread */
+    sa.sa_handler = SIG_IGN;
+    if (sigaction(SIGPIPE, &sa, NULL) == -1) {
+        perror("[Server Program]: sigaction");
+        exit(1);
+    }
+
+    /* Start the pool threads */
+    for (i = 0; i < pool.size; i++) {
+        pool.threads[i].id = i;
+        pool.threads[i].fd = -1;
+        pool.threads[i].pool = &pool;
+        if ((err = pthread_create(&pool.threads[i].tid, NULL, pool_routine,
+                                  &pool.threads[i])) != 0) {
+            errno = err;
+            perror("[Server Program]: pthread_create");
+            request_drain(&pool);
+            break;
+        }
+        started++;
+    }
+    printf("------------------------------------------------------------------\n");
+    printf("[Server Program]: %d pool threads waiting for connections on port %s...\n",
+           started, opts -> port);
+
+    /* Accept connections until a drain shuts the listening socket down;
+       one over '-c' is rejected here instead of waiting in the queue */
+    while (!atomic_load(&pool.shutdown)) {
+        fromlen = sizeof(from);
+        if ((fd = accept(listenSock, (struct sockaddr*)&from, &fromlen)) == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (!atomic_load(&pool.shutdown)) {
+                perror("[Server Program]: accept");
+                metric_add(MC_ERRORS, 1);
+                request_drain(&pool);
+            }
+            break;
+        }
+        metric_add(MC_ACCEPTS, 1);
+        if (!admit_connection()) {
+            reject_connection(fd);
+            continue;
+        }
+        pool_enqueue(&pool.queue, fd, client_key(&from));
+    }
+
+    /* Drain: wake idle persistent clients, then stop each thread in turn */
+    pthread_mutex_lock(&pool.lock);
+    for (i = 0; i < started; i++) {
+        if (pool.threads[i].fd != -1) {
+            shutdown(pool.threads[i].fd, SHUT_RD);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    for (i = 0; i < started; i++) {
+        pool_enqueue(&pool.queue, -1, 0);
+    }
+    for (i = 0; i < started; i++) {
+        if ((err = pthread_join(pool.threads[i].tid, NULL)) != 0) {
+            errno = err;
+            perror("[Server Program]: pthread_join");
+        }
+    }
+
+    /* Report what every thread served */
+    printf("[Server Program]: Connection pool drained.\n");
+    for (i = 0; i < started; i++) {
+        printf("[Server Program]: pool thread %d: %lu connections, %lu requests\n",
+               i, pool.threads[i].connections, pool.threads[i].requests);
+        connections += pool.threads[i].connections;
+        requests += pool.threads[i].requests;
+    }
+    printf("[Server Program]: total: %lu connections, %lu requests\n",
+           connections, requests);
+
+    signal_pool = NULL;
+    sem_destroy(&pool.queue.slots);
+    sem_destroy(&pool.queue.items);
+    pthread_mutex_destroy(&pool.queue.lock);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.threads);
+}
+
+/*
+ *  pool_routine
+ *
+ *  Description:
+ *    Thread routine of one pool thread: serve queued connections one
+ *    at a time until the stop marker is dequeued. A connection's
+ *    queue time is how long it waited in the queue.
+ */
+static void* pool_routine(void* arg) {
+
+    struct pool_thread* self = arg;
+    uint64_t accepted, client;
+    int fd, set = 1;
+
+    while ((fd = pool_dequeue(&self -> pool -> queue, &accepted, &client)) != -1) {
+        metric_time(MT_QUEUE, now_ns() - accepted);
+        self -> connections++;
+        // Each reply is its own send(): without this, Nagle holds back a
+        // pipelined client's second reply until the delayed ACK (~40 ms)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &set, sizeof(set));
+        serve_pool_connection(self, fd, client);
+        close(fd);
+        metric_add(MC_CLOSES, 1);
+        release_connection();
+    }
+    return NULL;
+}
+
+/*
+ *  serve_pool_connection
+ *
+ *  Description:
+ *    Answer every packet of one connection with the one byte reply of
+ *    its version's handler (handlers.c). A PROTO_SINGLE connection 
+ *    ends after its packet; other versions are served until the 
+ *    client closes the connection or the pool drains. A bulk payload 
+ *    is receieved before its reply, and a version without a handler
+ *    closes the connection. A packet over the '-r' rate of 'client' is
+ *    answered REPLY_REJECTED (admission.c).
+ *    The termination number 0 is answered, then starts a drain.
+ *
+ *    Packets are parsed out of large reads (framing.c), and the
+ *    replies to every packet of one read are sent together before
+ *    the thread waits for more.
+ */
+static void serve_pool_connection(struct pool_thread* self, int fd, uint64_t client) {
+
+    struct pool* pool = self -> pool;
+    const struct handler* handler = NULL;
+    struct frame_reader reader;
+    struct packet pkt;
+    char replies[FRAME_BUFSIZE], *head;
+    size_t headlen;
+    bool first = true, idle, last;
+    int numreplies = 0, ret;
+    uint64_t start;
+
+    reader_init(&reader, fd, pool -> opts -> profile);
+    while (1) {
+        /* About to wait for more bytes: send the replies owed first */
+        idle = !reader_buffered(&reader);
+        if (idle && flush_replies(fd, replies, &numreplies) == -1) {
+            return;
+        }
+        if (idle && !begin_idle(self, fd, first)) {
+            return;
+        }
+        ret = reader_next(&reader, &pkt);
+        if (idle) end_idle(self);
+        if (ret <= 0) {
+            return;   // Client closed the connection (or the pool drained)
+        }
+        first = false;
+
+        uint32_t data_receieved = ntohl(pkt.number);
+        self -> requests++;
+        metric_add(MC_TCP_REQUESTS, 1);
+        metric_add(MC_BYTES_IN, sizeof(pkt));
+        start = now_ns();
+        if (!pool -> opts -> quiet && pkt.version != PROTO_BULK) {
+            printf("[Server Program]: Pool thread %d receieved the number: %u\n",
+                   self -> id, data_receieved);
+        }
+        if (reject_request(client, pkt.version, data_receieved)) {
+            handler = NULL;
+        }
+        else if (pkt.version == PROTO_BULK) {
+            headlen = reader_take(&reader, data_receieved, &head);
+            if (flush_replies(fd, replies, &numreplies) == -1 ||
+                recv_bulk(fd, data_receieved, head, headlen, pool -> opts) == -1) {
+                metric_add(MC_ERRORS, 1);
+                return;
+            }
+            metric_add(MC_BYTES_IN, data_receieved);
+        }
+        else if ((handler = find_handler(pkt.version)) == NULL) {
+            fprintf(stderr, "[Server Program]: Unknown packet version %u\n", pkt.version);
+            metric_add(MC_ERRORS, 1);
+            flush_replies(fd, replies, &numreplies);
+            return;
+        }
+
+        /* Queue the reply; the last packet of a connection is answered now */
+        replies[numreplies++] = pkt.version == PROTO_BULK ? 1 
+                              : handler == NULL ? REPLY_REJECTED : handler -> fn(data_receieved);
+        metric_time(MT_SERVICE, now_ns() - start);
+        metric_add(MC_BYTES_OUT, 1);
+        last = (data_receieved == 0 && pkt.version != PROTO_BULK) || 
+               pkt.version == PROTO_SINGLE;
+        if (last && flush_replies(fd, replies, &numreplies) == -1) {
+            return;
+        }
+
+        /* Server terminates if 0 is receieved (a bulk length is not a number) */
+        if (data_receieved == 0 && pkt.version != PROTO_BULK) {
+            printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
+            printf("[Server Program]: Server shutting down.\n");
+            request_drain(pool);
+            return;
+        }
+        if (pkt.version == PROTO_SINGLE) {
+            return;
+        }
+    }
+}
+
+/*
+ *  begin_idle
+ *
+ *  Description:
+ *    Waiting for the first packet of a connection, or between packets
+ *    of a persistent one, the thread is idle. Publish the connection
+ *    in 'fd' so a drain can shut its read side down (recvall() then
+ *    sees end of file); a client that connects and sends nothing must
+ *    not hold up the drain. Once a drain has started, only a packet
+ *    that is already waiting is served, or the first packet of a
+ *    queued connection that arrives within POOL_FIRST_MS. Returns
+ *    false when the connection should be closed instead.
+ */
+static bool begin_idle(struct pool_thread* self, int fd, bool first) {
+
+    struct pool* pool = self -> pool;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    struct packet pkt;
+    bool draining;
+
+    pthread_mutex_lock(&pool -> lock);
+    self -> fd = fd;
+    draining = atomic_load(&pool -> shutdown);
+    pthread_mutex_unlock(&pool -> lock);
+
+    if (draining && recv(fd, &pkt, sizeof(pkt), MSG_PEEK | MSG_DONTWAIT) != sizeof(pkt)) {
+        if (!first || poll(&pfd, 1, POOL_FIRST_MS) <= 0 ||
+            recv(fd, &pkt, sizeof(pkt), MSG_PEEK | MSG_DONTWAIT) != sizeof(pkt)) {
+            end_idle(self);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ *  end_idle
+ *
+ *  Description:
+ *    A packet arrived: the connection is busy and must not be shut
+ *    down by a drain until its reply is sent.
+ */
+static void end_idle(struct pool_thread* self) {
+    pthread_mutex_lock(&self -> pool -> lock);
+    self -> fd = -1;
+    pthread_mutex_unlock(&self -> pool -> lock);
+}
+
+/*
+ *  request_drain
+ *
+ *  Description:
+ *    Stop accepting: set the shutdown flag and shut the listening
+ *    socket's read side down, which wakes the acceptor out of accept().
+ *    Both calls are async-signal-safe.
+ */
+static void request_drain(struct pool* pool) {
+    atomic_store(&pool -> shutdown, true);
+    shutdown(pool -> listenSock, SHUT_RD);
+}
+
+/*
+ *  drain_signal_handler
+ *
+ *  Description:
+ *    SIGINT and SIGTERM handler in pool mode: drain the pool.
+ */
+static void drain_signal_handler(UNUSED_PARAM int s) {
+
+    int saved_errno = errno;
+
+    if (signal_pool != NULL) {
+        request_drain(signal_pool);
+    }
+    errno = saved_errno;
+}
+
+/*
+ *  pool_enqueue
+ *
+ *  Description:
+ *    Append a connection from 'client' to the queue, waiting while the
+ *    queue is full, and note when it was queued.
+ */
+static void pool_enqueue(struct conn_queue* queue, int fd, uint64_t client) {
+
+    while (sem_wait(&queue -> slots) == -1 && errno == EINTR);   // Wait for a free slot
+    pthread_mutex_lock(&queue -> lock);
+    queue -> fds[(queue -> head + queue -> count) % POOL_QUEUESIZE] = fd;
+    queue -> accepted[(queue -> head + queue -> count) % POOL_QUEUESIZE] = now_ns();
+    queue -> clients[(queue -> head + queue -> count) % POOL_QUEUESIZE] = client;
+    queue -> count++;
+    pthread_mutex_unlock(&queue -> lock);
+    sem_post(&queue -> items);   // Wake a thread waiting on an empty queue
+}
+
+/*
+ *  pool_dequeue
+ *
+ *  Description:
+ *    Remove the oldest connection from the queue, waiting while the
+ *    queue is empty. '*accepted' is set to the time it was queued and
+ *    '*client' to its client's key.
+ */
+static int pool_dequeue(struct conn_queue* queue, uint64_t* accepted, uint64_t* client) {
+
+    int fd;
+
+    while (sem_wait(&queue -> items) == -1 && errno == EINTR);   // Wait for a connection
+    pthread_mutex_lock(&queue -> lock);
+    fd = queue -> fds[queue -> head];
+    *accepted = queue -> accepted[queue -> head];
+    *client = queue -> clients[queue -> head];
+    queue -> head = (queue -> head + 1) % POOL_QUEUESIZE;
+    queue -> count--;
+    pthread_mutex_unlock(&queue -> lock);
+    sem_post(&queue -> slots);   // Wake the acceptor waiting on a full queue
+    return fd;
+}
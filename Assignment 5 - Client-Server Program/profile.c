@@ -0,0 +1,171 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  SOCKET PROFILES used by the client and server programs ('-o')
+ *
+ *  A profile is a set of TCP socket options tuned for one goal:
+ *
+ *      default     the kernel's defaults (only the pool server turns
+ *                  Nagle off, as it always did)
+ *      latency     TCP_NODELAY: a small write leaves at once instead
+ *                  of waiting for the ACK of the previous one (Nagle);
+ *                  TCP_QUICKACK: ACK every read at once instead of
+ *                  delaying it up to 40 ms; SO_BUSY_POLL: spin on the
+ *                  device queue for PROFILE_BUSY_POLL_US before
+ *                  sleeping in a blocking read
+ *      throughput  SO_SNDBUF/SO_RCVBUF of PROFILE_BUFSIZE, so the
+ *                  window is never limited by the buffers;
+ *                  TCP_NOTSENT_LOWAT: a writer is only woken when less
+ *                  than PROFILE_LOWAT is left unsent, so a large buffer
+ *                  does not also mean a large queue of stale data;
+ *                  TCP_CORK around a bulk transfer, so its header and
+ *                  payload leave in full segments
+ *
+ *  The server sets the options on its listening socket before
+ *  listen(), which makes the receive buffer count for the window
+ *  scale it offers; the connections it accepts inherit them. The
+ *  kernel clears TCP_QUICKACK again once a connection looks
+ *  interactive. That is harmless while every request is answered at
+ *  once, as the reply carries the ACK, so the server only sets it
+ *  again after a read that ended inside a packet: nothing will be
+ *  sent back until the rest arrives, and a delayed ACK would hold the
+ *  sender's rest back. Setting it after every read cost a quarter of
+ *  the one-at-a-time request rate on loopback.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static const char* profile_names[] = { "default", "latency", "throughput" };
+
+static int set_option(int fd, int level, int name, int value, const char* label,
+                      const char* prefix);
+
+/*
+ *  parse_profile
+ *
+ *  Description:
+ *    Returns the profile named 'name', or -1 if there is none.
+ */
+int parse_profile(const char* name) {
+
+    int i;
+
+    for (i = 0; i < PROFILE_COUNT; i++) {
+        if (!strcmp(name, profile_names[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ *  profile_name
+ *
+ *  Description:
+ *    Returns the name of a profile, for printing.
+ */
+const char* profile_name(enum sock_profile profile) {
+    return profile_names[profile];
+}
+
+/*
+ *  apply_profile
+ *
+ *  Description:
+ *    Set the options of 'profile' on a TCP socket. A socket buffer
+ *    above the system limit (net.core.wmem_max and rmem_max) needs
+ *    CAP_NET_ADMIN, and so does busy polling longer than the system
+ *    default: without it, the largest buffer allowed is used and busy
+ *    polling is left off, with a warning. Errors are printed after
+ *    'prefix', the name of the calling program. Returns -1 on failure.
+ *
+ *  Use:
+ *    Called on the server's listening sockets and on every TCP socket
+ *    the client connects.
+ */
+int apply_profile(int fd, enum sock_profile profile, const char* prefix) {
+
+    static bool warned = false;
+    int size = PROFILE_BUFSIZE, busy = PROFILE_BUSY_POLL_US;
+
+    if (profile == PROFILE_LATENCY) {
+        if (set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", prefix) == -1 ||
+            set_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK", prefix) == -1) {
+            return -1;
+        }
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy, sizeof(busy)) == -1 && !warned) {
+            fprintf(stderr, "%s setsockopt: SO_BUSY_POLL: %s (busy polling stays off)\n",
+                    prefix, strerror(errno));
+            warned = true;
+        }
+    }
+    else if (profile == PROFILE_THROUGHPUT) {
+        if ((setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &size, sizeof(size)) == -1 &&
+             set_option(fd, SOL_SOCKET, SO_SNDBUF, size, "SO_SNDBUF", prefix) == -1) ||
+            (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == -1 &&
+             set_option(fd, SOL_SOCKET, SO_RCVBUF, size, "SO_RCVBUF", prefix) == -1) ||
+            set_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, PROFILE_LOWAT,
+                       "TCP_NOTSENT_LOWAT", prefix) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ *  rearm_quickack
+ *
+ *  Description:
+ *    Ask again for the next ACK of a latency profile socket to be sent
+ *    at once. Does nothing for the other profiles.
+ *
+ *  Use:
+ *    Called by the server after a read that left part of a packet
+ *    in its buffer.
+ */
+void rearm_quickack(int fd, enum sock_profile profile) {
+
+    int set = 1;
+
+    if (profile == PROFILE_LATENCY) {
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &set, sizeof(set));
+    }
+}
+
+/*
+ *  cork_socket
+ *
+ *  Description:
+ *    With the throughput profile, hold partial segments back while
+ *    'on' (TCP_CORK) and send whatever is held when it is turned off.
+ *    Does nothing for the other profiles.
+ *
+ *  Use:
+ *    Called around a message that is written in several pieces.
+ */
+void cork_socket(int fd, enum sock_profile profile, bool on) {
+
+    int set = on;
+
+    if (profile == PROFILE_THROUGHPUT) {
+        setsockopt(fd, IPPROTO_TCP, TCP_CORK, &set, sizeof(set));
+    }
+}
+
+/*
+ *  set_option
+ *
+ *  Description:
+ *    setsockopt() for an int option, printing 'label' after 'prefix'
+ *    on failure.
+ */
+static int set_option(int fd, int level, int name, int value, const char* label,
+                      const char* prefix) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) == -1) {
+        fprintf(stderr, "%s setsockopt: %s: %s\n", prefix, label, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  LOSSY UDP PROXY used to test reliable transfers ('-m rudp')
+ *
+ *  Forwards datagrams from clients on port '-p' to the server on
+ *  port '-d' and the server's replies back to the client that last
+ *  sent one, dropping each datagram, in either direction, with the
+ *  probability given by '-l <percent>'. The drops are drawn from a
+ *  generator seeded with '-r <seed>', so a run can be repeated.
+ *
+ *      ./proxy -p 3017 -d 3016 -l 5
+ *
+ *  The proxy runs until SIGINT or SIGTERM, then prints how many
+ *  datagrams it forwarded and dropped.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static volatile sig_atomic_t stopped = 0;
+
+static void stop_handler(UNUSED_PARAM int s);
+static int open_sockets(char* port, char* dest, int* clientSock, int* serverSock);
+static bool drop(uint64_t* state, double loss);
+static void proxy_usage(char* name);
+
+int main(int argc, char* argv[]) {
+
+    struct sockaddr_storage client, from;
+    struct sigaction sa;
+    struct pollfd fds[2];
+    socklen_t clientlen = 0, fromlen;
+    char *port = NULL, *dest = NULL, buf[RUDP_DGRAMSIZE];
+    unsigned long forwarded[2] = {0, 0}, dropped[2] = {0, 0};
+    uint64_t state = 1;
+    double loss = 0;
+    ssize_t n;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, ":p:d:l:r:")) != -1) {
+        switch (opt) {
+            case 'p' : port = optarg; break;
+            case 'd' : dest = optarg; break;
+            case 'l' : loss = strtod(optarg, NULL) / 100; break;
+            case 'r' : state = strtoull(optarg, NULL, 10); break;
+            default  : proxy_usage(argv[0]);
+        }
+    }
+    if (port == NULL || dest == NULL || loss < 0 || loss > 1 || optind < argc) {
+        proxy_usage(argv[0]);
+    }
+    state = state ? state : 1;   // xorshift must not start at 0
+
+    /* Stop on SIGINT or SIGTERM; no SA_RESTART, so poll() returns */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (open_sockets(port, dest, &fds[0].fd, &fds[1].fd) == -1) {
+        exit(1);
+    }
+    fds[0].events = fds[1].events = POLLIN;
+    printf("[Proxy]: forwarding port %s to port %s, dropping %.1f%% of datagrams\n",
+           port, dest, loss * 100);
+    fflush(stdout);
+
+    while (!stopped) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("[Proxy]: poll");
+            break;
+        }
+
+        /* Forward both ways; the last client heard from gets the replies */
+        for (i = 0; i < 2; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            fromlen = sizeof(from);
+            while ((n = recvfrom(fds[i].fd, buf, sizeof(buf), MSG_DONTWAIT,
+                                 (struct sockaddr*)&from, &fromlen)) >= 0) {
+                if (i == 0) {
+                    memcpy(&client, &from, fromlen);
+                    clientlen = fromlen;
+                }
+                if (drop(&state, loss) || (i == 1 && clientlen == 0)) {
+                    dropped[i]++;
+                }
+                else if ((i == 0 ? send(fds[1].fd, buf, n, 0)
+                                 : sendto(fds[0].fd, buf, n, 0, (struct sockaddr*)&client,
+                                          clientlen)) == -1) {
+                    dropped[i]++;   // e.g. the server is not up yet
+                }
+                else {
+                    forwarded[i]++;
+                }
+                fromlen = sizeof(from);
+            }
+        }
+    }
+
+    printf("[Proxy]: to server: %lu forwarded, %lu dropped; to client: %lu forwarded, "
+           "%lu dropped\n", forwarded[0], dropped[0], forwarded[1], dropped[1]);
+    close(fds[0].fd);
+    close(fds[1].fd);
+    exit(0);
+}
+
+/*
+ *  open_sockets
+ *
+ *  Description:
+ *    Bind the socket clients send to on 'port' (loopback) and connect
+ *    a socket to the server on 'dest' (loopback). Returns -1 on
+ *    failure.
+ */
+static int open_sockets(char* port, char* dest, int* clientSock, int* serverSock) {
+
+    struct addrinfo hints, *res;
+    int ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if ((ret = getaddrinfo("127.0.0.1", port, &hints, &res)) != 0) {
+        fprintf(stderr, "[Proxy]: getaddrinfo: %s\n", gai_strerror(ret));
+        return -1;
+    }
+    if ((*clientSock = socket(res -> ai_family, res -> ai_socktype, 0)) == -1 ||
+        bind(*clientSock, res -> ai_addr, res -> ai_addrlen) == -1) {
+        perror("[Proxy]: bind");
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    if ((ret = getaddrinfo("127.0.0.1", dest, &hints, &res)) != 0) {
+        fprintf(stderr, "[Proxy]: getaddrinfo: %s\n", gai_strerror(ret));
+        return -1;
+    }
+    if ((*serverSock = socket(res -> ai_family, res -> ai_socktype, 0)) == -1 ||
+        connect(*serverSock, res -> ai_addr, res -> ai_addrlen) == -1) {
+        perror("[Proxy]: connect");
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+    return 0;
+}
+
+/*
+ *  drop
+ *
+ *  Description:
+ *    Returns true with probability 'loss', from a xorshift64 generator.
+ */
+static bool drop(uint64_t* state, double loss) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (*state >> 11) * (1.0 / (1ULL << 53)) < loss;
+}
+
+static void stop_handler(UNUSED_PARAM int s) {
+    stopped = 1;
+}
+
+static void proxy_usage(char* name) {
+    printf("\nUsage: %s -p <port> -d <port> [-l <percent>] [-r <seed>]\n", name);
+    printf("Forwards UDP datagrams on loopback and drops some of them.\n\n");
+    printf("\t-p <port> \t\t port the clients send to\n");
+    printf("\t-d <port> \t\t port of the server\n");
+    printf("\t-l <percent> \t\t (optional) datagrams dropped, each way (default: 0)\n");
+    printf("\t-r <seed> \t\t (optional) seed of the drops (default: 1)\n\n");
+    exit(1);
+}
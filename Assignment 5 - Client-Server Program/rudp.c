@@ -0,0 +1,649 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  RELIABLE UDP used by the client ('-m rudp') and server programs
+ *
+ *  The client splits the '-f' file (or '-x' bytes of generated data)
+ *  into numbered segments of RUDP_MSS bytes and sends them as
+ *  PROTO_RUDP datagrams. The server writes each segment at its offset
+ *  and acknowledges them with a cumulative ack and a 64-bit selective
+ *  acknowledgement (SACK) of the segments received past the first
+ *  gap: every segment in the blocking UDP loop, every burst read in
+ *  one go in the event loop. The last segment is flagged FIN.
+ *
+ *  The sender keeps up to '-k' segments in flight (a sliding window)
+ *  and sends every segment the window allows with one sendmmsg(),
+ *  using UDP segmentation offload where the kernel has it. A lost
+ *  segment is resent:
+ *
+ *    - when RUDP_DUPTHRESH later segments have been SACKed (fast
+ *      retransmit, once per segment), or
+ *    - when its retransmit timer expires. The timeout follows RFC 6298:
+ *      a smoothed RTT and its variance, RTT samples only from segments
+ *      sent once (Karn's algorithm), and a timeout that doubles on
+ *      expiry, at most once per timeout period. The bounds suit a LAN
+ *      (RUDP_MIN_RTO, RUDP_INIT_RTO) rather than RFC 6298's 1 s.
+ *
+ *  There is no handshake: a connection id picked by the sender marks
+ *  the segments of one transfer, and a new id from the same address
+ *  starts a new transfer on the server.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static void start_transfer(struct rudp_sender* s, uint32_t conn);
+static void queue_segment(struct rudp_sender* s, uint32_t seq, uint64_t now);
+static int flush_segments(struct rudp_sender* s);
+static int read_acks(struct rudp_sender* s);
+static int expire_segments(struct rudp_sender* s, uint64_t now);
+static uint64_t next_deadline(struct rudp_sender* s);
+static void update_rto(struct rudp_sender* s, uint64_t rtt);
+static ssize_t send_ack(int sock, struct rudp_peer* peer);
+static struct rudp_peer* find_peer(struct rudp_receiver* rx, struct sockaddr_storage* from,
+                                   socklen_t fromlen, uint32_t conn, struct cmdline* opts);
+
+/*
+ *  run_rudp
+ *
+ *  Description:
+ *    Send '-n' reliable transfers of the payload over UDP, each with
+ *    its own connection id, and print the rate, the retransmissions
+ *    and the final RTT estimate of every transfer.
+ *
+ *  Use:
+ *    Called by the client program in '-m rudp' mode with an unbound
+ *    UDP socket, which is connected to 'server' so only its
+ *    acknowledgements are read. Returns -1 on failure.
+ */
+int run_rudp(int sock, struct addrinfo* server, struct cmdline* opts) {
+
+    struct rudp_sender* s;
+    struct timespec ts;
+    struct pollfd pfd;
+    uint64_t now, deadline, start, begin, elapsed, total = 0;
+    size_t len;
+    uint32_t i;
+    int fd, ret = 0;
+    void* map;
+
+    if (connect(sock, server -> ai_addr, server -> ai_addrlen) == -1) {
+        perror("[Client Program]: connect");
+        return -1;
+    }
+    if ((fd = open_payload(opts, &len)) == -1) {
+        return -1;
+    }
+    if ((map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED ||
+        (s = calloc(1, sizeof(struct rudp_sender))) == NULL) {
+        perror("[Client Program]: mmap");
+        close(fd);
+        return -1;
+    }
+    s -> sock = sock;
+    s -> payload = map;
+    s -> len = len;
+    s -> segments = (len + RUDP_MSS - 1) / RUDP_MSS;
+    s -> window = opts -> depth;
+    s -> gso = true;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    begin = now_ns();
+    for (i = 0; i < opts -> count && ret == 0; i++) {
+        start = now_ns();
+        start_transfer(s, (uint32_t)(start ^ (start >> 32) ^ ((uint64_t)getpid() << 16)) + i);
+
+        while (s -> base < s -> segments) {
+
+            /* Fill the window, resend what timed out, and send it all at once.
+               A fast retransmit queued before the window slid past it still
+               takes a place in the queue. */
+            now = now_ns();
+            while (s -> next < s -> segments && s -> next < s -> base + s -> window &&
+                   s -> queued < RUDP_WINDOW) {
+                queue_segment(s, s -> next++, now);
+            }
+            if (expire_segments(s, now) == -1) {
+                fprintf(stderr, "[Client Program]: ERROR the server stopped acknowledging "
+                        "segments\n");
+                ret = -1;
+                break;
+            }
+            if (flush_segments(s) == -1) {
+                ret = -1;
+                break;
+            }
+
+            /* Wait for acknowledgements until the earliest retransmit timer */
+            deadline = next_deadline(s);
+            now = now_ns();
+            deadline = deadline > now ? deadline - now : 0;
+            ts.tv_sec = deadline / 1000000000ULL;
+            ts.tv_nsec = deadline % 1000000000ULL;
+            if (ppoll(&pfd, 1, &ts, NULL) == -1) {
+                if (errno == EINTR) continue;
+                perror("[Client Program]: ppoll");
+                ret = -1;
+                break;
+            }
+            if (pfd.revents != 0 && read_acks(s) == -1) {
+                ret = -1;
+                break;
+            }
+        }
+        if (ret == -1) {
+            break;
+        }
+        elapsed = now_ns() - start;
+        total += len;
+        printf("[Client Program]: transfer %u: %zu bytes in %.3f s: %.1f MB/s, %lu segments "
+               "sent for %u (%lu timeouts, %lu fast retransmits), srtt %.1f us, rto %.1f ms\n",
+               i + 1, len, elapsed / 1e9, len * 1e3 / elapsed, s -> sent, s -> segments,
+               s -> timeouts, s -> fast_retransmits, s -> srtt / 1e3, s -> rto / 1e6);
+    }
+    elapsed = now_ns() - begin;
+
+    if (ret == 0) {
+        printf("[Client Program]: rudp: %lu bytes in %u transfers, %.3f s: %.1f MB/s "
+               "(window %u segments)\n", (unsigned long)total, opts -> count, elapsed / 1e9,
+               total * 1e3 / elapsed, s -> window);
+    }
+    munmap(map, len);
+    close(fd);
+    free(s);
+    return ret;
+}
+
+/*
+ *  start_transfer
+ *
+ *  Description:
+ *    Reset the window, the counters and the RTT estimate for a new
+ *    transfer with connection id 'conn'.
+ */
+static void start_transfer(struct rudp_sender* s, uint32_t conn) {
+    memset(s -> slots, 0, sizeof(s -> slots));
+    s -> conn = conn;
+    s -> base = s -> next = 0;
+    s -> queued = 0;
+    s -> srtt = s -> rttvar = 0;
+    s -> rto = RUDP_INIT_RTO;
+    s -> backoff_at = 0;
+    s -> sent = s -> timeouts = s -> fast_retransmits = 0;
+}
+
+/*
+ *  queue_segment
+ *
+ *  Description:
+ *    Add segment 'seq' to the next sendmmsg() and start its timer.
+ *    The payload is sent straight from the mapped file.
+ */
+static void queue_segment(struct rudp_sender* s, uint32_t seq, uint64_t now) {
+
+    struct rudp_header* h = &s -> headers[s -> queued];
+    struct rudp_slot* slot = &s -> slots[seq % RUDP_WINDOW];
+    size_t offset = (size_t)seq * RUDP_MSS;
+    size_t n = s -> len - offset < RUDP_MSS ? s -> len - offset : RUDP_MSS;
+
+    memset(h, 0, sizeof(*h));
+    h -> pkt.version = PROTO_RUDP;
+    h -> pkt.number = htonl(seq);
+    h -> flags = RUDP_DATA | (seq == s -> segments - 1 ? RUDP_FIN : 0);
+    h -> conn = htonl(s -> conn);
+
+    s -> iov[s -> queued][0].iov_base = h;
+    s -> iov[s -> queued][0].iov_len = sizeof(*h);
+    s -> iov[s -> queued][1].iov_base = (char*)s -> payload + offset;
+    s -> iov[s -> queued][1].iov_len = n;
+    s -> queued++;
+
+    slot -> sent_at = now;
+    slot -> tries++;
+    s -> sent++;
+}
+
+/*
+ *  flush_segments
+ *
+ *  Description:
+ *    Send every queued segment with one sendmmsg() (more if the kernel
+ *    takes fewer messages). With UDP segmentation offload, a run of up
+ *    to RUDP_GSO_SEGS full segments goes in one message: the segments
+ *    are laid out back to back, and the kernel cuts them into 
+ *    datagrams of RUDP_DGRAMSIZE bytes as late as it can. A kernel
+ *    without UDP_SEGMENT (before Linux 4.18) gets one message per
+ *    segment. Returns -1 on failure.
+ */
+static int flush_segments(struct rudp_sender* s) {
+
+    struct cmsghdr* cmsg;
+    int done = 0, nmsgs = 0, first, n;
+
+    /* Group the segments: a short segment ends its message */
+    for (first = 0; first < s -> queued; first += n) {
+        for (n = 1; s -> gso && n < RUDP_GSO_SEGS && first + n < s -> queued &&
+                    s -> iov[first + n - 1][1].iov_len == RUDP_MSS; n++);
+        memset(&s -> msgs[nmsgs], 0, sizeof(struct mmsghdr));
+        s -> msgs[nmsgs].msg_hdr.msg_iov = s -> iov[first];
+        s -> msgs[nmsgs].msg_hdr.msg_iovlen = 2 * n;
+        if (n > 1) {
+            s -> msgs[nmsgs].msg_hdr.msg_control = s -> control[nmsgs];
+            s -> msgs[nmsgs].msg_hdr.msg_controllen = sizeof(s -> control[nmsgs]);
+            cmsg = CMSG_FIRSTHDR(&s -> msgs[nmsgs].msg_hdr);
+            cmsg -> cmsg_level = SOL_UDP;
+            cmsg -> cmsg_type = UDP_SEGMENT;
+            cmsg -> cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t*)CMSG_DATA(cmsg) = RUDP_DGRAMSIZE;
+        }
+        nmsgs++;
+    }
+
+    while (done < nmsgs) {
+        if ((n = sendmmsg(s -> sock, s -> msgs + done, nmsgs - done, 0)) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) {
+                sched_yield();   // The device queue is full: the segments wait
+                continue;
+            }
+            if (s -> gso && (errno == EINVAL || errno == EIO || errno == ENOPROTOOPT) &&
+                done == 0) {
+                s -> gso = false;   // No segmentation offload: one message per segment
+                return flush_segments(s);
+            }
+            perror("[Client Program]: sendmmsg");
+            return -1;
+        }
+        done += n;
+    }
+    s -> queued = 0;
+    return 0;
+}
+
+/*
+ *  read_acks
+ *
+ *  Description:
+ *    Read every acknowledgement that has arrived. Each one yields an
+ *    RTT sample (if the segment it echoes was sent once), marks the
+ *    cumulatively acked and SACKed segments, slides the window past
+ *    the acked ones, and queues a fast retransmit for every hole with
+ *    RUDP_DUPTHRESH SACKed segments above it. Returns -1 if the
+ *    server cannot be reached.
+ */
+static int read_acks(struct rudp_sender* s) {
+
+    struct rudp_header h;
+    struct rudp_slot* slot;
+    uint32_t ack, echo, seq, highest;
+    uint64_t sack, now;
+    ssize_t n;
+    int i;
+
+    while ((n = recv(s -> sock, &h, sizeof(h), MSG_DONTWAIT)) != -1 || errno == EINTR) {
+        if (n < (ssize_t)sizeof(h) || h.pkt.version != PROTO_RUDP ||
+            !(h.flags & RUDP_ACK) || ntohl(h.conn) != s -> conn) {
+            continue;   // Not an acknowledgement of this transfer
+        }
+        now = now_ns();
+        echo = ntohl(h.pkt.number);
+        ack = ntohl(h.ack);
+        sack = be64toh(h.sack);
+        if (ack > s -> next) {
+            continue;   // Acknowledges segments never sent
+        }
+
+        /* Karn's algorithm: a resent segment's ack may be for either send */
+        if (echo >= s -> base && echo < s -> next) {
+            slot = &s -> slots[echo % RUDP_WINDOW];
+            if (!slot -> acked && slot -> tries == 1) {
+                update_rto(s, now - slot -> sent_at);
+            }
+        }
+
+        /* Mark the acked segments, then slide the window */
+        for (seq = s -> base; seq < ack; seq++) {
+            s -> slots[seq % RUDP_WINDOW].acked = true;
+        }
+        highest = 0;
+        for (i = 0; i < 64 && (sack >> i) != 0; i++) {
+            seq = ack + 1 + i;
+            if (((sack >> i) & 1) && seq >= s -> base && seq < s -> next) {
+                s -> slots[seq % RUDP_WINDOW].acked = true;
+                highest = seq;
+            }
+        }
+        while (s -> base < s -> next && s -> slots[s -> base % RUDP_WINDOW].acked) {
+            memset(&s -> slots[s -> base % RUDP_WINDOW], 0, sizeof(struct rudp_slot));
+            s -> base++;
+        }
+
+        /* Resend the holes well below the highest SACKed segment */
+        for (seq = s -> base; seq + RUDP_DUPTHRESH <= highest; seq++) {
+            slot = &s -> slots[seq % RUDP_WINDOW];
+            if (!slot -> acked && !slot -> fast && s -> queued < RUDP_WINDOW) {
+                slot -> fast = true;
+                s -> fast_retransmits++;
+                queue_segment(s, seq, now);
+            }
+        }
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        perror("[Client Program]: recv");   // e.g. ECONNREFUSED: no server on the port
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ *  expire_segments
+ *
+ *  Description:
+ *    Queue every segment in flight whose retransmit timer has expired
+ *    and back the timeout off. The segments of one burst expire close
+ *    together, so the timeout doubles at most once per timeout period.
+ *    Returns -1 once a segment has been sent RUDP_MAX_TRIES times.
+ */
+static int expire_segments(struct rudp_sender* s, uint64_t now) {
+
+    struct rudp_slot* slot;
+    uint32_t seq;
+    bool expired = false;
+
+    for (seq = s -> base; seq < s -> next; seq++) {
+        slot = &s -> slots[seq % RUDP_WINDOW];
+        if (slot -> acked || slot -> tries == 0 || now - slot -> sent_at < s -> rto ||
+            s -> queued == RUDP_WINDOW) {
+            continue;
+        }
+        if (slot -> tries >= RUDP_MAX_TRIES) {
+            return -1;
+        }
+        queue_segment(s, seq, now);
+        expired = true;
+    }
+    if (expired) {
+        s -> timeouts++;
+        if (now >= s -> backoff_at) {
+            s -> rto = s -> rto * 2 < RUDP_MAX_RTO ? s -> rto * 2 : RUDP_MAX_RTO;
+            s -> backoff_at = now + s -> rto;
+        }
+    }
+    return 0;
+}
+
+/*
+ *  next_deadline
+ *
+ *  Description:
+ *    Returns the time the first retransmit timer of the window
+ *    expires.
+ */
+static uint64_t next_deadline(struct rudp_sender* s) {
+
+    uint64_t deadline = UINT64_MAX;
+    uint32_t seq;
+
+    for (seq = s -> base; seq < s -> next; seq++) {
+        struct rudp_slot* slot = &s -> slots[seq % RUDP_WINDOW];
+        if (!slot -> acked && slot -> sent_at + s -> rto < deadline) {
+            deadline = slot -> sent_at + s -> rto;
+        }
+    }
+    return deadline;
+}
+
+/*
+ *  update_rto
+ *
+ *  Description:
+ *    Fold an RTT sample into the smoothed RTT and its variance and
+ *    recompute the retransmit timeout (RFC 6298, section 2).
+ */
+static void update_rto(struct rudp_sender* s, uint64_t rtt) {
+
+    uint64_t diff;
+
+    if (s -> srtt == 0) {
+        s -> srtt = rtt;
+        s -> rttvar = rtt / 2;
+    }
+    else {
+        diff = s -> srtt > rtt ? s -> srtt - rtt : rtt - s -> srtt;
+        s -> rttvar = (3 * s -> rttvar + diff) / 4;
+        s -> srtt = (7 * s -> srtt + rtt) / 8;
+    }
+    s -> rto = s -> srtt + 4 * s -> rttvar;
+    if (s -> rto < RUDP_MIN_RTO) s -> rto = RUDP_MIN_RTO;
+    if (s -> rto > RUDP_MAX_RTO) s -> rto = RUDP_MAX_RTO;
+}
+
+/*
+ *  rudp_receive
+ *
+ *  Description:
+ *    Take one PROTO_RUDP segment: write its payload at its offset in
+ *    the '-f' file (or drop it), update the sender's cumulative ack
+ *    and SACK bitmap, and acknowledge it. A transfer is reported once
+ *    its FIN segment and every segment before it have arrived.
+ *
+ *    With 'defer', the acknowledgement waits for rudp_flush_acks()
+ *    unless RUDP_ACK_EVERY segments of the transfer are waiting, so
+ *    a burst read in one go costs one acknowledgement; the cumulative
+ *    ack and the SACK bitmap cover every segment of it.
+ *
+ *  Use:
+ *    Called by the server's UDP loops for a datagram of version
+ *    PROTO_RUDP. Returns the bytes of the acknowledgement sent, 0 if
+ *    it was deferred or the datagram was dropped, or -1 if the send
+ *    failed.
+ */
+ssize_t rudp_receive(struct rudp_receiver* rx, int sock, const char* dgram, size_t len,
+                     struct sockaddr_storage* from, socklen_t fromlen, struct cmdline* opts,
+                     bool defer) {
+
+    struct rudp_header h;
+    struct rudp_peer* peer;
+    char addrStr[INET6_ADDRSTRLEN];
+    uint32_t seq;
+    uint64_t elapsed;
+    size_t payload;
+    ssize_t n;
+
+    if (len < sizeof(h)) {
+        return 0;   // Runt segment
+    }
+    memcpy(&h, dgram, sizeof(h));
+    if (!(h.flags & RUDP_DATA) ||
+        (peer = find_peer(rx, from, fromlen, ntohl(h.conn), opts)) == NULL) {
+        return 0;
+    }
+    seq = ntohl(h.pkt.number);
+    payload = len - sizeof(h);
+    peer -> last = now_ns();
+    peer -> segments++;
+    peer -> echo = seq;
+    peer -> unacked++;
+
+    /* Keep a segment not seen before, inside the window of the SACK bitmap */
+    if (seq < peer -> next || (seq > peer -> next && seq - peer -> next - 1 < 64 &&
+                               ((peer -> sack >> (seq - peer -> next - 1)) & 1))) {
+        peer -> duplicates++;
+    }
+    else if (seq - peer -> next <= 64) {
+        if (peer -> fd != -1 && pwrite(peer -> fd, dgram + sizeof(h), payload,
+                                       (off_t)seq * RUDP_MSS) != (ssize_t)payload) {
+            perror("[Server Program]: pwrite");
+            return 0;   // Not acknowledged, so the sender tries again
+        }
+        peer -> bytes += payload;
+        if (h.flags & RUDP_FIN) {
+            peer -> fin = seq + 1;
+        }
+        if (seq == peer -> next) {
+            /* Advance past the segments already SACKed, then rebase the bitmap
+               so bit i stands for 'next + 1 + i' again */
+            peer -> next = seq + 1;
+            while (peer -> sack & 1) {
+                peer -> sack >>= 1;
+                peer -> next++;
+            }
+            peer -> sack >>= 1;
+        }
+        else {
+            peer -> sack |= 1ULL << (seq - peer -> next - 1);
+        }
+    }
+
+    n = 0;
+    if (!defer || peer -> unacked >= RUDP_ACK_EVERY) {
+        n = send_ack(sock, peer);
+    }
+
+    /* The whole transfer has arrived */
+    if (!peer -> done && peer -> fin != 0 && peer -> next >= peer -> fin) {
+        peer -> done = true;
+        if (peer -> fd != -1) {
+            close(peer -> fd);
+            peer -> fd = -1;
+        }
+        if (!opts -> quiet) {
+            elapsed = peer -> last - peer -> start;
+            inet_ntop(from -> ss_family, get_sock_ip((struct sockaddr*)from), addrStr,
+                      sizeof(addrStr));
+            printf("[Server Program]: <%lu bytes> reliable transfer receieved from %s in "
+                   "%.3f s (%.1f MB/s): %lu segments, %lu duplicates\n",
+                   (unsigned long)peer -> bytes, addrStr, elapsed / 1e9,
+                   elapsed > 0 ? peer -> bytes * 1e3 / elapsed : 0.0, peer -> segments,
+                   peer -> duplicates);
+        }
+    }
+    return n;
+}
+
+/*
+ *  rudp_flush_acks
+ *
+ *  Description:
+ *    Acknowledge every transfer with deferred segments.
+ *
+ *  Use:
+ *    Called by the event loop once the UDP socket is drained. Returns
+ *    the bytes sent.
+ */
+ssize_t rudp_flush_acks(struct rudp_receiver* rx, int sock, unsigned long* syscalls) {
+
+    ssize_t n, total = 0;
+    int i;
+
+    for (i = 0; rx != NULL && i < RUDP_MAXPEERS; i++) {
+        if (rx -> peers[i].unacked > 0) {
+            (*syscalls)++;
+            if ((n = send_ack(sock, &rx -> peers[i])) > 0) {
+                total += n;
+            }
+        }
+    }
+    return total;
+}
+
+/*
+ *  send_ack
+ *
+ *  Description:
+ *    Send a transfer's cumulative ack and SACK bitmap, echoing the
+ *    last segment received so the sender can time it.
+ */
+static ssize_t send_ack(int sock, struct rudp_peer* peer) {
+
+    struct rudp_header h;
+    ssize_t n;
+
+    memset(&h, 0, sizeof(h));
+    h.pkt.version = PROTO_RUDP;
+    h.pkt.number = htonl(peer -> echo);
+    h.flags = RUDP_ACK;
+    h.conn = htonl(peer -> conn);
+    h.ack = htonl(peer -> next);
+    h.sack = htobe64(peer -> sack);
+    peer -> unacked = 0;
+    if ((n = sendto(sock, &h, sizeof(h), 0, (struct sockaddr*)&peer -> addr,
+                    peer -> addrlen)) == -1) {
+        perror("[Server Program]: sendto");
+    }
+    return n;
+}
+
+/*
+ *  find_peer
+ *
+ *  Description:
+ *    Returns the receiving state of the transfer 'conn' from 'from'.
+ *    A new connection id replaces the sender's previous transfer; a
+ *    new sender takes a free entry, or the one idle the longest. The
+ *    '-f' file is truncated when a transfer starts. Returns NULL if
+ *    the file cannot be opened.
+ */
+static struct rudp_peer* find_peer(struct rudp_receiver* rx, struct sockaddr_storage* from,
+                                   socklen_t fromlen, uint32_t conn, struct cmdline* opts) {
+
+    struct rudp_peer *peer = NULL, *oldest = &rx -> peers[0];
+    int i;
+
+    for (i = 0; i < RUDP_MAXPEERS; i++) {
+        if (rx -> peers[i].addrlen == fromlen && !memcmp(&rx -> peers[i].addr, from, fromlen)) {
+            peer = &rx -> peers[i];
+            break;
+        }
+        if (rx -> peers[i].last < oldest -> last) {
+            oldest = &rx -> peers[i];   // A free entry was never used: 'last' is 0
+        }
+    }
+    if (peer != NULL && peer -> conn == conn) {
+        return peer;
+    }
+    if (peer == NULL) {
+        peer = oldest;
+    }
+
+    /* Start a new transfer */
+    if (peer -> addrlen != 0 && peer -> fd != -1) {
+        close(peer -> fd);
+    }
+    memset(peer, 0, sizeof(*peer));
+    memcpy(&peer -> addr, from, fromlen);
+    peer -> addrlen = fromlen;
+    peer -> conn = conn;
+    peer -> fd = -1;
+    peer -> start = peer -> last = now_ns();
+    if (opts -> file != NULL &&
+        (peer -> fd = open(opts -> file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        perror("[Server Program]: open");
+        peer -> addrlen = 0;
+        return NULL;
+    }
+    return peer;
+}
+
+/*
+ *  rudp_receiver_free
+ *
+ *  Description:
+ *    Close the files of unfinished transfers and free the receiver.
+ */
+void rudp_receiver_free(struct rudp_receiver* rx) {
+
+    int i;
+
+    if (rx == NULL) {
+        return;
+    }
+    for (i = 0; i < RUDP_MAXPEERS; i++) {
+        if (rx -> peers[i].addrlen != 0 && rx -> peers[i].fd != -1) {
+            close(rx -> peers[i].fd);
+        }
+    }
+    free(rx);
+}
@@ -12,120 +12,216 @@
  */
 #include "headerPA5.h"
 
+static void serve_persistent(int connection, uint64_t client, struct cmdline* opts);
+
 int main(int argc, char* argv[]) {
 
-    uint8_t reply = 1;
+    uint8_t reply = 1, out[UDP_REPLYSIZE];
+    const struct handler* handler;
     struct sigaction sa;   
-    struct sockaddr_in from;  
+    struct sockaddr_storage from;  
     struct cmdline serverOpt;
-    struct addrinfo hints, *serverInfo, *cursor;  
-    socklen_t fromlen = sizeof(struct sockaddr_in);                                                       
-    socklen_t addrLen = sizeof(struct sockaddr_in);
-    char addrStr[INET_ADDRSTRLEN], buf[MAXDATASIZE];
-    int ret, serverSock, connection, set = 1, numbytes = 0;                      
+    struct loop_stats udpStats;
+    struct rudp_receiver* rudp = NULL;
+    struct addrinfo hints;  
+    socklen_t fromlen, addrLen;
+    char addrStr[INET6_ADDRSTRLEN], buf[MAXDATASIZE], dgram[RUDP_DGRAMSIZE];
+    int serverSock, connection, numbytes = 0;                      
+    bool streaming = false;
+    uint64_t accepted = 0, client, start;
+    ssize_t sent;
+    size_t outlen;
 
     /* Initialize command-line arguments, hints, and sigchld handler */
     serverOpt = parser(argc, argv, SERVER);           // Get command-line options
     init_hints(&hints, serverOpt.socktype, SERVER);   // Set getaddrinfo() hints
     init_sigchld_handler(&sa);                        // Set a sigchld handler
+    init_handlers();                                  // Register the request handlers
+    memset(&udpStats, 0, sizeof(udpStats));           // Count UDP packets and syscalls
 
-    /* Create a list of addrinfo structures for the server program */
-    if ((ret = getaddrinfo(NULL, serverOpt.port, &hints, &serverInfo)) != 0) {
-        fprintf(stderr, "[Server Program]: getaddrinfo: %s\n", gai_strerror(ret));
-        return 1;
+    /* Count every request, and answer '-e' with the counts (metrics.c);
+       shed connections and requests over '-c' and '-r' (admission.c) */
+    if (metrics_init() == -1 || admission_init(&serverOpt) == -1 ||
+        (serverOpt.admin != NULL && start_admin(serverOpt.admin) == -1)) {
+        exit(1);
     }
 
-    /* Loop through addrinfo structs until a socket can be created and bound */
-    for (cursor = serverInfo; cursor != NULL; cursor = cursor -> ai_next) {
-
-        /* Create a server socket */
-        if ((serverSock = socket(cursor -> ai_family, cursor -> ai_socktype, 
-                                 cursor -> ai_protocol)) == -1) {
-            perror("[Server Program]: socket");
-            continue;
-        }
+    /* Shared memory mode: clients on this host are served through shared
+       memory, everyone else over TCP as usual (shm.c) */
+    if (!strcmp(serverOpt.socktype, "shm") && start_shm(&serverOpt) == -1) {
+        exit(1);
+    }
 
-        /* Bind the server socket */
-        if (bind(serverSock, cursor -> ai_addr, cursor -> ai_addrlen) == -1) {
-            close(serverSock);
-            perror("[Server Program]: bind");
-            continue;
-        }
-        break;
+    /* Worker mode: every worker thread binds its own TCP and UDP sockets */
+    if (serverOpt.workers > 0) {
+        run_workers(&serverOpt);
+        exit(0);
     }
 
-    /* Exit if the socket failed to bind */
-    if (cursor == NULL) {
-        fprintf(stderr, "[Server Program]: failed to bind socket\n");
-        freeaddrinfo(serverInfo);
+    /* Create a socket bound to the server port */
+    if ((serverSock = bind_socket(serverOpt.port, hints.ai_socktype, false)) == -1) {
         exit(1);
     }
 
     /* TCP PROTOCOL SELECTED */
     if (hints.ai_socktype == SOCK_STREAM) { 
 
-        /* Set the socket option to reuse the socket address */                  
-        if (setsockopt(serverSock, SOL_SOCKET, SO_REUSEADDR, &set, 
-                       sizeof(int)) == -1) {
-            perror("[Server Program]: setsockopt");
-            close(serverSock); freeaddrinfo(serverInfo);
+        /* Listen for incoming connections, queueing up to '-l' of them */
+        if (!serverOpt.backlog) {
+            serverOpt.backlog = strcmp(serverOpt.mode, "fork") ? EVENT_BACKLOG : BACKLOG;
+        }
+        if (apply_profile(serverSock, serverOpt.profile, "[Server Program]:") == -1) {
+            close(serverSock);
             exit(1);
         }
+        if (listen(serverSock, serverOpt.backlog) == -1) {
+            perror("[Server Program]: listen");
+            close(serverSock);
+            exit(1);
+        }
+
+        /* Event loop mode: serve every client from this thread with epoll */
+        if (!strcmp(serverOpt.mode, "epoll")) {
+            serve_event_loop(serverSock, -1, &serverOpt);
+            close(serverSock);
+            exit(0);
+        }
+
+        /* Pool mode: threads started at launch serve the accepted connections */
+        if (!strcmp(serverOpt.mode, "pool")) {
+            run_pool(serverSock, &serverOpt);
+            close(serverSock);
+            exit(0);
+        }
 
         /* Server listening loop */
         while(1) {
 
-            /* Listen for incoming connections */
-            printf("------------------------------------------------------------------\n");
-            printf("[Server Program]: Waiting for connections...\n");
-            if (listen(serverSock, BACKLOG) == -1) {
-                perror("[Server Program]: listen");
-                close(serverSock); freeaddrinfo(serverInfo);
-                exit(1);
+            if (!serverOpt.quiet) {
+                printf("------------------------------------------------------------------\n");
+                printf("[Server Program]: Waiting for connections...\n");
             }
 
             /* Accept a connection */
+            addrLen = sizeof(from);
             if ((connection = accept(serverSock, (struct sockaddr*)&from, &addrLen)) == -1) {
                 perror("[Server Program]: accept");
-                close(serverSock); close(connection); freeaddrinfo(serverInfo);
+                close(serverSock); close(connection);
                 exit(1);
             }
+            accepted = now_ns();
+            metric_add(MC_ACCEPTS, 1);
+
+            /* Over '-c' connections: reject it before reading anything */
+            if (!admit_connection()) {
+                reject_connection(connection);
+                continue;
+            }
+            client = client_key(&from);
 
             /* Convert connected address from network byte order and print it */
-            inet_ntop(from.sin_family,
+            inet_ntop(from.ss_family,
                       get_sock_ip((struct sockaddr*)&from), addrStr, 
                       sizeof(addrStr));
-            printf("[Server Program]: Connected to client: %s:%s via TCP.\n\n", 
-                    addrStr, serverOpt.port);
+            if (!serverOpt.quiet) {
+                printf("[Server Program]: Connected to client: %s:%s via TCP.\n\n", 
+                        addrStr, serverOpt.port);
+            }
 
             /* Receieve a packet from the client */
-            if ((numbytes = recv(connection, buf, sizeof(struct packet), 0)) == -1) {
+            numbytes = sizeof(struct packet);
+            if (recvall(connection, buf, &numbytes) == -1) {
                 perror("[Server Program]: recv");
-                close(serverSock); close(connection); freeaddrinfo(serverInfo);
+                metric_add(MC_ERRORS, 1);
+                close(serverSock); close(connection);
                 exit(1);
             }
-            printf("[Server Program]: <%d bytes> receieved from the client.\n", numbytes);
+            if (!serverOpt.quiet) {
+                printf("[Server Program]: <%d bytes> receieved from the client.\n", numbytes);
+            }
+            if (numbytes < (int)sizeof(struct packet)) {
+                if (!serverOpt.quiet) {
+                    printf("[Server Program]: Client closed the connection early.\n");
+                }
+                metric_add(MC_CLOSES, 1);
+                release_connection();
+                close(connection);
+                continue;
+            }
+            metric_add(MC_TCP_REQUESTS, 1);
+            metric_add(MC_BYTES_IN, numbytes);
 
             /* Convert the packet to host byte order and unpack the message */
             uint32_t data_receieved = ntohl(((struct packet*)buf) -> number);
-            printf("[Server Program]: The sent number is: %d\n\n", data_receieved);
+            if (!serverOpt.quiet) {
+                printf("[Server Program]: The sent number is: %d\n\n", data_receieved);
+                printf("[Server Program]: Sending reply message to the client.\n");
+            }
 
             /* Fork() a child process to send a reply message */
-            printf("[Server Program]: Sending reply message to the client.\n");
+            uint8_t version = ((struct packet*)buf) -> version;
+            fflush(stdout);   // The child must not inherit unwritten output
             if (!fork()) {
+                // The connection waited from accept() until the child runs
+                metrics_child();
+                start = now_ns();
+                metric_time(MT_QUEUE, start - accepted);
+                // A bulk payload is receieved by the child before the reply
+                if (version == PROTO_BULK && 
+                    recv_bulk(connection, data_receieved, NULL, 0, &serverOpt) == -1) {
+                    metric_add(MC_ERRORS, 1);
+                    metric_add(MC_CLOSES, 1);
+                    release_connection();
+                    close(serverSock); close(connection);
+                    exit(1);
+                }
+                // Any other version is answered by its handler, unless the
+                // client is over its '-r' rate
+                if (reject_request(client, version, data_receieved)) {
+                    reply = REPLY_REJECTED;
+                }
+                else if (version != PROTO_BULK) {
+                    if ((handler = find_handler(version)) == NULL) {
+                        fprintf(stderr, "[Server Program]: Unknown packet version %u\n", 
+                                version);
+                        metric_add(MC_ERRORS, 1);
+                        metric_add(MC_CLOSES, 1);
+                        release_connection();
+                        close(serverSock); close(connection);
+                        exit(1);
+                    }
+                    reply = handler -> fn(data_receieved);
+                }
+                else {
+                    metric_add(MC_BYTES_IN, data_receieved);
+                }
+                metric_time(MT_SERVICE, now_ns() - start);
                 // sendall() avoids a partial send
+                numbytes = sizeof(reply);
                 if ((sendall(connection, (char*)&reply, &numbytes)) == -1) {
                     fprintf(stderr, "[Server Program]: Failed to sendall\n");
+                    metric_add(MC_ERRORS, 1);
+                }
+                // A persistent connection is served by the child until it closes
+                else if ((version != PROTO_SINGLE && data_receieved != 0) ||
+                         version == PROTO_BULK) {
+                    metric_add(MC_BYTES_OUT, numbytes);
+                    serve_persistent(connection, client, &serverOpt);
+                }
+                else {
+                    metric_add(MC_BYTES_OUT, numbytes);
                 }
-                close(serverSock); close(connection); freeaddrinfo(serverInfo);
+                metric_add(MC_CLOSES, 1);
+                release_connection();
+                close(serverSock); close(connection);
                 exit(0);
             }
 
-            /* Server terminates if 0 is receieved */
-            if (data_receieved == 0) {
+            /* Server terminates if 0 is receieved (a bulk length is not a number) */
+            if (data_receieved == 0 && version != PROTO_BULK) {
                 printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
                 printf("[Server Program]: Server shutting down.\n");
-                close(serverSock); close(connection); freeaddrinfo(serverInfo);
+                close(serverSock); close(connection);
                 exit(0);
             }
 
@@ -137,41 +233,103 @@ int main(int argc, char* argv[]) {
     /* UDP PROTOCOL SELECTED */
     if (hints.ai_socktype == SOCK_DGRAM) {
 
+        /* Event loop mode: read datagrams from this thread with epoll */
+        if (!strcmp(serverOpt.mode, "epoll")) {
+            serve_event_loop(-1, serverSock, &serverOpt);
+            close(serverSock);
+            exit(0);
+        }
+
+        /* Batched mode: many datagrams per recvmmsg() and sendmmsg() */
+        if (serverOpt.batch > 1) {
+            if (serve_udp_batched(serverSock, &serverOpt) == -1) {
+                close(serverSock);
+                exit(1);
+            }
+            close(serverSock);
+            exit(0);
+        }
+
         /* Server listening loop */
         while(1) {
 
             /* Server blocks until it receieves a datagram */
-            printf("------------------------------------------------------------------\n");
-            printf("[Server Program]: Waiting to receieve a datagram...\n\n");
-            if ((numbytes = recvfrom(serverSock, buf, sizeof(struct packet), 0,
+            if (!serverOpt.quiet && !streaming) {
+                printf("------------------------------------------------------------------\n");
+                printf("[Server Program]: Waiting to receieve a datagram...\n\n");
+            }
+            udpStats.syscalls++;
+            fromlen = sizeof(from);
+            if ((numbytes = recvfrom(serverSock, dgram, sizeof(dgram), 0,
                                     (struct sockaddr*)&from, &fromlen)) == -1) {
                 perror("[Server Program]: recvfrom");
-                close(serverSock); freeaddrinfo(serverInfo);
+                close(serverSock);
                 exit(1);
             }
+            metric_add(MC_BYTES_IN, numbytes);
+            if (numbytes < (int)sizeof(struct packet)) continue;  // Runt datagram
+            udpStats.udp_requests++;
+            metric_add(MC_UDP_REQUESTS, 1);
 
-            /* Datagram receieved: print the sender address and port */
-            printf("[Server Program]: <%d bytes> Receieved from %s:%s via UDP.\n", 
-                   numbytes, inet_ntoa(from.sin_addr), serverOpt.port);
+            /* A reliable transfer segment is written out and acknowledged (rudp.c) */
+            streaming = ((struct packet*)dgram) -> version == PROTO_RUDP;
+            if (streaming) {
+                if (rudp == NULL && (rudp = calloc(1, sizeof(struct rudp_receiver))) == NULL) {
+                    perror("[Server Program]: calloc");
+                    close(serverSock);
+                    exit(1);
+                }
+                udpStats.syscalls++;
+                if ((sent = rudp_receive(rudp, serverSock, dgram, numbytes, &from, fromlen,
+                                         &serverOpt, false)) > 0) {
+                    metric_add(MC_BYTES_OUT, sent);
+                }
+                continue;
+            }
 
             /* Convert the packet to host byte order and unpack the message */
-            uint32_t data_receieved = ntohl(((struct packet*)buf) -> number);
-            printf("[Server Program]: The sent number is: %d\n\n", data_receieved);
+            uint32_t data_receieved = ntohl(((struct packet*)dgram) -> number);
+            if (reject_request(client_key(&from), ((struct packet*)dgram) -> version,
+                               data_receieved)) {
+                reply = REPLY_REJECTED;   // Over the '-r' rate: not served
+            }
+            else if ((handler = find_handler(((struct packet*)dgram) -> version)) == NULL) {
+                metric_add(MC_ERRORS, 1);
+                continue;   // No handler: drop the datagram
+            }
+            else {
+                start = now_ns();
+                reply = handler -> fn(data_receieved);
+                metric_time(MT_SERVICE, now_ns() - start);
+            }
 
-            /* Send a reply message to the client */
-            printf("[Server Program]: Sending reply message to the client.\n");
-            if ((sendto(serverSock, &reply, sizeof(reply), 0, (struct sockaddr*)&from, 
-                        fromlen)) == -1) {
+            /* Datagram receieved: print the sender address, port and message */
+            if (!serverOpt.quiet) {
+                inet_ntop(from.ss_family, get_sock_ip((struct sockaddr*)&from), addrStr,
+                          sizeof(addrStr));
+                printf("[Server Program]: <%d bytes> Receieved from %s:%s via UDP.\n", 
+                       numbytes, addrStr, serverOpt.port);
+                printf("[Server Program]: The sent number is: %d\n\n", data_receieved);
+                printf("[Server Program]: Sending reply message to the client.\n");
+            }
+
+            /* Send a reply message to the client, with the request's tag */
+            udpStats.syscalls++;
+            outlen = udp_reply(out, reply, dgram, numbytes);
+            if ((sendto(serverSock, out, outlen, 0, (struct sockaddr*)&from, fromlen)) == -1) {
                 perror("[Server Program]: sendto");
-                close(serverSock); freeaddrinfo(serverInfo);
+                close(serverSock);
                 exit(1);
             }
+            metric_add(MC_BYTES_OUT, outlen);
             
             /* If the data receieved is 0 (i.e. the kill signal), terminate the server */
             if (data_receieved == 0) {
                 printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
                 printf("[Server Program]: Server shutting down.\n");
-                close(serverSock); freeaddrinfo(serverInfo);
+                print_udp_stats(&udpStats);
+                rudp_receiver_free(rudp);
+                close(serverSock);
                 exit(0);
             }
         }
@@ -179,3 +337,80 @@ int main(int argc, char* argv[]) {
 
     exit(0);
 }
+
+/*
+ *  serve_persistent
+ *
+ *  Description:
+ *    Answer the rest of a persistent connection in the child process
+ *    forked for it. Packets are read back to back and each one is 
+ *    answered, in order, with the one byte reply of its version's 
+ *    handler (handlers.c) until the client closes the connection. A
+ *    PROTO_BULK packet is answered once its payload has been receieved. Packets are parsed out of
+ *    large reads (framing.c), and the replies to every packet of one
+ *    read are sent together. A packet over the client's '-r' rate is
+ *    answered REPLY_REJECTED instead (admission.c).
+ *
+ *  Use:
+ *    Called by a child of the fork() server after it replied to the
+ *    first packet. If the termination number 0 arrives, the child
+ *    replies and then stops the parent server with SIGTERM.
+ */
+static void serve_persistent(int connection, uint64_t client, struct cmdline* opts) {
+
+    const struct handler* handler = NULL;
+    struct frame_reader reader;
+    struct packet pkt;
+    char replies[FRAME_BUFSIZE], *head;
+    size_t headlen;
+    int numreplies = 0;
+    uint64_t start;
+
+    reader_init(&reader, connection, opts -> profile);
+    while (1) {
+        /* About to wait for more bytes: send the replies owed first */
+        if (!reader_buffered(&reader) && 
+            flush_replies(connection, replies, &numreplies) == -1) {
+            return;
+        }
+        if (reader_next(&reader, &pkt) <= 0) {
+            return;   // Client closed the connection
+        }
+        uint32_t data_receieved = ntohl(pkt.number);
+        metric_add(MC_TCP_REQUESTS, 1);
+        metric_add(MC_BYTES_IN, sizeof(pkt));
+        start = now_ns();
+        if (reject_request(client, pkt.version, data_receieved)) {
+            replies[numreplies++] = REPLY_REJECTED;
+            metric_add(MC_BYTES_OUT, 1);
+            continue;
+        }
+        if (pkt.version == PROTO_BULK) {
+            headlen = reader_take(&reader, data_receieved, &head);
+            if (flush_replies(connection, replies, &numreplies) == -1 ||
+                recv_bulk(connection, data_receieved, head, headlen, opts) == -1) {
+                metric_add(MC_ERRORS, 1);
+                return;
+            }
+            metric_add(MC_BYTES_IN, data_receieved);
+        }
+        else if ((handler = find_handler(pkt.version)) == NULL) {
+            fprintf(stderr, "[Server Program]: Unknown packet version %u\n", pkt.version);
+            metric_add(MC_ERRORS, 1);
+            flush_replies(connection, replies, &numreplies);
+            return;
+        }
+        replies[numreplies++] = pkt.version == PROTO_BULK ? 1 : handler -> fn(data_receieved);
+        metric_time(MT_SERVICE, now_ns() - start);
+        metric_add(MC_BYTES_OUT, 1);
+
+        /* Server terminates if 0 is receieved */
+        if (data_receieved == 0 && pkt.version != PROTO_BULK) {
+            flush_replies(connection, replies, &numreplies);
+            printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
+            printf("[Server Program]: Server shutting down.\n");
+            kill(getppid(), SIGTERM);
+            return;
+        }
+    }
+}
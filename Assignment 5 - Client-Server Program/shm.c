@@ -0,0 +1,346 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  SHARED MEMORY TRANSPORT used by the client and server programs
+ *  ('-t shm')
+ *
+ *  A client on the same host as the server does not need the network
+ *  stack. With '-t shm' the server serves TCP as usual and also
+ *  listens on an abstract UNIX socket named after its port (SHM_PATH).
+ *  A client that connects there is sent, with SCM_RIGHTS, a memfd
+ *  holding a struct shm_channel: a ring of packets from the client
+ *  and a ring of one byte replies back, each with one producer and
+ *  one consumer. A thread of the server serves the channel until the
+ *  client closes it (shm_server.c); the UNIX socket is only kept to
+ *  notice a client that died.
+ *
+ *  Neither side makes a system call while the other keeps it busy: a
+ *  consumer checks its ring SHM_SPINS times (only if the host has more
+ *  than one CPU, where the producer can run meanwhile) and then sleeps
+ *  on the ring's futex word. A producer only calls futex() to wake a
+ *  consumer that is asleep.
+ *
+ *  The client uses shared memory when every address of '-s' is a
+ *  loopback address and the server answers on the UNIX socket, and
+ *  falls back to TCP otherwise.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static int spin = -1;   // More than one CPU: spinning on a ring can pay off
+
+static bool ring_ready(struct shm_ring* r);
+static bool loopback_only(struct addrinfo* list);
+
+/*
+ *  run_shm
+ *
+ *  Description:
+ *    Send 'count' packets to the server through shared memory, keeping
+ *    up to 'depth' in flight. A single packet's reply is returned in
+ *    '*reply'; for more, the request rate and the latency histogram
+ *    are printed.
+ *
+ *  Use:
+ *    Called by the client program for '-t shm'. Returns SHM_UNAVAILABLE
+ *    if the server is not on this host or does not share memory, so
+ *    the client can use TCP instead, and -1 on failure.
+ */
+int run_shm(struct cmdline* opts, struct addrinfo* serverInfo, uint8_t* reply) {
+
+    struct sockaddr_un addr;
+    socklen_t addrlen = shm_address(opts -> port, &addr);
+    struct shm_channel* ch;
+    struct histogram hist;
+    struct packet pkt;
+    uint64_t start, now, *sent_at;
+    uint32_t sent = 0, acked = 0, rejected = 0, burst, i;
+    unsigned head, tail;
+    double elapsed;
+    int sock, fd, ret = 0;
+
+    /* Share memory only with a server on this host */
+    if (!loopback_only(serverInfo)) {
+        return SHM_UNAVAILABLE;
+    }
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        perror("[Client Program]: socket");
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr*)&addr, addrlen) == -1) {
+        close(sock);
+        return SHM_UNAVAILABLE;
+    }
+    /* The server sends the memory, or rejects the client (admission.c) */
+    if ((fd = shm_recv_fd(sock, reply)) == -1) {
+        close(sock);
+        if (*reply == REPLY_REJECTED) {
+            if (opts -> count > 1) {
+                printf("[Client Program]: The server rejected the connection.\n");
+            }
+            return 0;   // A single packet's client prints the reply
+        }
+        fprintf(stderr, "[Client Program]: Failed to receive the shared memory\n");
+        return -1;
+    }
+    ch = mmap(NULL, sizeof(struct shm_channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ch == MAP_FAILED || (sent_at = malloc(SHM_SLOTS * sizeof(uint64_t))) == NULL) {
+        perror("[Client Program]: shared memory");
+        if (ch != MAP_FAILED) munmap(ch, sizeof(struct shm_channel));
+        close(sock);
+        return -1;
+    }
+    printf("------------------------------------------------------------------\n");
+    printf("[Client Program]: Connected to the server on port %s through shared memory\n",
+           opts -> port);
+
+    pkt.version = opts -> count > 1 ? opts -> version : PROTO_SINGLE;
+    pkt.number = htonl(opts -> data);
+    hist_init(&hist);
+    if (opts -> count == 1) {
+        printf("\n[Client Program]: Sent <%zu bytes> to the server through shared memory.\n\n",
+               sizeof(struct packet));
+        printf("[Client Program]: Waiting for server reply...\n");
+    }
+    start = now_ns();
+    while (acked < opts -> count) {
+
+        /* Fill the window, publish the packets together and wake the server */
+        burst = opts -> depth - (sent - acked);
+        if (burst > opts -> count - sent) {
+            burst = opts -> count - sent;
+        }
+        if (burst > 0) {
+            tail = atomic_load_explicit(&ch -> requests.tail, memory_order_relaxed);
+            now = now_ns();
+            for (i = 0; i < burst; i++, tail++, sent++) {
+                ch -> request[tail % SHM_SLOTS] = pkt;
+                sent_at[sent % SHM_SLOTS] = now;
+            }
+            atomic_store_explicit(&ch -> requests.tail, tail, memory_order_release);
+            shm_signal(&ch -> requests);
+        }
+
+        /* Collect the replies that have arrived, or timeout after 3 seconds */
+        if (!shm_wait(&ch -> replies, 3000)) {
+            printf("[Client Program]: ERROR server reply not receieved.\n");
+            ret = -1;
+            break;
+        }
+        head = atomic_load_explicit(&ch -> replies.head, memory_order_relaxed);
+        tail = atomic_load_explicit(&ch -> replies.tail, memory_order_acquire);
+        now = now_ns();
+        for (; head != tail; head++, acked++) {
+            *reply = ch -> reply[head % SHM_SLOTS];
+            if (*reply == REPLY_REJECTED) {
+                rejected++;
+            }
+            else {
+                hist_record(&hist, now - sent_at[acked % SHM_SLOTS]);
+            }
+        }
+        atomic_store_explicit(&ch -> replies.head, head, memory_order_release);
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    if (ret == 0 && opts -> count > 1) {
+        printf("[Client Program]: %u replies receieved through shared memory (depth %u) "
+               "in %.3f s: %.0f requests/s\n", acked, opts -> depth, elapsed,
+               elapsed > 0 ? acked / elapsed : 0);
+        if (rejected > 0) {
+            printf("[Client Program]: %u requests rejected by the server\n", rejected);
+        }
+        hist_print(&hist, "[Client Program]:");
+        printf("\n");
+    }
+
+    /* Tell the server the channel is done */
+    atomic_store(&ch -> closed, true);
+    shm_signal(&ch -> requests);
+    munmap(ch, sizeof(struct shm_channel));
+    free(sent_at);
+    close(sock);
+    return ret;
+}
+
+/*
+ *  shm_address
+ *
+ *  Description:
+ *    Fill in the abstract UNIX socket address of the server on 'port'
+ *    (the name starts with a null byte, so there is no file to clean
+ *    up) and return its length.
+ */
+socklen_t shm_address(char* port, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr -> sun_family = AF_UNIX;
+    snprintf(addr -> sun_path + 1, sizeof(addr -> sun_path) - 1, SHM_PATH, port);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr -> sun_path + 1);
+}
+
+/*
+ *  ring_ready
+ *
+ *  Description:
+ *    True if the ring holds an entry the consumer has not taken.
+ */
+static bool ring_ready(struct shm_ring* r) {
+    return atomic_load(&r -> tail) != atomic_load_explicit(&r -> head, memory_order_relaxed);
+}
+
+/*
+ *  shm_wait
+ *
+ *  Description:
+ *    Wait up to 'timeout_ms' for an entry in a ring, as its consumer.
+ *    The futex word is read before 'waiting' is set and the ring is
+ *    checked again: a producer that publishes after that check sees
+ *    'waiting' and wakes the consumer, and one that published in
+ *    between changed the word, so FUTEX_WAIT returns at once. A wake
+ *    can come without an entry (a signal, or a bump of the word for
+ *    an entry already taken), so the wait goes on until the ring holds
+ *    one or 'timeout_ms' has passed. Returns true if the ring holds an
+ *    entry.
+ */
+bool shm_wait(struct shm_ring* r, int timeout_ms) {
+
+    struct timespec ts;
+    uint64_t deadline, now;
+    unsigned seq;
+    int i;
+
+    if (spin == -1) {
+        spin = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    }
+    for (i = 0; spin && i < SHM_SPINS; i++) {
+        if (ring_ready(r)) {
+            return true;
+        }
+    }
+    deadline = now_ns() + (uint64_t)timeout_ms * 1000000;
+    while (1) {
+        seq = atomic_load(&r -> seq);
+        atomic_store(&r -> waiting, 1);
+        if (ring_ready(r) || (now = now_ns()) >= deadline) {
+            break;
+        }
+        ts.tv_sec = (deadline - now) / 1000000000;
+        ts.tv_nsec = (deadline - now) % 1000000000;
+        syscall(SYS_futex, &r -> seq, FUTEX_WAIT, seq, &ts, NULL, 0);
+    }
+    atomic_store(&r -> waiting, 0);
+    return ring_ready(r);
+}
+
+/*
+ *  shm_signal
+ *
+ *  Description:
+ *    Called by a producer after publishing: change the futex word and
+ *    wake the consumer if it sleeps on it.
+ */
+void shm_signal(struct shm_ring* r) {
+    atomic_fetch_add(&r -> seq, 1);
+    if (atomic_load(&r -> waiting)) {
+        syscall(SYS_futex, &r -> seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+}
+
+/*
+ *  loopback_only
+ *
+ *  Description:
+ *    True if every address of the list is a loopback address
+ *    (127.0.0.0/8, ::1 or ::ffff:127.0.0.0/104).
+ */
+static bool loopback_only(struct addrinfo* list) {
+
+    struct sockaddr_in6* in6;
+
+    for (; list != NULL; list = list -> ai_next) {
+        if (list -> ai_family == AF_INET) {
+            if ((ntohl(((struct sockaddr_in*)list -> ai_addr) -> sin_addr.s_addr) >> 24) != 127) {
+                return false;
+            }
+        }
+        else {
+            in6 = (struct sockaddr_in6*)list -> ai_addr;
+            if (!IN6_IS_ADDR_LOOPBACK(&in6 -> sin6_addr) &&
+                !(IN6_IS_ADDR_V4MAPPED(&in6 -> sin6_addr) && in6 -> sin6_addr.s6_addr[12] == 127)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ *  shm_send_fd
+ *
+ *  Description:
+ *    Send the byte 1 and a file descriptor over a UNIX socket.
+ */
+int shm_send_fd(int sock, int fd) {
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    struct iovec iov;
+    uint8_t byte = 1;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &byte;
+    iov.iov_len = sizeof(byte);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg -> cmsg_level = SOL_SOCKET;
+    cmsg -> cmsg_type = SCM_RIGHTS;
+    cmsg -> cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == -1 ? -1 : 0;
+}
+
+/*
+ *  shm_recv_fd
+ *
+ *  Description:
+ *    Receive the byte and file descriptor of shm_send_fd(). Returns -1 if
+ *    none came; '*byte' is then what the server sent instead (0 if
+ *    nothing).
+ */
+int shm_recv_fd(int sock, uint8_t* byte) {
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    struct iovec iov;
+    int fd;
+
+    *byte = 0;
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = byte;
+    iov.iov_len = sizeof(*byte);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) <= 0 || (cmsg = CMSG_FIRSTHDR(&msg)) == NULL ||
+        cmsg -> cmsg_level != SOL_SOCKET || cmsg -> cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
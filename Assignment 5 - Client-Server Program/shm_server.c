@@ -0,0 +1,269 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  SHARED MEMORY SERVER used by the server program ('-t shm')
+ *
+ *  A thread accepts clients on the server's UNIX socket (SHM_PATH).
+ *  Each one counts against '-c' like a TCP connection, and is sent a
+ *  memfd holding its struct shm_channel; a thread of its own then
+ *  answers the packets of the request ring in the reply ring until
+ *  the client closes the channel or its socket. See shm.c for the
+ *  rings.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+/*
+ *  Struct for one client served by a thread of the server
+ */
+struct shm_client {
+    int sock;
+    struct shm_channel* ch;
+    uint64_t client;
+};
+
+static void* shm_acceptor(void* arg);
+static void* shm_routine(void* arg);
+static int serve_requests(struct shm_client* c, bool* terminate);
+static struct shm_channel* open_channel(int sock, uint64_t* client);
+static bool peer_closed(int sock);
+
+/*
+ *  start_shm
+ *
+ *  Description:
+ *    Listen on the UNIX socket of the server's port and start a
+ *    thread that accepts shared memory clients on it.
+ *
+ *  Use:
+ *    Called by the server program for '-t shm' before it starts
+ *    serving TCP. Returns -1 on failure.
+ */
+int start_shm(struct cmdline* opts) {
+
+    struct sockaddr_un addr;
+    socklen_t addrlen = shm_address(opts -> port, &addr);
+    pthread_t tid;
+    int sock, err;
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+        perror("[Server Program]: socket");
+        return -1;
+    }
+    if (bind(sock, (struct sockaddr*)&addr, addrlen) == -1 || listen(sock, SOMAXCONN) == -1) {
+        perror("[Server Program]: shared memory socket");
+        close(sock);
+        return -1;
+    }
+    if ((err = pthread_create(&tid, NULL, shm_acceptor, (void*)(intptr_t)sock)) != 0) {
+        errno = err;
+        perror("[Server Program]: pthread_create");
+        close(sock);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+/*
+ *  shm_acceptor
+ *
+ *  Description:
+ *    Thread routine: accept shared memory clients, counting them
+ *    against '-c' like TCP connections (admission.c), and start a
+ *    thread for each one.
+ */
+static void* shm_acceptor(void* arg) {
+
+    struct shm_client* c;
+    pthread_t tid;
+    int listenSock = (intptr_t)arg, sock, err;
+
+    while (1) {
+        if ((sock = accept4(listenSock, NULL, NULL, SOCK_CLOEXEC)) == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("[Server Program]: accept");
+            metric_add(MC_ERRORS, 1);
+            return NULL;
+        }
+        metric_add(MC_ACCEPTS, 1);
+        if (!admit_connection()) {
+            reject_connection(sock);
+            continue;
+        }
+        if ((c = malloc(sizeof(struct shm_client))) == NULL) {
+            perror("[Server Program]: malloc");
+        }
+        else if ((c -> ch = open_channel(sock, &c -> client)) == NULL) {
+            free(c);
+            c = NULL;
+        }
+        else {
+            c -> sock = sock;
+            if ((err = pthread_create(&tid, NULL, shm_routine, c)) == 0) {
+                pthread_detach(tid);
+                continue;
+            }
+            errno = err;
+            perror("[Server Program]: pthread_create");
+            munmap(c -> ch, sizeof(struct shm_channel));
+            free(c);
+        }
+        metric_add(MC_ERRORS, 1);
+        metric_add(MC_CLOSES, 1);
+        release_connection();
+        close(sock);
+    }
+}
+
+/*
+ *  open_channel
+ *
+ *  Description:
+ *    Create the shared memory of a new client, map it, and send it to
+ *    the client. '*client' is set to the key of the client's user for
+ *    the '-r' rate (clients of one user share a bucket, as clients of
+ *    one address do). Returns NULL on failure.
+ */
+static struct shm_channel* open_channel(int sock, uint64_t* client) {
+
+    struct shm_channel* ch;
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    int fd;
+
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+        perror("[Server Program]: getsockopt");
+        return NULL;
+    }
+    *client = cred.uid;
+    if ((fd = memfd_create("pa5-shm", MFD_CLOEXEC)) == -1 ||
+        ftruncate(fd, sizeof(struct shm_channel)) == -1) {
+        perror("[Server Program]: memfd");
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+    ch = mmap(NULL, sizeof(struct shm_channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ch == MAP_FAILED) {
+        perror("[Server Program]: mmap");
+        close(fd);
+        return NULL;
+    }
+    if (shm_send_fd(sock, fd) == -1) {
+        perror("[Server Program]: sendmsg");
+        munmap(ch, sizeof(struct shm_channel));
+        close(fd);
+        return NULL;
+    }
+    close(fd);   // The mappings keep the memory
+    return ch;
+}
+
+/*
+ *  shm_routine
+ *
+ *  Description:
+ *    Thread routine: serve one client's requests until it closes the
+ *    channel or its socket, or sends the termination number 0, which
+ *    stops the server with SIGTERM after the reply.
+ */
+static void* shm_routine(void* arg) {
+
+    struct shm_client* c = arg;
+    bool terminate = false;
+
+    while (!terminate) {
+        if (!shm_wait(&c -> ch -> requests, SHM_POLL_MS)) {
+            if (atomic_load(&c -> ch -> closed) || peer_closed(c -> sock)) {
+                break;
+            }
+            continue;
+        }
+        if (serve_requests(c, &terminate) == -1) {
+            break;
+        }
+    }
+    if (terminate) {
+        printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
+        printf("[Server Program]: Server shutting down.\n");
+        fflush(stdout);
+        kill(getpid(), SIGTERM);
+    }
+    metric_add(MC_CLOSES, 1);
+    release_connection();
+    munmap(c -> ch, sizeof(struct shm_channel));
+    close(c -> sock);
+    free(c);
+    return NULL;
+}
+
+/*
+ *  serve_requests
+ *
+ *  Description:
+ *    Answer every packet in the request ring with the reply of its
+ *    version's handler (handlers.c), or REPLY_REJECTED over the '-r'
+ *    rate, then publish the replies together and wake the client if
+ *    it sleeps. Returns -1 for a version without a handler.
+ */
+static int serve_requests(struct shm_client* c, bool* terminate) {
+
+    struct shm_channel* ch = c -> ch;
+    const struct handler* handler;
+    struct packet pkt;
+    unsigned head, tail, out, served;
+    uint64_t start = now_ns(), end;
+    int ret = 0;
+
+    head = atomic_load_explicit(&ch -> requests.head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ch -> requests.tail, memory_order_acquire);
+    out = atomic_load_explicit(&ch -> replies.tail, memory_order_relaxed);
+    for (served = 0; head != tail; head++, served++) {
+        pkt = ch -> request[head % SHM_SLOTS];
+        uint32_t data_receieved = ntohl(pkt.number);
+        if (reject_request(c -> client, pkt.version, data_receieved)) {
+            ch -> reply[out++ % SHM_SLOTS] = REPLY_REJECTED;
+        }
+        else if ((handler = find_handler(pkt.version)) == NULL) {
+            fprintf(stderr, "[Server Program]: Unknown packet version %u\n", pkt.version);
+            metric_add(MC_ERRORS, 1);
+            ret = -1;
+            break;
+        }
+        else {
+            ch -> reply[out++ % SHM_SLOTS] = handler -> fn(data_receieved);
+        }
+        if (data_receieved == 0) {
+            *terminate = true;
+        }
+    }
+    atomic_store_explicit(&ch -> requests.head, head, memory_order_release);
+    atomic_store_explicit(&ch -> replies.tail, out, memory_order_release);
+    shm_signal(&ch -> replies);
+
+    /* The handlers of one wakeup are timed as a group, like the event loop's */
+    end = now_ns();
+    for (tail = 0; tail < served; tail++) {
+        metric_time(MT_SERVICE, (end - start) / served);
+    }
+    metric_add(MC_SHM_REQUESTS, served);
+    metric_add(MC_BYTES_IN, served * sizeof(struct packet));
+    metric_add(MC_BYTES_OUT, served);
+    return ret;
+}
+
+/*
+ *  peer_closed
+ *
+ *  Description:
+ *    True if the client closed its socket (or its process died).
+ */
+static bool peer_closed(int sock) {
+
+    char byte;
+    ssize_t n = recv(sock, &byte, 1, MSG_DONTWAIT | MSG_PEEK);
+
+    return n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
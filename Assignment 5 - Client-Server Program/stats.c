@@ -0,0 +1,167 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  LATENCY HISTOGRAM used by the client and server programs
+ *
+ *  Latencies are recorded in nanoseconds into log-linear buckets:
+ *  every power of two is split into HIST_SUB_BUCKETS equal slices,
+ *  so a recorded value is off by at most 1/32 (about 3%) no matter
+ *  how large it is, and recording is a few shifts and one add.
+ */
+#include "headerPA5.h"
+
+/*
+ *  now_ns
+ *
+ *  Description:
+ *    Read the monotonic clock in nanoseconds.
+ */
+uint64_t now_ns(void) {
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ *  hist_init
+ *
+ *  Description:
+ *    Empty a histogram.
+ */
+void hist_init(struct histogram* h) {
+    memset(h, 0, sizeof(*h));
+    h -> min = UINT64_MAX;
+}
+
+/*
+ *  hist_record
+ *
+ *  Description:
+ *    Count one value (in nanoseconds). Values beyond the largest
+ *    bucket are counted in the largest bucket.
+ */
+void hist_record(struct histogram* h, uint64_t value) {
+    h -> counts[hist_index(value)]++;
+    h -> total++;
+    if (value < h -> min) h -> min = value;
+    if (value > h -> max) h -> max = value;
+}
+
+/*
+ *  hist_merge
+ *
+ *  Description:
+ *    Add every count of 'src' to 'dst'.
+ */
+void hist_merge(struct histogram* dst, const struct histogram* src) {
+
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        dst -> counts[i] += src -> counts[i];
+    }
+    dst -> total += src -> total;
+    if (src -> min < dst -> min) dst -> min = src -> min;
+    if (src -> max > dst -> max) dst -> max = src -> max;
+}
+
+/*
+ *  hist_percentile
+ *
+ *  Description:
+ *    Return the value at quantile 'q' (0.0 to 1.0): the upper edge of
+ *    the bucket holding the q-th recorded value, capped by the largest
+ *    value recorded. Returns 0 for an empty histogram.
+ */
+uint64_t hist_percentile(const struct histogram* h, double q) {
+
+    uint64_t rank, seen = 0, value;
+    int i;
+
+    if (h -> total == 0) return 0;
+    rank = (uint64_t)(q * h -> total);
+    if (rank >= h -> total) rank = h -> total - 1;
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += h -> counts[i];
+        if (seen > rank) break;
+    }
+    value = hist_bucket_value(i);
+    return value > h -> max ? h -> max : value;
+}
+
+/*
+ *  hist_print
+ *
+ *  Description:
+ *    Print the usual percentiles in microseconds, followed by one
+ *    line per power of two between the smallest and largest value
+ *    showing how many values fell in that range.
+ */
+void hist_print(const struct histogram* h, const char* prefix) {
+
+    uint64_t count, low;
+    int i, j, bar;
+
+    if (h -> total == 0) {
+        printf("%s no latencies recorded\n", prefix);
+        return;
+    }
+    printf("%s latency (us): min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  "
+           "p999 %.1f  max %.1f\n", prefix, h -> min / 1e3,
+           hist_percentile(h, 0.50) / 1e3, hist_percentile(h, 0.90) / 1e3,
+           hist_percentile(h, 0.99) / 1e3, hist_percentile(h, 0.999) / 1e3,
+           h -> max / 1e3);
+
+    /* Collapse the sub-buckets of each power of two into one row */
+    for (i = 0; i < HIST_BUCKETS; i += HIST_SUB_BUCKETS) {
+        for (count = 0, j = i; j < i + HIST_SUB_BUCKETS; j++) {
+            count += h -> counts[j];
+        }
+        if (count == 0) continue;
+        low = i == 0 ? 0 : hist_bucket_value(i - 1) + 1;
+        bar = (int)(50.0 * count / h -> total + 0.5);
+        printf("%s   >= %10.1f us %10lu  ", prefix, low / 1e3, (unsigned long)count);
+        for (j = 0; j < bar; j++) putchar('#');
+        putchar('\n');
+    }
+}
+
+/*
+ *  hist_index
+ *
+ *  Description:
+ *    Map a value to its bucket. Values below HIST_SUB_BUCKETS get a
+ *    bucket each; above that, the top HIST_SUB_BITS bits after the
+ *    leading one select the slice within the value's power of two.
+ *    Also used by the server metrics (metrics.c).
+ */
+int hist_index(uint64_t value) {
+
+    int exponent, idx;
+
+    if (value < HIST_SUB_BUCKETS) return (int)value;
+    exponent = 63 - __builtin_clzll(value);
+    idx = (exponent - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS +
+          (int)((value >> (exponent - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+/*
+ *  hist_bucket_value
+ *
+ *  Description:
+ *    The largest value that maps to bucket 'idx'.
+ */
+uint64_t hist_bucket_value(int idx) {
+
+    int exponent, slice;
+
+    if (idx < HIST_SUB_BUCKETS) return idx;
+    exponent = idx / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+    slice = idx % HIST_SUB_BUCKETS;
+    return ((uint64_t)(HIST_SUB_BUCKETS + slice + 1) << (exponent - HIST_SUB_BITS)) - 1;
+}
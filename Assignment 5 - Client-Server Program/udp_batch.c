@@ -0,0 +1,205 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  BATCHED UDP I/O used by the server program ('-b <number>')
+ *
+ *  Instead of one recvfrom() and one sendto() per datagram, up to
+ *  '-b' datagrams are received with a single recvmmsg() and all of
+ *  their replies are sent with a single sendmmsg(). At high packet
+ *  rates this divides the per-packet syscall cost by the batch size.
+ *  Segments of a reliable transfer (rudp.c) in a batch are taken by
+ *  its receiver, which acknowledges them once per batch.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+/*
+ *  serve_datagram_batch
+ *
+ *  Description:
+ *    Receive one batch of datagrams, answer every datagram that holds
+ *    a whole packet with the one byte reply of its version's handler
+ *    (handlers.c), and send all of the replies at once. A reliable
+ *    transfer segment goes to '*rudp' (allocated on the first one),
+ *    and the transfers are acknowledged after the replies are sent.
+ *    '*terminate' is set if any packet carried the termination
+ *    number 0.
+ *
+ *  Use:
+ *    Called by the blocking UDP loop with MSG_WAITFORONE (wait for the
+ *    first datagram, then take whatever else is queued) and by the
+ *    event loop with MSG_DONTWAIT. Returns the number of datagrams
+ *    receieved, or -1 with errno set (EAGAIN: nothing was queued).
+ */
+int serve_datagram_batch(int sock, struct cmdline* opts, struct loop_stats* stats,
+                         struct rudp_receiver** rudp, int flags, bool* terminate) {
+
+    struct mmsghdr msgs[MAXBATCH], replies[MAXBATCH];
+    struct iovec iovs[MAXBATCH], reply_iovs[MAXBATCH];
+    struct sockaddr_storage addrs[MAXBATCH];
+    char dgrams[MAXBATCH][RUDP_DGRAMSIZE];
+    struct packet pkt;
+    uint8_t reply[MAXBATCH][UDP_REPLYSIZE];
+    const struct handler* handler;
+    char addrStr[INET6_ADDRSTRLEN];
+    int i, n, numreplies = 0, sent, ret;
+    ssize_t acked;
+    unsigned long bytes = 0, requests = 0, bytes_out = 0;
+    uint64_t received, start, end;
+
+    /* Point every message at its own datagram and address buffer */
+    memset(msgs, 0, sizeof(struct mmsghdr) * opts -> batch);
+    for (i = 0; i < opts -> batch; i++) {
+        iovs[i].iov_base = dgrams[i];
+        iovs[i].iov_len = RUDP_DGRAMSIZE;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+
+    stats -> syscalls++;
+    if ((n = recvmmsg(sock, msgs, opts -> batch, flags, NULL)) == -1) {
+        return -1;
+    }
+    received = start = now_ns();   // Every datagram waits for those before it
+
+    /* Unpack each packet and queue its reply */
+    for (i = 0; i < n; i++) {
+        stats -> bytes_in += msgs[i].msg_len;
+        bytes += msgs[i].msg_len;
+        if (msgs[i].msg_len < sizeof(struct packet)) continue;  // Runt datagram
+        memcpy(&pkt, dgrams[i], sizeof(pkt));
+        stats -> udp_requests++;
+        requests++;
+
+        /* A reliable transfer segment is written out, its acknowledgement deferred */
+        if (pkt.version == PROTO_RUDP) {
+            if (*rudp == NULL && (*rudp = calloc(1, sizeof(struct rudp_receiver))) == NULL) {
+                perror("[Server Program]: calloc");
+                continue;
+            }
+            if ((acked = rudp_receive(*rudp, sock, dgrams[i], msgs[i].msg_len, &addrs[i],
+                                      msgs[i].msg_hdr.msg_namelen, opts, true)) > 0) {
+                stats -> syscalls++;
+                bytes_out += acked;
+            }
+            continue;
+        }
+
+        uint32_t data_receieved = ntohl(pkt.number);
+        if (!opts -> quiet) {
+            inet_ntop(addrs[i].ss_family, get_sock_ip((struct sockaddr*)&addrs[i]), addrStr,
+                      sizeof(addrStr));
+            printf("[Server Program]: <%u bytes> Receieved from %s via UDP, number: %u\n",
+                   msgs[i].msg_len, addrStr, data_receieved);
+        }
+        if (data_receieved == 0) {
+            *terminate = true;
+        }
+        if (reject_request(client_key(&addrs[i]), pkt.version, data_receieved)) {
+            reply[numreplies][0] = REPLY_REJECTED;   // Over the '-r' rate: not served
+        }
+        else if ((handler = find_handler(pkt.version)) == NULL) {
+            metric_add(MC_ERRORS, 1);
+            continue;   // No handler: drop the datagram
+        }
+        else {
+            metric_time(MT_QUEUE, start - received);
+            reply[numreplies][0] = handler -> fn(data_receieved);
+            end = now_ns();
+            metric_time(MT_SERVICE, end - start);
+            start = end;
+        }
+        reply_iovs[numreplies].iov_base = reply[numreplies];
+        reply_iovs[numreplies].iov_len = udp_reply(reply[numreplies], reply[numreplies][0],
+                                                   dgrams[i], msgs[i].msg_len);
+        memset(&replies[numreplies], 0, sizeof(struct mmsghdr));
+        replies[numreplies].msg_hdr.msg_iov = &reply_iovs[numreplies];
+        replies[numreplies].msg_hdr.msg_iovlen = 1;
+        replies[numreplies].msg_hdr.msg_name = &addrs[i];
+        replies[numreplies].msg_hdr.msg_namelen = msgs[i].msg_hdr.msg_namelen;
+        numreplies++;
+    }
+
+    /* Send every reply; sendmmsg() may stop early, so resume where it did */
+    for (sent = 0; sent < numreplies; sent += ret) {
+        stats -> syscalls++;
+        if ((ret = sendmmsg(sock, replies + sent, numreplies - sent, 0)) == -1) {
+            if (errno == EINTR) {
+                ret = 0;
+                continue;
+            }
+            perror("[Server Program]: sendmmsg");
+            metric_add(MC_ERRORS, 1);
+            break;   // Dropped replies look like lost datagrams to the client
+        }
+        for (i = sent; i < sent + ret; i++) {
+            bytes_out += replies[i].msg_len;
+        }
+    }
+    bytes_out += rudp_flush_acks(*rudp, sock, &stats -> syscalls);
+    stats -> bytes_out += bytes_out;
+    metric_add(MC_BYTES_OUT, bytes_out);
+    metric_add(MC_BYTES_IN, bytes);
+    metric_add(MC_UDP_REQUESTS, requests);
+    return n;
+}
+
+/*
+ *  serve_udp_batched
+ *
+ *  Description:
+ *    Blocking UDP server loop that works one batch at a time until a
+ *    termination number arrives, then prints its packet and syscall
+ *    counts.
+ *
+ *  Use:
+ *    Called by the server program for '-t udp -b <number>'. Returns
+ *    -1 if recvmmsg() failed.
+ */
+int serve_udp_batched(int sock, struct cmdline* opts) {
+
+    struct loop_stats stats;
+    struct rudp_receiver* rudp = NULL;
+    bool terminate = false;
+    int ret = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    printf("------------------------------------------------------------------\n");
+    printf("[Server Program]: Waiting to receieve datagrams in batches of %d...\n\n",
+           opts -> batch);
+
+    while (!terminate) {
+        if (serve_datagram_batch(sock, opts, &stats, &rudp, MSG_WAITFORONE,
+                                 &terminate) == -1) {
+            if (errno == EINTR) continue;
+            perror("[Server Program]: recvmmsg");
+            ret = -1;
+            break;
+        }
+    }
+    rudp_receiver_free(rudp);
+    if (ret == -1) {
+        return -1;
+    }
+    printf("\n[Server Program]: Termination signal receieved. Et tu Brute...?\n");
+    printf("[Server Program]: Server shutting down.\n");
+    print_udp_stats(&stats);
+    return 0;
+}
+
+/*
+ *  print_udp_stats
+ *
+ *  Description:
+ *    Print how many datagrams were answered and how many socket
+ *    syscalls that took.
+ */
+void print_udp_stats(struct loop_stats* stats) {
+    printf("[Server Program]: %lu UDP requests, %lu socket syscalls (%.3f per packet)\n",
+           stats -> udp_requests, stats -> syscalls,
+           stats -> udp_requests ? (double)stats -> syscalls / stats -> udp_requests : 0.0);
+}
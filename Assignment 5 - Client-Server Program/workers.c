@@ -0,0 +1,138 @@
+/*  Programming assignment #5
+ *  CSPB 3753 - Operating Systems
+ *  Author: Thomas Cochran
+ *
+ *  WORKER THREADS used by the server program
+ *
+ *  Each worker binds its own TCP and UDP socket to the server port
+ *  with SO_REUSEPORT and runs its own event loop (event_loop.c).
+ *  The kernel hashes new connections and datagrams across the
+ *  workers' sockets, so the server uses one core per worker and
+ *  the workers share no locks.
+ *
+ *  See README.md for instructions on running this program.
+ */
+#include "headerPA5.h"
+
+static void* worker_routine(void* arg);
+
+/*
+ *  run_workers
+ *
+ *  Description:
+ *    Bind a TCP and a UDP socket for every worker, start one thread
+ *    per worker, and wait for all of them to stop. A termination
+ *    number (0) received by any worker stops every worker through
+ *    the shared shutdown flag and eventfd. With '-j' every worker 
+ *    hands its expensive requests to one shared set of compute 
+ *    threads. Per-worker and total statistics are printed at exit.
+ *
+ *  Use:
+ *    Called by the server program when '-w <number>' is given.
+ */
+void run_workers(struct cmdline* opts) {
+
+    struct evloop* loops;
+    struct compute* compute = NULL;
+    struct loop_stats total;
+    pthread_t* threads;
+    atomic_bool shutdown = false;
+    int i, err, wakefd, started = 0;
+
+    if ((loops = calloc(opts -> workers, sizeof(struct evloop))) == NULL ||
+        (threads = calloc(opts -> workers, sizeof(pthread_t))) == NULL) {
+        perror("[Server Program]: calloc");
+        exit(1);
+    }
+    if ((wakefd = eventfd(0, EFD_NONBLOCK)) == -1) {
+        perror("[Server Program]: eventfd");
+        exit(1);
+    }
+    if (opts -> compute > 0 && (compute = start_compute(opts -> compute)) == NULL) {
+        exit(1);
+    }
+
+    /* Bind each worker's sockets before any worker starts serving */
+    for (i = 0; i < opts -> workers; i++) {
+        loops[i].id = i;
+        loops[i].wakefd = wakefd;
+        loops[i].shutdown = &shutdown;
+        loops[i].opts = opts;
+        loops[i].listenSock = bind_socket(opts -> port, SOCK_STREAM, true);
+        loops[i].udpSock = bind_socket(opts -> port, SOCK_DGRAM, true);
+        if (loops[i].listenSock == -1 || loops[i].udpSock == -1) {
+            exit(1);
+        }
+        if (apply_profile(loops[i].listenSock, opts -> profile, "[Server Program]:") == -1) {
+            exit(1);
+        }
+        if (listen(loops[i].listenSock, opts -> backlog ? opts -> backlog : EVENT_BACKLOG) == -1) {
+            perror("[Server Program]: listen");
+            exit(1);
+        }
+        if (compute != NULL && attach_compute(&loops[i], compute) == -1) {
+            exit(1);
+        }
+    }
+    printf("------------------------------------------------------------------\n");
+    printf("[Server Program]: %d workers waiting for TCP connections and UDP "
+           "datagrams on port %s...\n", opts -> workers, opts -> port);
+
+    /* Start the workers */
+    for (i = 0; i < opts -> workers; i++) {
+        if ((err = pthread_create(&threads[i], NULL, worker_routine, &loops[i])) != 0) {
+            errno = err;
+            perror("[Server Program]: pthread_create");
+            break;
+        }
+        started++;
+    }
+    if (started < opts -> workers) {
+        atomic_store(&shutdown, true);
+        eventfd_write(wakefd, 1);
+    }
+
+    /* Wait for the workers, then report their statistics */
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < started; i++) {
+        if ((err = pthread_join(threads[i], NULL)) != 0) {
+            errno = err;
+            perror("[Server Program]: pthread_join");
+        }
+    }
+    if (compute != NULL) {
+        stop_compute(compute);
+        for (i = 0; i < opts -> workers; i++) {
+            detach_compute(&loops[i]);
+        }
+    }
+    for (i = 0; i < opts -> workers; i++) {
+        print_loop_stats(&loops[i]);
+        total.accepts += loops[i].stats.accepts;
+        total.tcp_requests += loops[i].stats.tcp_requests;
+        total.udp_requests += loops[i].stats.udp_requests;
+        total.bytes_in += loops[i].stats.bytes_in;
+        total.bytes_out += loops[i].stats.bytes_out;
+        close(loops[i].listenSock);
+        close(loops[i].udpSock);
+    }
+    printf("[Server Program]: total: %lu accepts, %lu TCP requests, "
+           "%lu UDP requests, %lu bytes in, %lu bytes out\n",
+           total.accepts, total.tcp_requests, total.udp_requests,
+           total.bytes_in, total.bytes_out);
+
+    close(wakefd);
+    free(threads);
+    free(loops);
+}
+
+/*
+ *  worker_routine
+ *
+ *  Description:
+ *    Thread routine of one worker: run the worker's event loop.
+ */
+static void* worker_routine(void* arg) {
+    event_loop((struct evloop*)arg);
+    return NULL;
+}